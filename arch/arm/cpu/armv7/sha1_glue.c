@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 secure hash using ARMv7 assembler
+ */
+
+#include <u-boot/sha1.h>
+
+extern void sha1_armv7_process(uint32_t state[5], uint8_t const *src,
+			       uint32_t blocks);
+
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	sha1_armv7_process(ctx->state, data, blocks);
+}
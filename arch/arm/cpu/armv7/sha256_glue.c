@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 secure hash using ARMv7 assembler
+ */
+
+#include <u-boot/sha256.h>
+
+extern void sha256_armv7_process(uint32_t state[8], uint8_t const *src,
+				 uint32_t blocks);
+
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	sha256_armv7_process(ctx->state, data, blocks);
+}
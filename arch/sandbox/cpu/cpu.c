@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <log.h>
 #include <os.h>
+#include <worker.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
 #include <asm/malloc.h>
@@ -450,3 +451,24 @@ int sandbox_load_other_fdt(void **fdtp, int *sizep)
 
 	return 0;
 }
+
+#if CONFIG_IS_ENABLED(WORKER)
+/* Each secondary CPU is a host thread, started for each batch of jobs */
+static void *worker_thread[CONFIG_WORKER_MAX];
+
+int arch_worker_count(void)
+{
+	return CONFIG_WORKER_MAX;
+}
+
+int arch_worker_start(int cpu, worker_func_t func, void *priv)
+{
+	return os_thread_start(&worker_thread[cpu], func, priv);
+}
+
+void arch_worker_wait(int cpu)
+{
+	os_thread_join(worker_thread[cpu]);
+	worker_thread[cpu] = NULL;
+}
+#endif
@@ -1124,6 +1124,47 @@ void os_relaunch(char *argv[])
 	os_exit(1);
 }
 
+struct os_thread {
+	pthread_t tid;
+	void (*func)(void *priv);
+	void *priv;
+};
+
+static void *os_thread_run(void *arg)
+{
+	struct os_thread *thread = arg;
+
+	thread->func(thread->priv);
+
+	return NULL;
+}
+
+int os_thread_start(void **threadp, void (*func)(void *priv), void *priv)
+{
+	struct os_thread *thread;
+
+	thread = os_malloc(sizeof(*thread));
+	if (!thread)
+		return -ENOMEM;
+	thread->func = func;
+	thread->priv = priv;
+	if (pthread_create(&thread->tid, NULL, os_thread_run, thread)) {
+		os_free(thread);
+		return -EAGAIN;
+	}
+	*threadp = thread;
+
+	return 0;
+}
+
+void os_thread_join(void *thread_ptr)
+{
+	struct os_thread *thread = thread_ptr;
+
+	pthread_join(thread->tid, NULL);
+	os_free(thread);
+}
+
 #ifdef CONFIG_FUZZ
 static void *fuzzer_thread(void * ptr)
 {
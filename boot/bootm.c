@@ -5,6 +5,7 @@
  */
 
 #ifndef USE_HOSTCC
+#include <blk.h>
 #include <bootm.h>
 #include <bootstage.h>
 #include <cli.h>
@@ -597,6 +598,75 @@ static int handle_decomp_error(int comp_type, size_t uncomp_size,
 #endif
 
 #ifndef USE_HOSTCC
+/**
+ * bootm_decomp_inplace() - Prepare to decompress the OS over its own data
+ *
+ * The compressed data overlaps the region it decompresses to. Move it to the
+ * end of that region, leaving the margin the decompressor needs, so that it
+ * can be decompressed in place. Any hashes left to be checked during
+ * decompression are checked first, since the data is about to be overwritten.
+ *
+ * The whole region used, which may extend past the decompressed kernel, is
+ * reserved in the LMB. The caller frees the part after the kernel once it is
+ * decompressed.
+ *
+ * @images:	Images being booted
+ * @os:		OS image; os->image_start is updated if the data is moved
+ * @load:	Address to decompress to
+ * @size:	Decompressed size
+ * @margin:	Margin needed after the decompressed data
+ * Return: 0 if OK, -EXDEV if the space needed overlaps the ramdisk or FDT or
+ *	is in use, -EACCES if a hash is wrong
+ */
+static int bootm_decomp_inplace(struct bootm_headers *images,
+				struct image_info *os, ulong load, ulong size,
+				ulong margin)
+{
+	ulong start = os->image_start;
+	ulong end;
+
+	if (start + os->image_len < load + size + margin)
+		start = ALIGN(load + size + margin - os->image_len,
+			      ARCH_DMA_MINALIGN);
+	end = start + os->image_len;
+
+	if (check_overlap("RD", images->rd_start, images->rd_end, load,
+			  end - load) ||
+	    (images->ft_addr &&
+	     check_overlap("FDT", map_to_sysmem(images->ft_addr),
+			   map_to_sysmem(images->ft_addr) + images->ft_len,
+			   load, end - load)))
+		return -EXDEV;
+
+	if (CONFIG_IS_ENABLED(LMB) &&
+		printf("ERROR: %lx..%lx is in use, cannot decompress here\n",
+		printf("ERROR: %lx..%lx is in use, cannot decompress in place\n",
+		       load, end);
+		return -EXDEV;
+	}
+
+	if (CONFIG_IS_ENABLED(FIT_HASH_STREAM) && images->os_hash.count) {
+		fit_image_hash_update(&images->os_hash,
+				      map_sysmem(os->image_start, os->image_len),
+				      os->image_len);
+		if (fit_image_hash_finish(&images->os_hash)) {
+			bootstage_error(BOOTSTAGE_ID_FIT_KERNEL_START +
+					BOOTSTAGE_SUB_HASH);
+			return -EACCES;
+		}
+	}
+
+	debug("   decompressing in place, moving %lx bytes from %lx to %lx\n",
+	      os->image_len, os->image_start, start);
+	if (start != os->image_start)
+		memmove(map_sysmem(start, os->image_len),
+			map_sysmem(os->image_start, os->image_len),
+			os->image_len);
+	os->image_start = start;
+
+	return 0;
+}
+
 static int bootm_load_os(struct bootm_headers *images, int boot_progress)
 {
 	struct image_info os = images->os;
@@ -607,19 +677,32 @@ static int bootm_load_os(struct bootm_headers *images, int boot_progress)
 	ulong image_start = os.image_start;
 	ulong image_len = os.image_len;
 	ulong flush_start = ALIGN_DOWN(load, ARCH_DMA_MINALIGN);
-	bool no_overlap;
+	ulong unc_size = 0, margin, req_size = 0;
+	ulong buf_size = CONFIG_SYS_BOOTM_LEN;
+	ulong inplace_end = 0;
+	bool no_overlap, inplace = false;
 	void *load_buf, *image_buf;
 	int err;
 
+	/* The decompressed size is known in advance for some formats */
+	if (IS_ENABLED(CONFIG_BOOTM_DECOMP_INPLACE) &&
+	    image_decomp_margin(os.comp, map_sysmem(image_start, image_len),
+				image_len, &unc_size, &margin))
+		unc_size = 0;
+
 	/*
 	 * For a "noload" compressed kernel we need to allocate a buffer large
 	 * enough to decompress in to and use that as the load address now.
-	 * Assume that the kernel compression is at most a factor of 4 since
-	 * zstd almost achieves that.
+	 * Unless the size is known, assume that the kernel compression is at
+	 * most a factor of 4 since zstd almost achieves that.
 	 * Use an alignment of 2MB since this might help arm64
+	 *
+	 * The size in the image header is not checked, so limit decompression
+	 * to the buffer rather than to CONFIG_SYS_BOOTM_LEN.
 	 */
 	if (os.type == IH_TYPE_KERNEL_NOLOAD && os.comp != IH_COMP_NONE) {
-		ulong req_size = ALIGN(image_len * 4, SZ_1M);
+		req_size = ALIGN(unc_size ?: image_len * 4, SZ_1M);
+		buf_size = min_t(ulong, req_size, buf_size);
 
 		load = lmb_alloc(req_size, SZ_2M);
 		if (!load)
@@ -628,28 +711,61 @@ static int bootm_load_os(struct bootm_headers *images, int boot_progress)
 		images->ep = load;
 		debug("Allocated %lx bytes at %lx for kernel (size %lx) decompression\n",
 		      req_size, load, image_len);
+	} else if (unc_size && unc_size <= CONFIG_SYS_BOOTM_LEN &&
+		   image_start < load + unc_size &&
+		   image_start + image_len > load) {
+		err = bootm_decomp_inplace(images, &os, load, unc_size, margin);
+		if (err)
+			return err;
+		image_start = os.image_start;
+		inplace_end = image_start + image_len;
+		inplace = true;
 	}
 
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
-	err = image_decomp(os.comp, load, os.image_start, os.type,
-			   load_buf, image_buf, image_len,
-			   CONFIG_SYS_BOOTM_LEN, &load_end);
+	if (inplace) {
+		err = image_decomp(os.comp, load, os.image_start, os.type,
+				   load_buf, image_buf, image_len, unc_size,
+				   &load_end);
+	} else if (CONFIG_IS_ENABLED(FIT_HASH_STREAM) &&
+		   images->os_hash.count) {
+		/* fit_image_load() left the hashes to be checked here */
+		err = image_decomp_input(os.comp, load, os.image_start, os.type,
+					 load_buf, image_buf, image_len,
+					 buf_size, &load_end,
+					 fit_image_hash_update,
+					 &images->os_hash);
+		if (fit_image_hash_finish(&images->os_hash)) {
+			bootstage_error(BOOTSTAGE_ID_FIT_KERNEL_START +
+					BOOTSTAGE_SUB_HASH);
+			return -EACCES;
+		}
+	} else {
+		err = image_decomp(os.comp, load, os.image_start, os.type,
+				   load_buf, image_buf, image_len,
+				   buf_size, &load_end);
+	}
 	if (err) {
-		err = handle_decomp_error(os.comp, load_end - load,
-					  CONFIG_SYS_BOOTM_LEN, err);
+		err = handle_decomp_error(os.comp, load_end - load, buf_size,
+					  err);
 		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
 		return err;
 	}
 	/* We need the decompressed image size in the next steps */
 	images->os.image_len = load_end - load;
 
+	/* Give back what was not needed of a buffer allocated above */
+	if (req_size > ALIGN(load_end - load, SZ_1M))
+		lmb_free(load + ALIGN(load_end - load, SZ_1M),
+			 req_size - ALIGN(load_end - load, SZ_1M));
+
 	flush_cache(flush_start, ALIGN(load_end, ARCH_DMA_MINALIGN) - flush_start);
 
 	debug("   kernel loaded at 0x%08lx, end = 0x%08lx\n", load, load_end);
 	bootstage_mark(BOOTSTAGE_ID_KERNEL_LOADED);
 
-	no_overlap = (os.comp == IH_COMP_NONE && load == image_start);
+	no_overlap = (os.comp == IH_COMP_NONE && load == image_start) || inplace;
 
 	if (!no_overlap && load < blob_end && load_end > blob_start) {
 		debug("images.os.start = 0x%lX, images.os.end = 0x%lx\n",
@@ -695,9 +811,13 @@ static int bootm_load_os(struct bootm_headers *images, int boot_progress)
 		images->os.end = relocated_addr + image_size;
 	}
 
-	if (CONFIG_IS_ENABLED(LMB))
+	if (CONFIG_IS_ENABLED(LMB)) {
 		lmb_reserve(images->os.load, (load_end - images->os.load),
 			    LMB_NONE);
+		/* Give back what in-place decompression used past the kernel */
+		if (inplace_end > load_end)
+			lmb_free(load_end, inplace_end - load_end);
+	}
 
 	return 0;
 }
@@ -981,8 +1101,16 @@ int bootm_run_states(struct bootm_info *bmi, int states)
 	if (!ret && (states & BOOTM_STATE_PRE_LOAD))
 		ret = bootm_pre_load(bmi->addr_img);
 
-	if (!ret && (states & BOOTM_STATE_FINDOS))
+	if (!ret && (states & BOOTM_STATE_FINDOS)) {
+		/*
+		 * Kernel hashes may only be left to bootm_load_os() if it is
+		 * run in the same call, so that they cannot be skipped
+		 */
+		images->os_hash.wanted = states & BOOTM_STATE_LOADOS;
+		/* Likewise, other images may be checked along with the kernel */
+		images->verified.wanted = states & BOOTM_STATE_FINDOTHER;
 		ret = bootm_find_os(bmi->cmd_name, bmi->addr_img);
+	}
 
 	if (!ret && (states & BOOTM_STATE_FINDOTHER)) {
 		ulong img_addr;
@@ -992,6 +1120,7 @@ int bootm_run_states(struct bootm_info *bmi, int states)
 		ret = bootm_find_other(img_addr, bmi->conf_ramdisk,
 				       bmi->conf_fdt);
 	}
+	memset(&images->verified, '\0', sizeof(images->verified));
 
 	if (IS_ENABLED(CONFIG_MEASURED_BOOT) && !ret &&
 	    (states & BOOTM_STATE_MEASURE))
@@ -1044,6 +1173,12 @@ int bootm_run_states(struct bootm_info *bmi, int states)
 		return 1;
 	}
 
+	/* Nothing may be left in the block cache once the OS is running */
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE) &&
+	    (states & (BOOTM_STATE_OS_PREP | BOOTM_STATE_OS_GO)) &&
+	    blk_flush_all())
+		printf("WARNING: block cache flush failed\n");
+
 	/* Call various other states that are not generally used */
 	if (!ret && (states & BOOTM_STATE_OS_CMDLINE))
 		ret = boot_fn(BOOTM_STATE_OS_CMDLINE, bmi);
@@ -25,11 +25,8 @@
 #include <asm/io.h>
 #include <malloc.h>
 #include <memalign.h>
+#include <worker.h>
 #include <asm/global_data.h>
-#ifdef CONFIG_DM_HASH
-#include <dm.h>
-#include <u-boot/hash.h>
-#endif
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
@@ -1249,31 +1246,7 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *name,
 			uint8_t *value, int *value_len)
 {
-#if !defined(USE_HOSTCC) && defined(CONFIG_DM_HASH)
-	int rc;
-	enum HASH_ALGO hash_algo;
-	struct udevice *dev;
-
-	rc = uclass_get_device(UCLASS_HASH, 0, &dev);
-	if (rc) {
-		debug("failed to get hash device, rc=%d\n", rc);
-		return -1;
-	}
-
-	hash_algo = hash_algo_lookup_by_name(name);
-	if (hash_algo == HASH_ALGO_INVALID) {
-		debug("Unsupported hash algorithm\n");
-		return -1;
-	};
-
-	rc = hash_digest_wd(dev, hash_algo, data, data_len, value, CHUNKSZ);
-	if (rc) {
-		debug("failed to get hash value, rc=%d\n", rc);
-		return -1;
-	}
-
-	*value_len = hash_algo_digest_size(hash_algo);
-#else
+	struct image_region region = { data, data_len };
 	struct hash_algo *algo;
 	int ret;
 
@@ -1283,9 +1256,8 @@ int calculate_hash(const void *data, int data_len, const char *name,
 		return -1;
 	}
 
-	algo->hash_func_ws(data, data_len, value, algo->chunk_size);
+	hash_regions(algo, &region, 1, value);
 	*value_len = algo->digest_size;
-#endif
 
 	return 0;
 }
@@ -1437,6 +1409,303 @@ err:
 	return 0;
 }
 
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(FIT_HASH_STREAM)
+/* Check whether any key requires images to be signed */
+static bool fit_image_sig_required(const void *key_blob)
+{
+	const char *required;
+	int key_node, noffset;
+
+	key_node = fdt_subnode_offset(key_blob, 0, FIT_SIG_NODENAME);
+	if (key_node < 0)
+		return false;
+	fdt_for_each_subnode(noffset, key_blob, key_node) {
+		required = fdt_getprop(key_blob, noffset, FIT_KEY_REQUIRED,
+				       NULL);
+		if (required && !strcmp(required, "image"))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Complete the hashes and compare them with the FIT. If @show, show each
+ * algorithm checked and any error, as fit_image_verify() does.
+ */
+static int fit_image_hash_check(struct fit_hash_stream *hs, bool show)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, value, FIT_MAX_HASH_LEN);
+	const char *err_msg = NULL;
+	struct hash_algo *algo;
+	int fit_value_len;
+	uint8_t *fit_value;
+	int i, bad = 0;
+
+	for (i = 0; i < hs->count; i++) {
+		algo = hs->hash[i].algo;
+		if (!hs->hash[i].ctx) {
+			if (show && !err_msg)
+				printf("%s-skipped ", algo->name);
+			continue;
+		}
+
+		/* finish every hash, to free its context */
+		algo->hash_finish(algo, hs->hash[i].ctx, value,
+				  algo->digest_size);
+		if (err_msg)
+			continue;
+		if (show)
+			printf("%s", algo->name);
+		if (fit_image_hash_get_value(hs->fit, hs->hash[i].noffset,
+					     &fit_value, &fit_value_len))
+			err_msg = "Can't get hash value property";
+		else if (fit_value_len != algo->digest_size)
+			err_msg = "Bad hash value len";
+		else if (memcmp(value, fit_value, fit_value_len))
+			err_msg = "Bad hash value";
+		if (err_msg)
+			bad = i;
+		else if (show)
+			puts("+ ");
+	}
+	hs->count = 0;
+
+	if (err_msg) {
+		if (show)
+			printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+			       err_msg,
+			       fit_get_name(hs->fit, hs->hash[bad].noffset,
+					    NULL),
+			       fit_get_name(hs->fit, hs->noffset, NULL));
+		return -EACCES;
+	}
+
+	return 0;
+}
+
+int fit_image_hash_start(const void *fit, int noffset,
+			 struct fit_hash_stream *hs)
+{
+	struct hash_algo *algo;
+	const char *algo_name;
+	int hash_noffset;
+	int i, ignore;
+
+	hs->count = 0;
+	hs->fit = fit;
+	hs->noffset = noffset;
+	if (FIT_IMAGE_ENABLE_VERIFY && fit_image_sig_required(gd_fdt_blob()))
+		return -ENOTSUPP;
+
+	/* signature and cipher nodes need the whole image */
+	fdt_for_each_subnode(hash_noffset, fit, noffset) {
+		const char *name = fit_get_name(fit, hash_noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)) ||
+		    hs->count == FIT_HASH_STREAM_MAX ||
+		    fit_image_hash_get_algo(fit, hash_noffset, &algo_name) ||
+		    hash_progressive_lookup_algo(algo_name, &algo))
+			return -ENOTSUPP;
+		hs->hash[hs->count].algo = algo;
+		hs->hash[hs->count].ctx = NULL;
+		hs->hash[hs->count].noffset = hash_noffset;
+		hs->count++;
+	}
+	if (!hs->count)
+		return -ENOTSUPP;
+
+	for (i = 0; i < hs->count; i++) {
+		algo = hs->hash[i].algo;
+		fit_image_hash_get_ignore(fit, hs->hash[i].noffset, &ignore);
+		if (!ignore && algo->hash_init(algo, &hs->hash[i].ctx)) {
+			hs->count = i;
+			fit_image_hash_check(hs, false);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+void fit_image_hash_update(void *priv, const void *buf, ulong size)
+{
+	struct fit_hash_stream *hs = priv;
+	struct hash_algo *algo;
+	int i;
+
+	for (i = 0; i < hs->count; i++) {
+		algo = hs->hash[i].algo;
+		if (hs->hash[i].ctx)
+			algo->hash_update(algo, hs->hash[i].ctx, buf, size, 0);
+	}
+}
+
+int fit_image_hash_finish(struct fit_hash_stream *hs)
+{
+	puts("   Verifying Hash Integrity ... ");
+	if (fit_image_hash_check(hs, true)) {
+		puts("Bad Data Hash\n");
+		return -EACCES;
+	}
+	puts("OK\n");
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(FIT_PARALLEL_HASH)
+/**
+ * struct fit_hash_job - Hashes of an image calculated by worker_run()
+ *
+ * @hs:		Hashing state; hs.noffset is the image node
+ * @started:	true if the hashes were started, false if the image must be
+ *		checked with fit_image_verify() instead
+ * @data:	Image data
+ * @size:	Size of image data
+ */
+struct fit_hash_job {
+	struct fit_hash_stream hs;
+	bool started;
+	const void *data;
+	size_t size;
+};
+
+static void fit_hash_job_run(void *priv)
+{
+	struct fit_hash_job *job = priv;
+
+	fit_image_hash_update(&job->hs, job->data, job->size);
+}
+
+/*
+ * Start the hashes of each image given by jobs[].hs.noffset and calculate
+ * them all on the available CPUs, ready for fit_image_hash_check()
+ */
+static int fit_hash_jobs_run(const void *fit, struct fit_hash_job *jobs,
+			     int count)
+{
+	struct worker_job *work;
+	int i, n;
+
+	work = calloc(count, sizeof(*work));
+	if (!work)
+		return -ENOMEM;
+	for (i = 0, n = 0; i < count; i++) {
+		struct fit_hash_job *job = &jobs[i];
+		int noffset = job->hs.noffset;
+
+		if (fit_image_get_data(fit, noffset, &job->data, &job->size) ||
+		    fit_image_hash_start(fit, noffset, &job->hs)) {
+			job->hs.noffset = noffset;
+			continue;
+		}
+		job->started = true;
+		work[n].func = fit_hash_job_run;
+		work[n].priv = job;
+		n++;
+	}
+	worker_run(work, n);
+	free(work);
+
+	return 0;
+}
+
+/* As fit_all_image_verify(), but hashing the images on all CPUs */
+static int fit_all_image_verify_parallel(const void *fit, int images_noffset)
+{
+	struct fit_hash_job *jobs;
+	int noffset, count, i;
+	int ret = 1;
+
+	count = 0;
+	fdt_for_each_subnode(noffset, fit, images_noffset)
+		count++;
+	jobs = calloc(count, sizeof(*jobs));
+	if (!jobs)
+		return -ENOMEM;
+	i = 0;
+	fdt_for_each_subnode(noffset, fit, images_noffset)
+		jobs[i++].hs.noffset = noffset;
+	if (fit_hash_jobs_run(fit, jobs, count)) {
+		free(jobs);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct fit_hash_job *job = &jobs[i];
+
+		if (!ret) {
+			/* free the contexts of the remaining hashes */
+			if (job->started)
+				fit_image_hash_check(&job->hs, false);
+			continue;
+		}
+		printf("   Hash(es) for Image %u (%s): ", i,
+		       fit_get_name(fit, job->hs.noffset, NULL));
+		if (job->started ? fit_image_hash_check(&job->hs, true) :
+		    !fit_image_verify(fit, job->hs.noffset))
+			ret = 0;
+		else
+			printf("\n");
+	}
+	free(jobs);
+
+	return ret;
+}
+
+/*
+ * Check the images used by a configuration all at once, apart from
+ * @skip_noffset, recording those which pass in @verified
+ */
+static void fit_conf_hash_images(const void *fit, int cfg_noffset,
+				 int skip_noffset, struct fit_verified *verified)
+{
+	struct fit_hash_job jobs[FIT_VERIFIED_MAX];
+	const char *name, *uname;
+	int prop, noffset;
+	int count, i, j, n;
+
+	verified->fit = fit;
+	verified->count = 0;
+	memset(jobs, '\0', sizeof(jobs));
+	count = 0;
+	fdt_for_each_property_offset(prop, fit, cfg_noffset) {
+		if (!fdt_getprop_by_offset(fit, prop, &name, NULL) ||
+		    !strcmp(name, FIT_DESC_PROP) || !strcmp(name, "compatible"))
+			continue;
+		n = fdt_stringlist_count(fit, cfg_noffset, name);
+		for (i = 0; i < n && count < FIT_VERIFIED_MAX; i++) {
+			uname = fdt_stringlist_get(fit, cfg_noffset, name, i,
+						   NULL);
+			noffset = fit_image_get_node(fit, uname);
+			if (noffset < 0 || noffset == skip_noffset)
+				continue;
+			for (j = 0; j < count; j++) {
+				if (jobs[j].hs.noffset == noffset)
+					break;
+			}
+			if (j == count)
+				jobs[count++].hs.noffset = noffset;
+		}
+	}
+	if (count < 2 || fit_hash_jobs_run(fit, jobs, count))
+		return;
+
+	for (i = 0; i < count; i++) {
+		struct fit_hash_job *job = &jobs[i];
+
+		/* failures are shown when the image is checked again */
+		if (job->started && !fit_image_hash_check(&job->hs, false)) {
+			n = verified->count++;
+			verified->image[n].noffset = job->hs.noffset;
+			verified->image[n].data = job->data;
+			verified->image[n].size = job->size;
+		}
+	}
+}
+#endif /* FIT_PARALLEL_HASH */
+#endif /* !USE_HOSTCC && FIT_HASH_STREAM */
+
 /**
  * fit_all_image_verify - verify data integrity for all images
  * @fit: pointer to the FIT format image header
@@ -1466,6 +1735,15 @@ int fit_all_image_verify(const void *fit)
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(FIT_PARALLEL_HASH)
+	{
+	int ret;
+
+	ret = fit_all_image_verify_parallel(fit, images_noffset);
+	if (ret != -ENOMEM)
+		return ret;
+	}
+#endif
 	for (ndepth = 0, count = 0,
 	     noffset = fdt_next_node(fit, images_noffset, &ndepth);
 			(noffset >= 0) && (ndepth > 0);
@@ -1964,13 +2242,62 @@ int fit_get_data_conf_prop(const void *fit, const char *prop_name,
 	return fit_get_data_tail(fit, noffset, data, size);
 }
 
-static int fit_image_select(const void *fit, int rd_noffset, int verify)
+/* Check whether an image passed when its configuration was selected */
+static bool fit_image_verified(const struct fit_verified *verified,
+			       const void *fit, int noffset)
+{
+	int i;
+
+	if (verified->fit != fit)
+		return false;
+	for (i = 0; i < verified->count; i++) {
+		if (verified->image[i].noffset == noffset)
+			return true;
+	}
+
+	return false;
+}
+
+/* Forget images whose data is overwritten by loading another image */
+static void fit_verified_drop(struct fit_verified *verified, ulong load,
+			      ulong len)
+{
+	int i;
+
+	for (i = 0; i < verified->count; i++) {
+		ulong start = map_to_sysmem(verified->image[i].data);
+
+		if (load < start + verified->image[i].size &&
+		    load + len > start)
+			verified->image[i--] = verified->image[--verified->count];
+	}
+}
+
+/* Show the hashes of an image which was already checked */
+static void fit_image_show_hashes(const void *fit, int image_noffset)
+{
+	const char *algo;
+	int noffset;
+	int ignore;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		fit_image_hash_get_ignore(fit, noffset, &ignore);
+		printf("%s%s ", algo, ignore ? "-skipped" : "+");
+	}
+}
+
+static int fit_image_select(const void *fit, int rd_noffset, int verify,
+			    bool verified)
 {
 	fit_image_print(fit, rd_noffset, "   ");
 
 	if (verify) {
 		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
+		if (verified) {
+			fit_image_show_hashes(fit, rd_noffset);
+		} else if (!fit_image_verify(fit, rd_noffset)) {
 			puts("Bad Data Hash\n");
 			return -EACCES;
 		}
@@ -2063,12 +2390,14 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 	ulong load, load_end, data, len;
 	uint8_t os, comp;
 	const char *prop_name;
+	bool stream;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
 	fit_uname = fit_unamep ? *fit_unamep : NULL;
 	fit_uname_config = fit_uname_configp ? *fit_uname_configp : NULL;
 	fit_base_uname_config = NULL;
+	cfg_noffset = -1;
 	prop_name = fit_get_image_type_property(ph_type);
 	printf("## Loading %s (%s) from FIT Image at %08lx ...\n",
 	       prop_name, genimg_get_phase_name(image_ph_phase(ph_type)), addr);
@@ -2138,7 +2467,35 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/*
+	 * The hashes of a compressed kernel can be checked as bootm_load_os()
+	 * decompresses it, rather than reading the whole image beforehand
+	 */
+	stream = !tools_build() && CONFIG_IS_ENABLED(FIT_HASH_STREAM) &&
+		images->verify && images->os_hash.wanted &&
+		load_op == FIT_LOAD_IGNORED &&
+		(image_type == IH_TYPE_KERNEL ||
+		 image_type == IH_TYPE_KERNEL_NOLOAD) &&
+		!fit_image_get_comp(fit, noffset, &comp) &&
+		comp != IH_COMP_NONE;
+
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(FIT_PARALLEL_HASH)
+	/* Check the other images of the configuration at the same time */
+	if (cfg_noffset >= 0 && images->verify && images->verified.wanted &&
+	    !images->verified.fit)
+		fit_conf_hash_images(fit, cfg_noffset, stream ? noffset : -1,
+				     &images->verified);
+#endif
+
+	if (stream && !fit_image_hash_start(fit, noffset, &images->os_hash)) {
+		fit_image_print(fit, noffset, "   ");
+		puts("   Verifying Hash Integrity ... while loading\n");
+		ret = 0;
+	} else {
+		ret = fit_image_select(fit, noffset, images->verify,
+				       fit_image_verified(&images->verified,
+							  fit, noffset));
+	}
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2275,6 +2632,9 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 		} else {
 			loadbuf = map_sysmem(load, max_decomp_len);
 		}
+		if (CONFIG_IS_ENABLED(FIT_PARALLEL_HASH))
+			fit_verified_drop(&images->verified, load,
+					  max_decomp_len);
 		if (image_decomp(comp, load, data, image_type,
 				loadbuf, buf, len, max_decomp_len, &load_end)) {
 			printf("Error decompressing %s\n", prop_name);
@@ -2284,6 +2644,8 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 		len = load_end - load;
 	} else if (load != data) {
 		log_debug("copying\n");
+		if (CONFIG_IS_ENABLED(FIT_PARALLEL_HASH))
+			fit_verified_drop(&images->verified, load, len);
 		loadbuf = map_sysmem(load, len);
 		memcpy(loadbuf, buf, len);
 	}
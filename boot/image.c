@@ -7,12 +7,14 @@
  */
 
 #ifndef USE_HOSTCC
+#include <decomp_stream.h>
 #include <env.h>
 #include <display_options.h>
 #include <init.h>
 #include <lmb.h>
 #include <log.h>
 #include <malloc.h>
+#include <watchdog.h>
 #include <u-boot/crc.h>
 
 #ifdef CONFIG_SHOW_BOOT_PROGRESS
@@ -447,25 +449,19 @@ int image_decomp_type(const unsigned char *buf, ulong len)
 	return cmagic->comp_id;
 }
 
-int image_decomp(int comp, ulong load, ulong image_start, int type,
-		 void *load_buf, void *image_buf, ulong image_len,
-		 uint unc_len, ulong *load_end)
+int image_decomp_data(int comp, void *load_buf, void *image_buf,
+		      ulong image_len, uint unc_len, ulong *sizep)
 {
 	int ret = -ENOSYS;
 
-	*load_end = load;
-	print_decomp_msg(comp, type, load == image_start, load);
-
 	/*
-	 * Load the image to the right place, decompressing if needed. After
-	 * this, image_len will be set to the number of uncompressed bytes
-	 * loaded, ret will be non-zero on error.
+	 * Decompress the image, or copy it if not compressed. After this,
+	 * image_len will be set to the number of uncompressed bytes loaded,
+	 * ret will be non-zero on error.
 	 */
 	switch (comp) {
 	case IH_COMP_NONE:
 		ret = 0;
-		if (load == image_start)
-			break;
 		if (image_len <= unc_len)
 			memmove_wd(load_buf, image_buf, image_len, CHUNKSZ);
 		else
@@ -528,16 +524,122 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		}
 		break;
 	}
-	if (ret == -ENOSYS) {
-		printf("Unimplemented compression type %d\n", comp);
+	*sizep = image_len;
+
+	return ret;
+}
+
+int image_decomp_margin(int comp, const void *image_buf, ulong image_len,
+			ulong *sizep, ulong *marginp)
+{
+	size_t size, margin;
+	int ret = -ENOSYS;
+
+	switch (comp) {
+	case IH_COMP_LZ4:
+		if (!tools_build() && CONFIG_IS_ENABLED(LZ4))
+			ret = ulz4fn_inplace_margin(image_buf, image_len, &size,
+						    &margin);
+		break;
+	case IH_COMP_ZSTD:
+		if (!tools_build() && CONFIG_IS_ENABLED(ZSTD))
+			ret = zstd_inplace_margin(image_buf, image_len, &size,
+						  &margin);
+		break;
+	}
+	if (ret)
 		return ret;
+	*sizep = size;
+	*marginp = margin;
+
+	return 0;
+}
+
+int image_decomp(int comp, ulong load, ulong image_start, int type,
+		 void *load_buf, void *image_buf, ulong image_len,
+		 uint unc_len, ulong *load_end)
+{
+	return image_decomp_input(comp, load, image_start, type, load_buf,
+				  image_buf, image_len, unc_len, load_end, NULL,
+				  NULL);
+}
+
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(DECOMP_STREAM)
+/*
+ * Decompress in pieces, handing each one to @input just before it is
+ * decompressed, so it is still in the cache. All of the input is passed to
+ * @input exactly once, whether or not decompression succeeds.
+ */
+static int image_decomp_stream(int comp, ulong load, void *load_buf,
+			       const u8 *image_buf, ulong image_len,
+			       uint unc_len, ulong *load_end,
+			       image_input_t input, void *priv)
+{
+	struct decomp_stream ds;
+	ulong pos, len;
+	long size;
+	int ret;
+
+	ret = decomp_stream_init(&ds, comp, load_buf, unc_len);
+	if (ret) {
+		input(priv, image_buf, image_len);
+		return ret;
+	}
+	for (pos = 0; pos < image_len && !ds.done; pos += len) {
+		len = min_t(ulong, image_len - pos, CHUNKSZ);
+		input(priv, image_buf + pos, len);
+		ret = decomp_stream_feed(&ds, image_buf + pos, len);
+		if (ret) {
+			pos += len;
+			break;
+		}
+		schedule();
 	}
+	/* a trailer, anything after the stream or the rest after an error */
+	if (pos < image_len)
+		input(priv, image_buf + pos, image_len - pos);
 
-	*load_end = load + image_len;
+	size = decomp_stream_finish(&ds);
+	*load_end = load + ds.out_len;
 	if (ret)
 		return ret;
 
-	return 0;
+	return size < 0 ? size : 0;
+}
+#endif
+
+int image_decomp_input(int comp, ulong load, ulong image_start, int type,
+		       void *load_buf, void *image_buf, ulong image_len,
+		       uint unc_len, ulong *load_end, image_input_t input,
+		       void *priv)
+{
+	int ret;
+
+	*load_end = load;
+	print_decomp_msg(comp, type, load == image_start, load);
+
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(DECOMP_STREAM)
+	if (input && decomp_stream_supported(comp))
+		return image_decomp_stream(comp, load, load_buf, image_buf,
+					   image_len, unc_len, load_end, input,
+					   priv);
+#endif
+	if (input)
+		input(priv, image_buf, image_len);
+
+	if (comp == IH_COMP_NONE && load == image_start) {
+		*load_end = load + image_len;
+		return 0;
+	}
+	ret = image_decomp_data(comp, load_buf, image_buf, image_len, unc_len,
+				&image_len);
+	if (ret == -ENOSYS) {
+		printf("Unimplemented compression type %d\n", comp);
+		return ret;
+	}
+	*load_end = load + image_len;
+
+	return ret;
 }
 
 const table_entry_t *get_table_entry(const table_entry_t *table, int id)
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Block device I/O statistics
+ */
+
+#include <blk.h>
+#include <command.h>
+#include <part.h>
+#include <vsprintf.h>
+#include <dm/device.h>
+
+static const char *const blk_stats_op_name[BLK_STATS_OPS] = {
+	[BLK_STATS_READ]	= "read",
+	[BLK_STATS_WRITE]	= "write",
+	[BLK_STATS_ERASE]	= "erase",
+};
+
+static bool blk_stats_used(const struct blk_desc *desc)
+{
+	int op;
+
+	for (op = 0; op < BLK_STATS_OPS; op++) {
+		if (desc->stats.op[op].reqs)
+			return true;
+	}
+
+	return desc->stats.cache_hits;
+}
+
+static void blk_stats_show_line(const char *name, const char *op,
+				const struct blk_desc *desc,
+				const struct blk_op_stats *st)
+{
+	printf("%-12s %-5s %8u %6u %10llu %12llu %10llu %8u\n", name, op,
+	       st->reqs, st->errors, st->blocks, st->blocks * desc->blksz,
+	       st->time_us, st->max_us);
+}
+
+static void blk_stats_show_hist(const char *title, const char *unit,
+				const u32 *hist)
+{
+	ulong lo;
+	int i;
+
+	printf("  %s:\n", title);
+	for (i = 0; i < BLK_STATS_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		lo = i ? 1UL << (i - 1) : 0;
+		if (i == BLK_STATS_BUCKETS - 1)
+			printf("    %7lu and up %-6s %u\n", lo, unit, hist[i]);
+		else
+			printf("    %7lu - %-7lu %-6s %u\n", lo,
+			       i ? (1UL << i) - 1 : 0, unit, hist[i]);
+	}
+}
+
+static void blk_stats_show_all(void)
+{
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char name[20];
+	int op;
+
+	printf("%-12s %-5s %8s %6s %10s %12s %10s %8s\n", "Device", "Op",
+	       "Reqs", "Errors", "Blocks", "Bytes", "Time(us)", "Max(us)");
+	blk_foreach(BLKF_BOTH, dev) {
+		desc = dev_get_uclass_plat(dev);
+		if (!blk_stats_used(desc))
+			continue;
+		snprintf(name, sizeof(name), "%s %d",
+			 blk_get_uclass_name(desc->uclass_id), desc->devnum);
+		for (op = 0; op < BLK_STATS_OPS; op++) {
+			if (desc->stats.op[op].reqs)
+				blk_stats_show_line(name, blk_stats_op_name[op],
+						    desc, &desc->stats.op[op]);
+		}
+		if (desc->stats.cache_hits)
+			printf("%-12s %-5s %8u\n", name, "cache",
+			       desc->stats.cache_hits);
+	}
+}
+
+static void blk_stats_show_dev(struct blk_desc *desc)
+{
+	const struct blk_op_stats *st;
+	int op;
+
+	printf("%s %d: %u reads served from the block cache\n",
+	       blk_get_uclass_name(desc->uclass_id), desc->devnum,
+	       desc->stats.cache_hits);
+	for (op = 0; op < BLK_STATS_OPS; op++) {
+		st = &desc->stats.op[op];
+		if (!st->reqs)
+			continue;
+		printf("%s: %u requests, %u errors, %llu blocks, %llu us, max %u us\n",
+		       blk_stats_op_name[op], st->reqs, st->errors, st->blocks,
+		       st->time_us, st->max_us);
+		blk_stats_show_hist("latency", "us", st->lat_hist);
+		blk_stats_show_hist("size", "blocks", st->size_hist);
+	}
+}
+
+static int do_blk_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			char *const argv[])
+{
+	struct blk_desc *desc;
+	struct udevice *dev;
+
+	if (argc == 1) {
+		blk_stats_show_all();
+		return CMD_RET_SUCCESS;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "reset")) {
+		blk_foreach(BLKF_BOTH, dev)
+			blk_stats_reset(dev_get_uclass_plat(dev));
+		return CMD_RET_SUCCESS;
+	}
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	desc = blk_get_dev(argv[1], hextoul(argv[2], NULL));
+	if (!desc) {
+		printf("Device %s %s not found\n", argv[1], argv[2]);
+		return CMD_RET_FAILURE;
+	}
+	blk_stats_show_dev(desc);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD_WITH_SUBCMDS(
+	blk, "Block device information",
+	"stats - show I/O statistics of all block devices\n"
+	"blk stats <interface> <dev> - show I/O statistics with histograms\n"
+	"blk stats reset - clear I/O statistics\n",
+	U_BOOT_SUBCMD_MKENT(stats, 3, 0, do_blk_stats));
@@ -4,11 +4,19 @@
  * Author: Eric Nelson<eric@nelint.com>
  *
  */
+#include <blk.h>
 #include <command.h>
 #include <config.h>
 #include <malloc.h>
 #include <part.h>
 #include <vsprintf.h>
+#include <linux/math64.h>
+
+/* Return @part as a percentage of @total */
+static unsigned int blkc_percent(unsigned int part, unsigned int total)
+{
+	return total ? div_u64((u64)part * 100, total) : 0;
+}
 
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
@@ -18,32 +26,86 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "hit ratio: %u%%\n"
+	       "bytes served: %llu\n"
 	       "entries: %u\n"
+	       "bytes cached: %lu\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "cache size: %u MiB\n"
+	       "read-ahead: %u blocks\n"
+	       "read-ahead blocks: %u\n"
+	       "read-ahead used: %u (%u%%)\n"
+	       "write-back: %s\n"
+	       "dirty blocks: %u\n"
+	       "writes held: %u\n"
+	       "flush writes: %u (%u blocks)\n",
+	       stats.hits, stats.misses,
+	       blkc_percent(stats.hits, stats.hits + stats.misses),
+	       stats.bytes_served, stats.entries, stats.bytes,
+	       stats.max_blocks_per_entry, stats.size_mb, stats.readahead,
+	       stats.ra_blocks, stats.ra_hits,
+	       blkc_percent(stats.ra_hits, stats.ra_blocks),
+	       stats.writeback ? "on" : "off", stats.dirty, stats.wb_writes,
+	       stats.flush_writes, stats.flush_blocks);
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	unsigned blocks_per_entry, size_mb, readahead;
+	struct block_cache_stats stats;
+
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
+	/* reconfiguring drops the cache, so write back dirty blocks first */
+	if (blk_flush_all())
+		return CMD_RET_FAILURE;
+
+	blkcache_stats(&stats);
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	size_mb = simple_strtoul(argv[2], 0, 0);
+	readahead = argc == 4 ? simple_strtoul(argv[3], 0, 0) : stats.readahead;
+	blkcache_configure(blocks_per_entry, size_mb, readahead);
+	printf("changed to %u MiB, max %u blocks/entry, read-ahead %u blocks\n",
+	       size_mb, blocks_per_entry, readahead);
+	return 0;
+}
+
+static int blkc_flush(struct cmd_tbl *cmdtp, int flag,
+		      int argc, char *const argv[])
+{
+	if (blk_flush_all())
+		return CMD_RET_FAILURE;
+
+	return 0;
+}
+
+static int blkc_writeback(struct cmd_tbl *cmdtp, int flag,
+			  int argc, char *const argv[])
+{
+	if (argc != 2)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(argv[1], "on")) {
+		blkcache_set_writeback(true);
+	} else if (!strcmp(argv[1], "off")) {
+		if (blk_flush_all())
+			return CMD_RET_FAILURE;
+		blkcache_set_writeback(false);
+	} else {
+		return CMD_RET_USAGE;
+	}
+
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(flush, 0, 0, blkc_flush, "", ""),
+	U_BOOT_CMD_MKENT(writeback, 2, 0, blkc_writeback, "", ""),
 };
 
 static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
@@ -67,9 +129,11 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
-	"- set max blocks per entry and max cache entries\n"
+	"blkcache configure <blocks> <size_mb> [<readahead>] "
+	"- set max blocks per entry, cache size in MiB and read-ahead blocks\n"
+	"blkcache flush - write back dirty blocks\n"
+	"blkcache writeback on|off - hold small writes in the cache or not\n"
 );
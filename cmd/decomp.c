@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompression benchmark
+ */
+
+#include <command.h>
+#include <cpu.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <time.h>
+#include <vsprintf.h>
+#include <dm/uclass.h>
+#include <linux/math64.h>
+
+/* Get the CPU clock in Hz, or 0 if it is not known */
+static ulong decomp_cpu_freq(void)
+{
+	struct cpu_info info;
+	struct udevice *dev;
+
+	if (!CONFIG_IS_ENABLED(CPU) ||
+	    uclass_first_device_err(UCLASS_CPU, &dev) ||
+	    cpu_get_info(dev, &info))
+		return 0;
+
+	return info.cpu_freq;
+}
+
+static void decomp_show(int comp, ulong in_size, ulong out_size, int count,
+			ulong time_us, ulong heap)
+{
+	u64 bytes = (u64)out_size * count;
+	ulong freq = decomp_cpu_freq();
+	ulong rate, cycles;
+
+	/* bytes per microsecond is MB/s; show it to one decimal place */
+	rate = div64_u64(bytes * 10, time_us);
+	printf("%s: %lu -> %lu bytes, %d run%s, %lu us: %lu.%lu MB/s",
+	       genimg_get_comp_short_name(comp), in_size, out_size, count,
+	       count == 1 ? "" : "s", time_us, rate / 10, rate % 10);
+	if (freq && bytes) {
+		cycles = div64_u64((u64)time_us * (freq / 100), bytes * 100);
+		printf(", %lu.%02lu cycles/byte", cycles / 100, cycles % 100);
+	}
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_PEAK))
+		printf(", peak heap %lu bytes", heap);
+	printf("\n");
+}
+
+static int do_decomp_bench(struct cmd_tbl *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	ulong src, size, dst, dst_size, out_size, start, time_us, heap = 0;
+	int comp, count = 1;
+	void *in, *out;
+	int i, ret = 0;
+
+	if (argc > 2 && !strcmp(argv[1], "-n")) {
+		count = dectoul(argv[2], NULL);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc != 6 || count < 1)
+		return CMD_RET_USAGE;
+
+	comp = genimg_get_comp_id(argv[1]);
+	if (comp < 0) {
+		printf("Unknown compression type '%s'\n", argv[1]);
+		return CMD_RET_FAILURE;
+	}
+	src = hextoul(argv[2], NULL);
+	size = hextoul(argv[3], NULL);
+	dst = hextoul(argv[4], NULL);
+	dst_size = hextoul(argv[5], NULL);
+
+	in = map_sysmem(src, size);
+	out = map_sysmem(dst, dst_size);
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_PEAK))
+		malloc_peak_reset();
+	start = timer_get_us();
+	for (i = 0; i < count && !ret; i++)
+		ret = image_decomp_data(comp, out, in, size, dst_size,
+					&out_size);
+	time_us = max_t(ulong, timer_get_us() - start, 1);
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_PEAK))
+		heap = malloc_peak();
+	unmap_sysmem(out);
+	unmap_sysmem(in);
+
+	if (ret) {
+		printf("Decompression failed (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	decomp_show(comp, size, out_size, count, time_us, heap);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD_WITH_SUBCMDS(
+	decomp, "Decompression tools",
+	"bench [-n <count>] <type> <src> <size> <dst> <dst_size>\n"
+	"    - decompress data <count> times and show the speed and heap used",
+	U_BOOT_SUBCMD_MKENT(bench, 8, 0, do_decomp_bench));
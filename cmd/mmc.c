@@ -389,6 +389,14 @@ static lbaint_t mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+static lbaint_t mmc_sparse_erase(struct sparse_storage *info,
+				 lbaint_t blk, lbaint_t blkcnt)
+{
+	struct blk_desc *dev_desc = info->priv;
+
+	return blk_derase(dev_desc, blk, blkcnt);
+}
+
 static int do_mmc_sparse_write(struct cmd_tbl *cmdtp, int flag,
 			       int argc, char *const argv[])
 {
@@ -398,27 +406,32 @@ static int do_mmc_sparse_write(struct cmd_tbl *cmdtp, int flag,
 	char dest[11];
 	void *addr;
 	u32 blk;
+	int ret;
 
 	if (argc != 3)
 		return CMD_RET_USAGE;
 
-	addr = (void *)hextoul(argv[1], NULL);
+	addr = map_sysmem(hextoul(argv[1], NULL), 0);
 	blk = hextoul(argv[2], NULL);
 
 	if (!is_sparse_image(addr)) {
 		printf("Not a sparse image\n");
+		unmap_sysmem(addr);
 		return CMD_RET_FAILURE;
 	}
 
 	mmc = init_mmc_device(curr_device, false);
-	if (!mmc)
+	if (!mmc) {
+		unmap_sysmem(addr);
 		return CMD_RET_FAILURE;
+	}
 
 	printf("MMC Sparse write: dev # %d, block # %d ... ",
 	       curr_device, blk);
 
 	if (mmc_getwp(mmc) == 1) {
 		printf("Error: card is write protected!\n");
+		unmap_sysmem(addr);
 		return CMD_RET_FAILURE;
 	}
 
@@ -429,13 +442,19 @@ static int do_mmc_sparse_write(struct cmd_tbl *cmdtp, int flag,
 	sparse.size = dev_desc->lba - blk;
 	sparse.write = mmc_sparse_write;
 	sparse.reserve = mmc_sparse_reserve;
+	sparse.erase = NULL;
+	sparse.erase_grp = 0;
+	if (mmc_erase_reads_zero(mmc)) {
+		sparse.erase = mmc_sparse_erase;
+		sparse.erase_grp = mmc->erase_grp_size;
+	}
 	sparse.mssg = NULL;
 	sprintf(dest, "0x" LBAF, sparse.start * sparse.blksz);
 
-	if (write_sparse_image(&sparse, dest, addr, NULL))
-		return CMD_RET_FAILURE;
-	else
-		return CMD_RET_SUCCESS;
+	ret = write_sparse_image(&sparse, dest, addr, NULL);
+	unmap_sysmem(addr);
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
 }
 #endif
 
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompress an image in memory and write it to a block device
+ */
+
+#include <blk.h>
+#include <command.h>
+#include <env.h>
+#include <image.h>
+#include <mapmem.h>
+#include <part.h>
+#include <unzip_blk.h>
+#include <vsprintf.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+static int do_unzipblk(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	struct unzip_blk_stats stats;
+	ulong addr, len, bufsize = SZ_1M;
+	struct blk_desc *desc;
+	uint flags = 0;
+	u64 offset = 0;
+	ulong rate;
+	void *src;
+	int comp, ret;
+
+	if (argc > 1 && !strcmp(argv[1], "-e")) {
+		flags |= UNZIP_BLK_ERASE_ZERO;
+		argc--;
+		argv++;
+	}
+	if (argc < 5)
+		return CMD_RET_USAGE;
+	if (blk_get_device_by_str(argv[1], argv[2], &desc) < 0)
+		return CMD_RET_FAILURE;
+	addr = hextoul(argv[3], NULL);
+	len = hextoul(argv[4], NULL);
+	if (argc > 5)
+		bufsize = hextoul(argv[5], NULL);
+	if (argc > 6)
+		offset = simple_strtoull(argv[6], NULL, 16);
+	if (offset & (desc->blksz - 1)) {
+		printf("Offset %llx is not a multiple of %lx\n", offset,
+		       desc->blksz);
+		return CMD_RET_FAILURE;
+	}
+
+	src = map_sysmem(addr, len);
+	comp = image_decomp_type(src, len);
+	if (!unzip_blk_supported(comp)) {
+		printf("Unsupported compression type\n");
+		unmap_sysmem(src);
+		return CMD_RET_FAILURE;
+	}
+	ret = unzip_blk(comp, src, len, desc, bufsize,
+			lldiv(offset, desc->blksz), flags, &stats);
+	unmap_sysmem(src);
+
+	/* bytes per microsecond is MB/s; show it to one decimal place */
+	rate = stats.time_us ? div64_u64(stats.out_len * 10, stats.time_us) : 0;
+	printf("%s: %llu -> %llu bytes, %llu erased, %lu ms: %lu.%lu MB/s\n",
+	       genimg_get_comp_short_name(comp), stats.in_len, stats.out_len,
+	       stats.erased, stats.time_us / 1000, rate / 10, rate % 10);
+	if (ret) {
+		printf("Failed (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	env_set_hex("filesize", stats.out_len);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	unzipblk, 8, 0, do_unzipblk,
+	"decompress an image and write it to a block device",
+	"[-e] <interface> <dev> <addr> <len> [<bufsize> [<offset>]]\n"
+	"    - decompress the gzip, lz4 or zstd image at <addr> and write it\n"
+	"      to the device, starting <offset> bytes in (hex, default 0),\n"
+	"      with buffers of <bufsize> bytes (hex, default 100000)\n"
+	"    -e: erase buffers of zeroes instead of writing them, for devices\n"
+	"      whose erased blocks read as zero"
+);
@@ -33,12 +33,19 @@ void malloc_stats();
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_PEAK) && defined(MCHECK_HEAP_PROTECTION)
+#error "SYS_MALLOC_PEAK cannot be used with MCHECK_HEAP_PROTECTION"
+#endif
+
 #ifdef MCHECK_HEAP_PROTECTION
  #define STATIC_IF_MCHECK static
  #undef MALLOC_COPY
  #undef MALLOC_ZERO
 static inline void MALLOC_ZERO(void *p, size_t sz) { memset(p, 0, sz); }
 static inline void MALLOC_COPY(void *dest, const void *src, size_t sz) { memcpy(dest, src, sz); }
+#elif CONFIG_IS_ENABLED(SYS_MALLOC_PEAK)
+ /* the public functions are wrappers which keep track of heap use */
+ #define STATIC_IF_MCHECK static
 #else
  #define STATIC_IF_MCHECK
  #define mALLOc_impl mALLOc
@@ -1064,6 +1071,8 @@ static mchunkptr mremap_chunk(p, new_size) mchunkptr p; size_t new_size;
 
 #endif /* HAVE_MMAP */
 
+STATIC_IF_MCHECK void fREe_impl(Void_t *mem);
+
 /*
   Extend the top-most chunk by obtaining memory from system.
   Main interface to sbrk (but see also malloc_trim).
@@ -1165,7 +1174,7 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 	SIZE_SZ|PREV_INUSE;
       /* If possible, release the rest. */
       if (old_top_size >= MINSIZE)
-	fREe(chunk2mem(old_top));
+	fREe_impl(chunk2mem(old_top));
     }
   }
 
@@ -2244,6 +2253,75 @@ enum mcheck_status mprobe(void *__ptr) { return mcheck_mprobe(__ptr); }
 // mcheck API }
 #endif
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_PEAK)
+static ulong malloc_in_use;	/* bytes held by allocations */
+static ulong malloc_peak_base;	/* value of malloc_in_use at reset */
+static ulong malloc_peak_max;	/* most bytes held since reset */
+
+/* Bytes held by an allocation, 0 if not from the dlmalloc() pool */
+static ulong malloc_held(Void_t *mem)
+{
+	if ((ulong)mem < mem_malloc_start || (ulong)mem >= mem_malloc_end)
+		return 0;
+
+	return malloc_usable_size(mem);
+}
+
+/* Account for a new allocation which replaces one of @old bytes */
+static Void_t *malloc_account(Void_t *mem, ulong old)
+{
+	malloc_in_use += malloc_held(mem) - old;
+	if (malloc_in_use > malloc_peak_max)
+		malloc_peak_max = malloc_in_use;
+
+	return mem;
+}
+
+Void_t *mALLOc(size_t bytes)
+{
+	return malloc_account(mALLOc_impl(bytes), 0);
+}
+
+void fREe(Void_t *mem)
+{
+	malloc_in_use -= malloc_held(mem);
+	fREe_impl(mem);
+}
+
+Void_t *rEALLOc(Void_t *oldmem, size_t bytes)
+{
+	ulong old = malloc_held(oldmem);
+	Void_t *mem = rEALLOc_impl(oldmem, bytes);
+
+	/* on failure the old allocation is kept */
+	if (!mem && bytes)
+		return NULL;
+
+	return malloc_account(mem, old);
+}
+
+Void_t *mEMALIGn(size_t alignment, size_t bytes)
+{
+	return malloc_account(mEMALIGn_impl(alignment, bytes), 0);
+}
+
+Void_t *cALLOc(size_t n, size_t elem_size)
+{
+	return malloc_account(cALLOc_impl(n, elem_size), 0);
+}
+
+void malloc_peak_reset(void)
+{
+	malloc_peak_base = malloc_in_use;
+	malloc_peak_max = malloc_in_use;
+}
+
+ulong malloc_peak(void)
+{
+	return malloc_peak_max - malloc_peak_base;
+}
+#endif
+
 /*
 
     Malloc_trim gives memory back to the system (via negative
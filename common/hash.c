@@ -11,6 +11,7 @@
 
 #ifndef USE_HOSTCC
 #include <command.h>
+#include <dm.h>
 #include <env.h>
 #include <log.h>
 #include <malloc.h>
@@ -30,6 +31,7 @@
 #include <hash.h>
 #include <image.h>
 #include <u-boot/crc.h>
+#include <u-boot/hash.h>
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
 #include <u-boot/sha512.h>
@@ -168,7 +170,8 @@ static int __maybe_unused hash_finish_crc16_ccitt(struct hash_algo *algo,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint16_t *)dest_buf) = *((uint16_t *)ctx);
+	/* big-endian, as from hash_func_ws() */
+	*((uint16_t *)dest_buf) = cpu_to_be16(*((uint16_t *)ctx));
 	free(ctx);
 	return 0;
 }
@@ -195,11 +198,60 @@ static int __maybe_unused hash_finish_crc32(struct hash_algo *algo, void *ctx,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* big-endian, as from hash_func_ws() */
+	*((uint32_t *)dest_buf) = cpu_to_be32(*((uint32_t *)ctx));
 	free(ctx);
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(SHA_HW_ACCEL)
+/*
+ * Starting the accelerator costs more than hashing a small input on the CPU,
+ * so only use it from CONFIG_HASH_OFFLOAD_MIN bytes
+ */
+static void __maybe_unused hash_sha1_ws(const unsigned char *input,
+					uint ilen, unsigned char *output,
+					uint chunk_sz)
+{
+	if (ilen < CONFIG_HASH_OFFLOAD_MIN)
+		sha1_csum_wd(input, ilen, output, chunk_sz);
+	else
+		hw_sha1(input, ilen, output, chunk_sz);
+}
+
+static void __maybe_unused hash_sha256_ws(const unsigned char *input,
+					  uint ilen, unsigned char *output,
+					  uint chunk_sz)
+{
+	if (ilen < CONFIG_HASH_OFFLOAD_MIN)
+		sha256_csum_wd(input, ilen, output, chunk_sz);
+	else
+		hw_sha256(input, ilen, output, chunk_sz);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(SHA512_HW_ACCEL)
+static void __maybe_unused hash_sha384_ws(const unsigned char *input,
+					  uint ilen, unsigned char *output,
+					  uint chunk_sz)
+{
+	if (ilen < CONFIG_HASH_OFFLOAD_MIN)
+		sha384_csum_wd(input, ilen, output, chunk_sz);
+	else
+		hw_sha384(input, ilen, output, chunk_sz);
+}
+
+static void __maybe_unused hash_sha512_ws(const unsigned char *input,
+					  uint ilen, unsigned char *output,
+					  uint chunk_sz)
+{
+	if (ilen < CONFIG_HASH_OFFLOAD_MIN)
+		sha512_csum_wd(input, ilen, output, chunk_sz);
+	else
+		hw_sha512(input, ilen, output, chunk_sz);
+}
+#endif
+
 /*
  * These are the hash algorithms we support.  If we have hardware acceleration
  * is enable we will use that, otherwise a software version of the algorithm.
@@ -220,7 +272,7 @@ static struct hash_algo hash_algo[] = {
 		.digest_size	= SHA1_SUM_LEN,
 		.chunk_size	= CHUNKSZ_SHA1,
 #if CONFIG_IS_ENABLED(SHA_HW_ACCEL)
-		.hash_func_ws	= hw_sha1,
+		.hash_func_ws	= hash_sha1_ws,
 #else
 		.hash_func_ws	= sha1_csum_wd,
 #endif
@@ -241,7 +293,7 @@ static struct hash_algo hash_algo[] = {
 		.digest_size	= SHA256_SUM_LEN,
 		.chunk_size	= CHUNKSZ_SHA256,
 #if CONFIG_IS_ENABLED(SHA_HW_ACCEL)
-		.hash_func_ws	= hw_sha256,
+		.hash_func_ws	= hash_sha256_ws,
 #else
 		.hash_func_ws	= sha256_csum_wd,
 #endif
@@ -262,7 +314,7 @@ static struct hash_algo hash_algo[] = {
 		.digest_size	= SHA384_SUM_LEN,
 		.chunk_size	= CHUNKSZ_SHA384,
 #if CONFIG_IS_ENABLED(SHA512_HW_ACCEL)
-		.hash_func_ws	= hw_sha384,
+		.hash_func_ws	= hash_sha384_ws,
 #else
 		.hash_func_ws	= sha384_csum_wd,
 #endif
@@ -283,7 +335,7 @@ static struct hash_algo hash_algo[] = {
 		.digest_size	= SHA512_SUM_LEN,
 		.chunk_size	= CHUNKSZ_SHA512,
 #if CONFIG_IS_ENABLED(SHA512_HW_ACCEL)
-		.hash_func_ws	= hw_sha512,
+		.hash_func_ws	= hash_sha512_ws,
 #else
 		.hash_func_ws	= sha512_csum_wd,
 #endif
@@ -373,6 +425,94 @@ int hash_progressive_lookup_algo(const char *algo_name,
 	return -EPROTONOSUPPORT;
 }
 
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(DM_HASH)
+/*
+ * Hash the regions with the first hash driver. This returns an error if the
+ * input is too small to be worth it, or the driver cannot do it, in which
+ * case the caller hashes the regions on the CPU.
+ */
+static int hash_offload(struct hash_algo *algo,
+			const struct image_region *region, int count,
+			uint8_t *output)
+{
+	enum HASH_ALGO id;
+	struct udevice *dev;
+	ulong size = 0;
+	void *ctx;
+	int ret, i;
+
+	for (i = 0; i < count; i++)
+		size += region[i].size;
+	if (size < CONFIG_HASH_OFFLOAD_MIN)
+		return -E2BIG;
+
+	/* Drivers give CRCs in CPU byte order; they are cheap here anyway */
+	id = hash_algo_lookup_by_name(algo->name);
+	if (id == HASH_ALGO_INVALID || id == HASH_ALGO_CRC16_CCITT ||
+	    id == HASH_ALGO_CRC32)
+		return -EPROTONOSUPPORT;
+
+	ret = uclass_first_device_err(UCLASS_HASH, &dev);
+	if (ret)
+		return ret;
+
+	if (count == 1)
+		return hash_digest_wd(dev, id, region->data, region->size,
+				      output, algo->chunk_size);
+
+	ret = hash_init(dev, id, &ctx);
+	if (ret)
+		return ret;
+	for (i = 0; i < count && !ret; i++)
+		ret = hash_update(dev, ctx, region[i].data, region[i].size);
+
+	/* Always finish, so that the driver frees its context */
+	i = hash_finish(dev, ctx, output);
+
+	return ret ? ret : i;
+}
+#else
+static int hash_offload(struct hash_algo *algo,
+			const struct image_region *region, int count,
+			uint8_t *output)
+{
+	return -ENOSYS;
+}
+#endif
+
+int hash_regions(struct hash_algo *algo, const struct image_region *region,
+		 int count, uint8_t *output)
+{
+	void *ctx;
+	int ret, i;
+
+	if (count < 1)
+		return -EINVAL;
+
+	if (!hash_offload(algo, region, count, output))
+		return 0;
+
+	if (count == 1) {
+		algo->hash_func_ws(region->data, region->size, output,
+				   algo->chunk_size);
+		return 0;
+	}
+
+	if (!algo->hash_init)
+		return -EPROTONOSUPPORT;
+	ret = algo->hash_init(algo, &ctx);
+	if (ret)
+		return ret;
+	for (i = 0; i < count && !ret; i++)
+		ret = algo->hash_update(algo, ctx, region[i].data,
+					region[i].size, i == count - 1);
+
+	/* Always finish, since that frees the context */
+	i = algo->hash_finish(algo, ctx, output, algo->digest_size);
+
+	return ret ? ret : i;
+}
+
 #ifndef USE_HOSTCC
 int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 {
@@ -397,6 +537,7 @@ int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 int hash_block(const char *algo_name, const void *data, unsigned int len,
 	       uint8_t *output, int *output_size)
 {
+	struct image_region region = { data, len };
 	struct hash_algo *algo;
 	int ret;
 
@@ -411,9 +552,8 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
 	}
 	if (output_size)
 		*output_size = algo->digest_size;
-	algo->hash_func_ws(data, len, output, algo->chunk_size);
 
-	return 0;
+	return hash_regions(algo, &region, 1, output);
 }
 
 #if !defined(CONFIG_XPL_BUILD) && (defined(CONFIG_CMD_HASH) || \
@@ -555,6 +695,7 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 		struct hash_algo *algo;
 		u8 *output;
 		uint8_t vsum[HASH_MAX_DIGEST_SIZE];
+		struct image_region region;
 		void *buf;
 
 		if (hash_lookup_algo(algo_name, &algo)) {
@@ -574,7 +715,9 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 			return CMD_RET_FAILURE;
 
 		buf = map_sysmem(addr, len);
-		algo->hash_func_ws(buf, len, output, algo->chunk_size);
+		region.data = buf;
+		region.size = len;
+		hash_regions(algo, &region, 1, output);
 		unmap_sysmem(buf);
 
 		/* Try to avoid code bloat when verify is not needed */
@@ -284,6 +284,7 @@ void part_init(struct blk_desc *desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_changed(desc);
 
 	if (desc->part_type != PART_TYPE_UNKNOWN) {
 		for (entry = drv; entry != drv + n_ents; entry++) {
@@ -7,13 +7,17 @@
 #define LOG_CATEGORY UCLASS_BLK
 
 #include <blk.h>
+#include <bootstage.h>
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <time.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
+#include <linux/bitops.h>
 #include <linux/err.h>
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -321,14 +325,28 @@ int blk_show_device(enum uclass_id uclass_id, int devnum)
 
 int blk_select_hwpart(struct udevice *dev, int hwpart)
 {
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops)
 		return -ENOSYS;
 	if (!ops->select_hwpart)
 		return 0;
 
-	return ops->select_hwpart(dev, hwpart);
+	if (desc->hwpart == hwpart)
+		return ops->select_hwpart(dev, hwpart);
+
+	/* dirty blocks belong to the current hardware partition */
+	ret = blk_flush(dev);
+	if (ret)
+		return ret;
+
+	ret = ops->select_hwpart(dev, hwpart);
+	if (!ret)
+		blk_changed(desc);
+
+	return ret;
 }
 
 int blk_dselect_hwpart(struct blk_desc *desc, int hwpart)
@@ -429,19 +447,106 @@ static int blk_buffer_aligned(struct bounce_buffer *state)
 	return 1;	/* Default, any buffer is OK */
 }
 
+/* Histogram bucket for @val, see struct blk_op_stats */
+static inline int blk_stats_bucket(ulong val)
+{
+	return min(fls(val), BLK_STATS_BUCKETS - 1);
+}
+
+/* Add a transfer of @blkcnt blocks which returned @ret to the statistics */
+static void blk_stats_add(struct blk_desc *desc, enum blk_stats_op op,
+			  lbaint_t blkcnt, long ret, ulong start_us)
+{
+#if IS_ENABLED(CONFIG_BLK_STATS)
+	struct blk_op_stats *st = &desc->stats.op[op];
+	ulong us = timer_get_us() - start_us;
+
+	st->reqs++;
+	if (ret != (long)blkcnt)
+		st->errors++;
+	if (ret > 0)
+		st->blocks += ret;
+	st->time_us += us;
+	st->max_us = max_t(ulong, st->max_us, us);
+	st->lat_hist[blk_stats_bucket(us)]++;
+	st->size_hist[blk_stats_bucket(blkcnt)]++;
+#endif
+}
+
+/* Start timing a transfer by the driver, returning the start time */
+static ulong blk_io_start(void)
+{
+	bootstage_start(BOOTSTAGE_ID_ACCUM_BLK, "blk");
+
+	return IS_ENABLED(CONFIG_BLK_STATS) ? timer_get_us() : 0;
+}
+
+/* Finish timing a transfer started with blk_io_start() */
+static void blk_io_end(struct blk_desc *desc, enum blk_stats_op op,
+		       lbaint_t blkcnt, long ret, ulong start_us)
+{
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_BLK);
+	blk_stats_add(desc, op, blkcnt, ret, start_us);
+}
+
+void blk_stats_reset(struct blk_desc *desc)
+{
+#if IS_ENABLED(CONFIG_BLK_STATS)
+	memset(&desc->stats, '\0', sizeof(desc->stats));
+#endif
+}
+
+/*
+ * If the block cache sees a sequential stream, read the blocks following
+ * @start + @blkcnt now so that the next read can be served from the cache
+ */
+static void blk_readahead(struct udevice *dev, struct blk_desc *desc,
+			  lbaint_t start, lbaint_t blkcnt)
+{
+	lbaint_t count;
+	void *buf;
+
+	count = blkcache_readahead(desc->uclass_id, desc->devnum, start,
+				   blkcnt, desc->blksz);
+	start += blkcnt;
+	if (!count || start >= desc->lba)
+		return;
+	count = min(count, desc->lba - start);
+
+	buf = malloc_cache_aligned(count * desc->blksz);
+	if (!buf)
+		return;
+	if (blk_read(dev, start, count, buf) != count)
+		log_debug("read-ahead of " LBAFU " blocks failed\n", count);
+	free(buf);
+}
+
 long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
+	ulong blks_read, start_us;
 
 	if (!ops->read)
 		return -ENOSYS;
 
 	if (blkcache_read(desc->uclass_id, desc->devnum,
-			  start, blkcnt, desc->blksz, buf))
+			  start, blkcnt, desc->blksz, buf)) {
+#if IS_ENABLED(CONFIG_BLK_STATS)
+		desc->stats.cache_hits++;
+#endif
 		return blkcnt;
+	}
 
+	/* the device does not have the latest data for dirty blocks */
+	if (blkcache_dirty(desc->uclass_id, desc->devnum, start, blkcnt)) {
+		int ret = blk_flush(dev);
+
+		if (ret)
+			return ret;
+	}
+
+	start_us = blk_io_start();
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
 		int ret;
@@ -450,8 +555,10 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 						   blkcnt * desc->blksz,
 						   GEN_BB_WRITE, desc->blksz,
 						   blk_buffer_aligned);
-		if (ret)
+		if (ret) {
+			blk_io_end(desc, BLK_STATS_READ, blkcnt, ret, start_us);
 			return ret;
+		}
 
 		blks_read = ops->read(dev, start, blkcnt, bbstate.state.bounce_buffer);
 
@@ -459,26 +566,27 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 	} else {
 		blks_read = ops->read(dev, start, blkcnt, buf);
 	}
+	blk_io_end(desc, BLK_STATS_READ, blkcnt, blks_read, start_us);
 
-	if (blks_read == blkcnt)
+	if (blks_read == blkcnt) {
 		blkcache_fill(desc->uclass_id, desc->devnum, start, blkcnt,
 			      desc->blksz, buf);
+		blk_readahead(dev, desc, start, blkcnt);
+	}
 
 	return blks_read;
 }
 
-long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
-	       const void *buf)
+/* Write to the device, bypassing the block cache */
+static long blk_write_dev(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+			  const void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
 	long blks_written;
+	ulong start_us;
 
-	if (!ops->write)
-		return -ENOSYS;
-
-	blkcache_invalidate(desc->uclass_id, desc->devnum);
-
+	start_us = blk_io_start();
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
 		int ret;
@@ -487,8 +595,11 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 						   blkcnt * desc->blksz,
 						   GEN_BB_READ, desc->blksz,
 						   blk_buffer_aligned);
-		if (ret)
+		if (ret) {
+			blk_io_end(desc, BLK_STATS_WRITE, blkcnt, ret,
+				   start_us);
 			return ret;
+		}
 
 		blks_written = ops->write(dev, start, blkcnt,
 					  bbstate.state.bounce_buffer);
@@ -497,21 +608,218 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 	} else {
 		blks_written = ops->write(dev, start, blkcnt, buf);
 	}
+	blk_io_end(desc, BLK_STATS_WRITE, blkcnt, blks_written, start_us);
 
 	return blks_written;
 }
 
+static int blk_flush_write(void *priv, lbaint_t start, lbaint_t blkcnt,
+			   const void *buf)
+{
+	long ret;
+
+	ret = blk_write_dev(priv, start, blkcnt, buf);
+	if (ret < 0)
+		return ret;
+
+	return ret == blkcnt ? 0 : -EIO;
+}
+
+int blk_flush(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	int ret;
+
+	ret = blkcache_flush(desc->uclass_id, desc->devnum, blk_flush_write,
+			     dev);
+	if (ret)
+		log_err("Failed to flush %s (err=%d)\n", dev->name, ret);
+
+	return ret;
+}
+
+int blk_flush_all(void)
+{
+	struct udevice *dev;
+	int ret, err = 0;
+
+	blk_foreach(BLKF_BOTH, dev) {
+		ret = blk_flush(dev);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
+long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	       const void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	if (!ops->write)
+		return -ENOSYS;
+
+	blk_changed(desc);
+	ret = blkcache_write(desc->uclass_id, desc->devnum, start, blkcnt,
+			     desc->blksz, buf);
+	if (ret == -ENOSPC) {
+		ret = blk_flush(dev);
+		if (ret)
+			return ret;
+		ret = blkcache_write(desc->uclass_id, desc->devnum, start,
+				     blkcnt, desc->blksz, buf);
+	}
+	if (ret > 0)
+		return blkcnt;
+
+	return blk_write_dev(dev, start, blkcnt, buf);
+}
+
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong start_us;
+	long ret;
 
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_changed(desc);
+	blkcache_discard(desc->uclass_id, desc->devnum, start, blkcnt);
+
+	start_us = blk_io_start();
+	ret = ops->erase(dev, start, blkcnt);
+	blk_io_end(desc, BLK_STATS_ERASE, blkcnt, ret, start_us);
+
+	return ret;
+}
+
+/* Carry out a request synchronously */
+static int blk_submit_sync(struct udevice *dev, struct blk_req *req)
+{
+	if (req->write)
+		req->ret = blk_write(dev, req->start, req->blkcnt, req->buffer);
+	else
+		req->ret = blk_read(dev, req->start, req->blkcnt, req->buffer);
+	req->done = true;
+
+	return 0;
+}
+
+/* Check whether the driver can carry out requests in the background */
+static bool blk_can_submit(struct udevice *dev)
+{
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	/* bounce buffers are only set up for synchronous transfers */
+	return ops->submit && ops->poll &&
+		!(IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb);
+#else
+	return false;
+#endif
+}
+
+int blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	req->done = false;
+	req->async = false;
+	req->ret = 0;
+
+	if (!blk_can_submit(dev))
+		return blk_submit_sync(dev, req);
+
+	if (req->write) {
+		if (!ops->write)
+			return -ENOSYS;
+		/* the new data goes straight to the device */
+		blk_changed(desc);
+		blkcache_discard(desc->uclass_id, desc->devnum, req->start,
+				 req->blkcnt);
+	} else {
+		if (!ops->read)
+			return -ENOSYS;
+		if (blkcache_read(desc->uclass_id, desc->devnum, req->start,
+				  req->blkcnt, desc->blksz, req->buffer)) {
+#if IS_ENABLED(CONFIG_BLK_STATS)
+			desc->stats.cache_hits++;
+#endif
+			req->ret = req->blkcnt;
+			req->done = true;
+			return 0;
+		}
+		if (blkcache_dirty(desc->uclass_id, desc->devnum, req->start,
+				   req->blkcnt)) {
+			ret = blk_flush(dev);
+			if (ret)
+				return ret;
+		}
+	}
+
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	/*
+	 * Transfers overlap, so they are counted in the device statistics
+	 * but not in the bootstage time
+	 */
+	req->async = true;
+	req->start_us = IS_ENABLED(CONFIG_BLK_STATS) ? timer_get_us() : 0;
+
+	return ops->submit(dev, req);
+#else
+	return -ENOSYS;
+#endif
+}
+
+int blk_poll(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	if (!req->done) {
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+		const struct blk_ops *ops = blk_get_ops(dev);
+		int ret;
+
+		ret = ops->poll(dev);
+		if (ret)
+			return ret;
+#endif
+		if (!req->done)
+			return -EINPROGRESS;
+	}
+
+	if (req->async) {
+		req->async = false;
+		blk_stats_add(desc, req->write ? BLK_STATS_WRITE :
+			      BLK_STATS_READ, req->blkcnt, req->ret,
+			      req->start_us);
+		if (!req->write && req->ret == req->blkcnt)
+			blkcache_fill(desc->uclass_id, desc->devnum, req->start,
+				      req->blkcnt, desc->blksz, req->buffer);
+	}
+
+	return 0;
+}
+
+long blk_wait(struct udevice *dev, struct blk_req *req)
+{
+	int ret;
+
+	do {
+		ret = blk_poll(dev, req);
+	} while (ret == -EINPROGRESS);
+	if (ret)
+		return ret;
 
-	return ops->erase(dev, start, blkcnt);
+	return req->ret;
 }
 
 ulong blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
@@ -531,6 +839,19 @@ ulong blk_derase(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
 	return blk_erase(desc->bdev, start, blkcnt);
 }
 
+int blk_dflush(struct blk_desc *desc)
+{
+	return blk_flush(desc->bdev);
+}
+
+/* Last generation number given to a device by blk_changed() */
+static u32 blk_gen;
+
+void blk_changed(struct blk_desc *desc)
+{
+	desc->gen = ++blk_gen;
+}
+
 int blk_find_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -852,9 +1173,11 @@ static int part_create_block_devices(struct udevice *blk_dev)
 
 static int blk_post_probe(struct udevice *dev)
 {
-	if (CONFIG_IS_ENABLED(PARTITIONS) && blk_enabled()) {
-		struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
 
+	blk_changed(desc);
+
+	if (CONFIG_IS_ENABLED(PARTITIONS) && blk_enabled()) {
 		part_init(desc);
 
 		if (desc->part_type != PART_TYPE_UNKNOWN &&
@@ -865,9 +1188,21 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	/* blk_flush() reports any failure; it should not stop the removal */
+	blk_flush(dev);
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
@@ -7,65 +7,390 @@
 #include <blk.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <sort.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 
+/*
+ * The cache holds individual blocks, looked up through a hash table keyed by
+ * (iftype, devnum, lba). Each device has its own shard with an LRU list, so
+ * that invalidating one device does not touch the others and a large scan
+ * of one device evicts its own blocks before those of other devices.
+ *
+ * In write-back mode, small writes are held as dirty blocks on a separate
+ * per-device list, where eviction cannot reach them. They are written out by
+ * blkcache_flush(), which merges adjacent blocks into a single device write.
+ */
+
+/* Consecutive sequential reads needed before read-ahead kicks in */
+#define BLKCACHE_SEQ_THRESHOLD	1
+
+/* Largest run of dirty blocks written back in one go */
+#define BLKCACHE_FLUSH_MAX_BLOCKS	128
+
+/* Limits on the number of hash buckets */
+#define BLKCACHE_MIN_HASH_BITS	6
+#define BLKCACHE_MAX_HASH_BITS	16
+
+struct block_cache_dev;
+
+/**
+ * struct block_cache_node - a single cached block
+ *
+ * @hash: Link in the hash bucket
+ * @lru: Link in the device's LRU list, most-recently used first
+ * @bdev: Device shard this block belongs to
+ * @lba: Block number on the device
+ * @readahead: true if the block was read ahead and has not been used yet
+ * @dirty: true if the block has been written but not yet written back, in
+ *	which case @lru links it into the device's dirty list instead
+ * @data: Block contents (bdev->blksz bytes)
+ */
 struct block_cache_node {
-	struct list_head lh;
+	struct hlist_node hash;
+	struct list_head lru;
+	struct block_cache_dev *bdev;
+	lbaint_t lba;
+	bool readahead;
+	bool dirty;
+	char data[];
+};
+
+/**
+ * struct block_cache_dev - per-device shard of the cache
+ *
+ * @sibling: Link in the list of devices
+ * @lru: Clean blocks of this device, most-recently used first
+ * @dirty: Dirty blocks of this device, in no particular order
+ * @iftype: uclass_id of the device
+ * @devnum: Device number within @iftype
+ * @blksz: Block size in bytes
+ * @bytes: Number of bytes cached for this device
+ * @next_lba: Block following the last read, for sequential detection
+ * @seq: Number of consecutive sequential reads seen
+ * @ra_pending: true if a read-ahead of @ra_start is in progress
+ * @ra_start: First block of the pending read-ahead
+ * @ndirty: Number of blocks on @dirty
+ * @dirty_min: Lowest dirty block number, valid if @ndirty is not 0
+ * @dirty_max: Highest dirty block number, valid if @ndirty is not 0
+ */
+struct block_cache_dev {
+	struct list_head sibling;
+	struct list_head lru;
+	struct list_head dirty;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
-	char *cache;
+	unsigned long bytes;
+	lbaint_t next_lba;
+	unsigned int seq;
+	bool ra_pending;
+	lbaint_t ra_start;
+	lbaint_t ndirty;
+	lbaint_t dirty_min;
+	lbaint_t dirty_max;
 };
 
-static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_devs);
+static struct hlist_head *block_cache_hash;
+static unsigned int block_cache_hash_bits;
+static ulong block_cache_dirty_bytes;
+static bool block_cache_hold;
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.size_mb = CONFIG_BLOCK_CACHE_SIZE,
+	.readahead = CONFIG_BLOCK_CACHE_READAHEAD,
+	.writeback = IS_ENABLED(CONFIG_BLOCK_CACHE_WRITEBACK),
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static ulong cache_capacity(void)
+{
+	return (ulong)_stats.size_mb << 20;
+}
+
+static struct hlist_head *cache_bucket(int iftype, int devnum, lbaint_t lba)
+{
+	u64 key = (u64)lba ^ ((u64)iftype << 56) ^ ((u64)devnum << 48);
+
+	key *= 0x9e3779b97f4a7c15ULL;
+
+	return &block_cache_hash[key >> (64 - block_cache_hash_bits)];
+}
+
+static int cache_alloc_hash(void)
+{
+	ulong buckets;
+	uint bits;
+
+	if (block_cache_hash)
+		return 0;
+
+	/* aim for about two 512-byte blocks per bucket when full */
+	buckets = cache_capacity() / (2 * 512);
+	bits = buckets ? ilog2(buckets) : 0;
+	bits = clamp(bits, (uint)BLKCACHE_MIN_HASH_BITS,
+		     (uint)BLKCACHE_MAX_HASH_BITS);
+
+	block_cache_hash = calloc(1 << bits, sizeof(struct hlist_head));
+	if (!block_cache_hash)
+		return -ENOMEM;
+	block_cache_hash_bits = bits;
+
+	return 0;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *bdev,
+					   lbaint_t lba)
 {
 	struct block_cache_node *node;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
+	hlist_for_each_entry(node, cache_bucket(bdev->iftype, bdev->devnum, lba),
+			     hash)
+		if (node->bdev == bdev && node->lba == lba)
 			return node;
+
+	return NULL;
+}
+
+static void cache_unlink(struct block_cache_node *node)
+{
+	struct block_cache_dev *bdev = node->bdev;
+
+	hlist_del(&node->hash);
+	list_del(&node->lru);
+	if (node->dirty) {
+		bdev->ndirty--;
+		block_cache_dirty_bytes -= bdev->blksz;
+		_stats.dirty--;
+	}
+	bdev->bytes -= bdev->blksz;
+	_stats.bytes -= bdev->blksz;
+	_stats.entries--;
+}
+
+static void cache_drop_list(struct list_head *head)
+{
+	struct block_cache_node *node, *n;
+
+	list_for_each_entry_safe(node, n, head, lru) {
+		cache_unlink(node);
+		free(node);
+	}
+}
+
+static void cache_drop_dev(struct block_cache_dev *bdev)
+{
+	if (bdev->ndirty)
+		log_warning("blkcache: dropping " LBAFU " unwritten blocks\n",
+			    bdev->ndirty);
+	cache_drop_list(&bdev->dirty);
+	cache_drop_list(&bdev->lru);
+}
+
+/* Drop the blocks of @bdev in @head which are within the given range */
+static void cache_drop_range(struct list_head *head, lbaint_t start,
+			     lbaint_t blkcnt)
+{
+	struct block_cache_node *node, *n;
+
+	list_for_each_entry_safe(node, n, head, lru) {
+		if (node->lba >= start && node->lba < start + blkcnt) {
+			cache_unlink(node);
+			free(node);
 		}
-	return 0;
+	}
+}
+
+/*
+ * Find the shard for a device, creating it if @create is true. If @blksz is
+ * not 0 and differs from the cached block size, the shard is emptied.
+ */
+static struct block_cache_dev *cache_get_dev(int iftype, int devnum,
+					     unsigned long blksz, bool create)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, sibling) {
+		if (bdev->iftype == iftype && bdev->devnum == devnum) {
+			if (blksz && bdev->blksz != blksz) {
+				/* the device was reinitialised */
+				cache_drop_dev(bdev);
+				bdev->blksz = blksz;
+			}
+			return bdev;
+		}
+	}
+	if (!create)
+		return NULL;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	INIT_LIST_HEAD(&bdev->lru);
+	INIT_LIST_HEAD(&bdev->dirty);
+	bdev->iftype = iftype;
+	bdev->devnum = devnum;
+	bdev->blksz = blksz;
+	list_add(&bdev->sibling, &block_cache_devs);
+
+	return bdev;
+}
+
+static ulong cache_clean_bytes(struct block_cache_dev *bdev)
+{
+	return bdev->bytes - bdev->ndirty * bdev->blksz;
+}
+
+/*
+ * Pick the device holding the most clean data, so a busy device evicts
+ * itself. Dirty blocks are never evicted.
+ */
+static struct block_cache_dev *cache_victim(void)
+{
+	struct block_cache_dev *bdev, *victim = NULL;
+
+	list_for_each_entry(bdev, &block_cache_devs, sibling) {
+		if (list_empty(&bdev->lru))
+			continue;
+		if (!victim || cache_clean_bytes(bdev) > cache_clean_bytes(victim))
+			victim = bdev;
+	}
+
+	return victim;
+}
+
+/* Get a node for a new block of @bdev, evicting LRU blocks as needed */
+static struct block_cache_node *cache_alloc(struct block_cache_dev *bdev)
+{
+	struct block_cache_node *node = NULL;
+
+	while (_stats.bytes + bdev->blksz > cache_capacity()) {
+		struct block_cache_dev *victim = cache_victim();
+
+		if (!victim)
+			break;
+		free(node);
+		node = list_last_entry(&victim->lru, struct block_cache_node,
+				       lru);
+		debug("drop: start " LBAF "\n", node->lba);
+		cache_unlink(node);
+
+		/* keep the memory if it is the right size */
+		if (victim->blksz != bdev->blksz) {
+			free(node);
+			node = NULL;
+		}
+	}
+	if (!node)
+		node = malloc(sizeof(*node) + bdev->blksz);
+
+	return node;
+}
+
+/* Add a new block of @bdev to the cache, evicting others as needed */
+static struct block_cache_node *cache_insert(struct block_cache_dev *bdev,
+					     lbaint_t lba)
+{
+	struct block_cache_node *node;
+
+	node = cache_alloc(bdev);
+	if (!node)
+		return NULL;
+	node->bdev = bdev;
+	node->lba = lba;
+	node->readahead = false;
+	node->dirty = false;
+	hlist_add_head(&node->hash,
+		       cache_bucket(bdev->iftype, bdev->devnum, lba));
+	list_add(&node->lru, &bdev->lru);
+	bdev->bytes += bdev->blksz;
+	_stats.bytes += bdev->blksz;
+	_stats.entries++;
+
+	return node;
+}
+
+static void cache_mark_dirty(struct block_cache_node *node)
+{
+	struct block_cache_dev *bdev = node->bdev;
+
+	node->readahead = false;
+	if (node->dirty)
+		return;
+
+	node->dirty = true;
+	list_move(&node->lru, &bdev->dirty);
+	if (!bdev->ndirty++) {
+		bdev->dirty_min = node->lba;
+		bdev->dirty_max = node->lba;
+	} else {
+		bdev->dirty_min = min(bdev->dirty_min, node->lba);
+		bdev->dirty_max = max(bdev->dirty_max, node->lba);
+	}
+	block_cache_dirty_bytes += bdev->blksz;
+	_stats.dirty++;
+}
+
+/* Update sequential-access detection for a read of @bdev */
+static void cache_track(struct block_cache_dev *bdev, lbaint_t start,
+			lbaint_t blkcnt)
+{
+	if (start == bdev->next_lba)
+		bdev->seq++;
+	else
+		bdev->seq = 0;
+	bdev->next_lba = start + blkcnt;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	lbaint_t i;
+
+	if (!_stats.size_mb)
+		return 0;
+
+	bdev = cache_get_dev(iftype, devnum, blksz, true);
+	if (!bdev)
+		return 0;
+
+	/* read-ahead goes to the device and is not part of the stream */
+	if (bdev->ra_pending && start == bdev->ra_start)
+		return 0;
+	cache_track(bdev, start, blkcnt);
+
+	if (!block_cache_hash || blkcnt > _stats.max_blocks_per_entry)
+		goto miss;
+
+	for (i = 0; i < blkcnt; i++) {
+		node = cache_find(bdev, start + i);
+		if (!node)
+			goto miss;
+		memcpy(buffer + i * blksz, node->data, blksz);
+		if (!node->dirty)
+			list_move(&node->lru, &bdev->lru);
+		if (node->readahead) {
+			node->readahead = false;
+			_stats.ra_hits++;
+		}
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	++_stats.hits;
+	_stats.bytes_served += blkcnt * blksz;
+
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
@@ -76,92 +401,303 @@ void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
 	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	bool readahead;
+	lbaint_t i;
+
+	if (!_stats.size_mb || blksz > cache_capacity())
+		return;
+
+	bdev = cache_get_dev(iftype, devnum, blksz, true);
+	if (!bdev)
+		return;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	readahead = bdev->ra_pending && start == bdev->ra_start;
+	if (readahead) {
+		bdev->ra_pending = false;
+		_stats.ra_blocks += blkcnt;
+	} else if (blkcnt > _stats.max_blocks_per_entry) {
+		/* don't cache big stuff */
 		return;
+	}
 
-	if (_stats.max_entries == 0)
+	if (cache_alloc_hash())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
+	debug("fill: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+
+	for (i = 0; i < blkcnt; i++, buffer += blksz) {
+		node = cache_find(bdev, start + i);
+		if (node) {
+			/* the cached copy is newer than the device */
+			if (node->dirty)
+				continue;
+			memcpy(node->data, buffer, blksz);
+			list_move(&node->lru, &bdev->lru);
+			continue;
 		}
-	} else {
-		node = malloc(sizeof(*node));
+
+		node = cache_insert(bdev, start + i);
 		if (!node)
 			return;
-		node->cache = 0;
+		node->readahead = readahead;
+		memcpy(node->data, buffer, blksz);
 	}
+}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
+int blkcache_write(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer)
+{
+	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	lbaint_t i;
+
+	if (!_stats.size_mb || !_stats.writeback || !block_cache_hold ||
+	    blkcnt > _stats.max_blocks_per_entry)
+		goto write_through;
+
+	bdev = cache_get_dev(iftype, devnum, blksz, true);
+	if (!bdev || cache_alloc_hash())
+		goto write_through;
+
+	/* keep at least half of the cache for clean blocks */
+	if (block_cache_dirty_bytes + blkcnt * blksz > cache_capacity() / 2) {
+		if (block_cache_dirty_bytes)
+			return -ENOSPC;
+		goto write_through;
 	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
+	debug("write: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	for (i = 0; i < blkcnt; i++, buffer += blksz) {
+		node = cache_find(bdev, start + i);
+		if (!node) {
+			node = cache_insert(bdev, start + i);
+			if (!node)
+				goto write_through;
+		}
+		memcpy(node->data, buffer, blksz);
+		cache_mark_dirty(node);
+	}
+	_stats.wb_writes++;
+
+	return 1;
+
+write_through:
+	/* the caller writes to the device, so cached copies are stale */
+	blkcache_discard(iftype, devnum, start, blkcnt);
+
+	return 0;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_discard(int iftype, int devnum, lbaint_t start, lbaint_t blkcnt)
 {
-	struct list_head *entry, *n;
 	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	lbaint_t i;
+
+	if (!block_cache_hash)
+		return;
+	bdev = cache_get_dev(iftype, devnum, 0, false);
+	if (!bdev || !bdev->bytes)
+		return;
+
+	/* use whichever is fewer: lookups or a walk of the device's blocks */
+	if (blkcnt <= bdev->bytes / bdev->blksz) {
+		for (i = 0; i < blkcnt; i++) {
+			node = cache_find(bdev, start + i);
+			if (node) {
+				cache_unlink(node);
+				free(node);
+			}
+		}
+	} else {
+		cache_drop_range(&bdev->dirty, start, blkcnt);
+		cache_drop_range(&bdev->lru, start, blkcnt);
+	}
+}
+
+bool blkcache_dirty(int iftype, int devnum, lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_dev *bdev;
+
+	bdev = cache_get_dev(iftype, devnum, 0, false);
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+	return bdev && bdev->ndirty && start <= bdev->dirty_max &&
+		start + blkcnt > bdev->dirty_min;
+}
+
+static int cache_lba_cmp(const void *a, const void *b)
+{
+	const struct block_cache_node *na = *(struct block_cache_node **)a;
+	const struct block_cache_node *nb = *(struct block_cache_node **)b;
+
+	if (na->lba == nb->lba)
+		return 0;
+
+	return na->lba < nb->lba ? -1 : 1;
+}
+
+int blkcache_flush(int iftype, int devnum, blkcache_write_t write, void *priv)
+{
+	struct block_cache_node **nodes, *node;
+	struct block_cache_dev *bdev;
+	lbaint_t i, j, k, n;
+	char *buf;
+	int ret = 0;
+
+	bdev = cache_get_dev(iftype, devnum, 0, false);
+	if (!bdev || !bdev->ndirty)
+		return 0;
+
+	n = bdev->ndirty;
+	nodes = malloc(n * sizeof(*nodes));
+	buf = malloc_cache_aligned(min(n, (lbaint_t)BLKCACHE_FLUSH_MAX_BLOCKS) *
+				   bdev->blksz);
+	if (!nodes || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	i = 0;
+	list_for_each_entry(node, &bdev->dirty, lru)
+		nodes[i++] = node;
+	qsort(nodes, n, sizeof(*nodes), cache_lba_cmp);
+
+	for (i = 0; i < n; i = j) {
+		/* gather a run of adjacent blocks */
+		for (j = i + 1; j < n && j - i < BLKCACHE_FLUSH_MAX_BLOCKS &&
+		     nodes[j]->lba == nodes[j - 1]->lba + 1; j++)
+			;
+		for (k = i; k < j; k++)
+			memcpy(buf + (k - i) * bdev->blksz, nodes[k]->data,
+			       bdev->blksz);
+
+		debug("flush: start " LBAF ", count " LBAFU "\n",
+		      nodes[i]->lba, j - i);
+		ret = write(priv, nodes[i]->lba, j - i, buf);
+		if (ret)
+			goto out;
+		_stats.flush_writes++;
+		_stats.flush_blocks += j - i;
+
+		for (k = i; k < j; k++) {
+			node = nodes[k];
+			node->dirty = false;
+			list_move(&node->lru, &bdev->lru);
+			bdev->ndirty--;
+			block_cache_dirty_bytes -= bdev->blksz;
+			_stats.dirty--;
+		}
+	}
+
+out:
+	free(buf);
+	free(nodes);
+
+	return ret;
+}
+
+lbaint_t blkcache_readahead(int iftype, int devnum,
+			    lbaint_t start, lbaint_t blkcnt,
+			    unsigned long blksz)
+{
+	struct block_cache_dev *bdev;
+
+	/*
+	 * The next read of a stream of big reads is big too, so it would not
+	 * be served from the cache
+	 */
+	if (!_stats.size_mb || !_stats.readahead ||
+	    blkcnt > _stats.max_blocks_per_entry)
+		return 0;
+
+	bdev = cache_get_dev(iftype, devnum, blksz, false);
+	if (!bdev)
+		return 0;
+
+	/* only extend the stream being tracked, not read-ahead itself */
+	if (bdev->ra_pending && start == bdev->ra_start)
+		return 0;
+	if (bdev->seq < BLKCACHE_SEQ_THRESHOLD ||
+	    start + blkcnt != bdev->next_lba)
+		return 0;
+
+	/* nothing to do if the next block is already here */
+	if (block_cache_hash && cache_find(bdev, bdev->next_lba))
+		return 0;
+
+	bdev->ra_pending = true;
+	bdev->ra_start = bdev->next_lba;
+	debug("readahead: start " LBAF ", count %u\n", bdev->ra_start,
+	      _stats.readahead);
+
+	return _stats.readahead;
+}
+
+void blkcache_invalidate(int iftype, int devnum)
+{
+	struct block_cache_dev *bdev, *n;
+
+	list_for_each_entry_safe(bdev, n, &block_cache_devs, sibling) {
 		if (iftype == -1 ||
-		    (node->iftype == iftype && node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+		    (bdev->iftype == iftype && bdev->devnum == devnum)) {
+			cache_drop_dev(bdev);
+			list_del(&bdev->sibling);
+			free(bdev);
 		}
 	}
+
+	if (!_stats.entries) {
+		free(block_cache_hash);
+		block_cache_hash = NULL;
+	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+static void blkcache_reset_stats(void)
+{
+	_stats.hits = 0;
+	_stats.misses = 0;
+	_stats.bytes_served = 0;
+	_stats.ra_blocks = 0;
+	_stats.ra_hits = 0;
+	_stats.wb_writes = 0;
+	_stats.flush_writes = 0;
+	_stats.flush_blocks = 0;
+}
+
+void blkcache_set_writeback(bool enable)
+{
+	_stats.writeback = enable;
+}
+
+void blkcache_hold_writes(bool hold)
+{
+	block_cache_hold = hold;
+}
+
+void blkcache_configure(unsigned blocks, unsigned size_mb, unsigned readahead)
 {
 	/* invalidate cache if there is a change */
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries))
-		blkcache_invalidate(-1, 0);
+	    (size_mb != _stats.size_mb))
+		blkcache_free();
 
 	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	_stats.size_mb = size_mb;
+	_stats.readahead = readahead;
 
-	_stats.hits = 0;
-	_stats.misses = 0;
+	blkcache_reset_stats();
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
-	_stats.hits = 0;
-	_stats.misses = 0;
+	blkcache_reset_stats();
 }
 
 void blkcache_free(void)
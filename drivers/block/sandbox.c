@@ -17,6 +17,17 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/**
+ * struct host_blk_priv - Information about a host block device
+ *
+ * @queue: Requests submitted and not yet carried out
+ * @count: Number of requests in @queue
+ */
+struct host_blk_priv {
+	struct blk_req *queue[4];
+	int count;
+};
+
 static unsigned long host_block_read(struct udevice *dev,
 				     unsigned long start, lbaint_t blkcnt,
 				     void *buffer)
@@ -55,13 +66,56 @@ static unsigned long host_block_write(struct udevice *dev,
 	return -EIO;
 }
 
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+/*
+ * Submitted requests are only carried out when polled, so that tests see
+ * the same ordering as with a real device working in the background
+ */
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+
+	if (priv->count == ARRAY_SIZE(priv->queue))
+		return -EBUSY;
+	priv->queue[priv->count++] = req;
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+	struct blk_req *req;
+	int i;
+
+	for (i = 0; i < priv->count; i++) {
+		req = priv->queue[i];
+		if (req->write)
+			req->ret = host_block_write(dev, req->start,
+						    req->blkcnt, req->buffer);
+		else
+			req->ret = host_block_read(dev, req->start,
+						   req->blkcnt, req->buffer);
+		req->done = true;
+	}
+	priv->count = 0;
+
+	return 0;
+}
+#endif
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
+#endif
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.priv_auto	= sizeof(struct host_blk_priv),
 };
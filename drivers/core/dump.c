@@ -355,4 +355,13 @@ void dm_dump_mem(struct dm_stats *stats)
 	/* Drop the device name */
 	printf("Drop device name (not SRAM): %x (%d)\n", stats->dev_name_size,
 	       stats->dev_name_size);
+
+	if (CONFIG_IS_ENABLED(OFNODE_CACHE)) {
+		struct ofnode_cache_stats ocs;
+
+		ofnode_get_cache_stats(&ocs);
+		printf("\nofnode cache: phandle %x hit / %x miss, path %x hit / %x miss, %x flush\n",
+		       ocs.phandle_hits, ocs.phandle_misses, ocs.path_hits,
+		       ocs.path_misses, ocs.flushes);
+	}
 }
@@ -11,6 +11,8 @@
 #include <debug_uart.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
+#include <asm/global_data.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -19,6 +21,9 @@
 #include <dm/util.h>
 #include <fdtdec.h>
 #include <linux/compiler.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -196,6 +201,136 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
+/**
+ * struct dm_compat_ent - a compatible string in the index
+ *
+ * @compat: Compatible string, or NULL if this slot is empty
+ * @drv: First driver in the linker list which matches @compat
+ * @id: Entry in @drv's of_match list which matches @compat
+ */
+struct dm_compat_ent {
+	const char *compat;
+	struct driver *drv;
+	const struct udevice_id *id;
+};
+
+/**
+ * struct dm_compat_idx - hash table of the compatible strings of all drivers
+ *
+ * @mask: Number of slots minus one; the number of slots is a power of two
+ * @ent: Slots, found by linear probing from the hash of the string
+ */
+struct dm_compat_idx {
+	uint mask;
+	struct dm_compat_ent ent[];
+};
+
+static u32 compat_hash(const char *compat)
+{
+	u32 hash = 5381;
+
+	while (*compat)
+		hash = hash * 33 + *compat++;
+
+	return hash;
+}
+
+static struct dm_compat_ent *compat_idx_slot(struct dm_compat_idx *idx,
+					      const char *compat)
+{
+	struct dm_compat_ent *ent;
+	uint i;
+
+	for (i = compat_hash(compat) & idx->mask;; i = (i + 1) & idx->mask) {
+		ent = &idx->ent[i];
+		if (!ent->compat || !strcmp(ent->compat, compat))
+			return ent;
+	}
+}
+
+/**
+ * compat_idx_get() - Get the compatible-string index, building it if needed
+ *
+ * The index is only built once the full heap is available, since it needs
+ * several slots for each compatible string in the image. It is never freed.
+ *
+ * Return: index, or NULL if it is not available
+ */
+static struct dm_compat_idx *compat_idx_get(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id;
+	struct dm_compat_ent *ent;
+	struct dm_compat_idx *idx;
+	struct driver *entry;
+	uint count = 0;
+	ulong size;
+
+	if (!CONFIG_IS_ENABLED(DM_COMPAT_INDEX))
+		return NULL;
+	if (gd_dm_compat_idx() || !(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return gd_dm_compat_idx();
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++)
+			count++;
+	}
+
+	/* Keep the table at most half full so that probe runs are short */
+	size = roundup_pow_of_two(max(count * 2, 2U));
+	idx = calloc(1, sizeof(*idx) + size * sizeof(idx->ent[0]));
+	if (!idx) {
+		log_debug("Cannot allocate compatible index\n");
+		return NULL;
+	}
+	idx->mask = size - 1;
+
+	/* Where drivers share a string, the first wins, as in the list */
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++) {
+			ent = compat_idx_slot(idx, id->compatible);
+			if (ent->compat)
+				continue;
+			ent->compat = id->compatible;
+			ent->drv = entry;
+			ent->id = id;
+		}
+	}
+	gd_set_dm_compat_idx(idx);
+	log_debug("Indexed %u compatible strings in %lu slots\n", count, size);
+
+	return idx;
+}
+
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct dm_compat_ent *ent;
+	struct dm_compat_idx *idx;
+	struct driver *entry;
+
+	*idp = NULL;
+	idx = compat_idx_get();
+	if (idx) {
+		ent = compat_idx_slot(idx, compat);
+		if (!ent->compat)
+			return NULL;
+		*idp = ent->id;
+
+		return ent->drv;
+	}
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
 int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		   struct driver *drv, bool pre_reloc_only)
 {
@@ -238,20 +373,25 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 			  compat);
 
 		id = NULL;
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			if (drv) {
+		if (!drv) {
+			entry = lists_driver_lookup_compat(compat, &id);
+			if (!entry)
+				continue;
+		} else {
+			for (entry = driver; entry != driver + n_ents;
+			     entry++) {
 				if (drv != entry)
 					continue;
 				if (!entry->of_match)
 					break;
+				ret = driver_check_compatible(entry->of_match,
+							      &id, compat);
+				if (!ret)
+					break;
 			}
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
+			if (entry == driver + n_ents)
+				continue;
 		}
-		if (entry == driver + n_ents)
-			continue;
 
 		if (pre_reloc_only) {
 			if (!ofnode_pre_reloc(node) &&
@@ -7,6 +7,7 @@
 #define LOG_CATEGORY	LOGC_DT
 
 #include <dm.h>
+#include <dtb_index.h>
 #include <fdtdec.h>
 #include <fdt_support.h>
 #include <log.h>
@@ -30,6 +31,7 @@ static int oftree_count;
 void oftree_reset(void)
 {
 	if (gd->flags & GD_FLG_RELOC) {
+		ofnode_cache_flush(NULL);
 		oftree_count = 0;
 		oftree_list[oftree_count++] = (void *)gd->fdt_blob;
 	}
@@ -144,6 +146,8 @@ void oftree_dispose(oftree tree)
 {
 	if (of_live_active())
 		of_live_free(tree.np);
+	else
+		ofnode_cache_flush(tree.fdt);
 }
 
 void *ofnode_lookup_fdt(ofnode node)
@@ -743,6 +747,320 @@ int ofnode_get_path(ofnode node, char *buf, int buflen)
 	}
 }
 
+#if CONFIG_IS_ENABLED(OFNODE_CACHE)
+#define OFNODE_CACHE_PATHS	16
+#define OFNODE_CACHE_PATH_LEN	64
+/* Don't build a phandle array larger than this many entries */
+#define OFNODE_CACHE_MAX_PHANDLE	0x10000
+
+#if CONFIG_IS_ENABLED(OFNODE_MULTI_TREE)
+#define OFNODE_CACHE_TREES	CONFIG_OFNODE_MULTI_TREE_MAX
+#else
+#define OFNODE_CACHE_TREES	1
+#endif
+
+/**
+ * struct ofnode_cache_path - a path looked up in a flat tree
+ *
+ * @hash: Hash of @path, 0 if the entry is empty
+ * @offset: Offset of the node
+ * @path: Path or alias that was looked up
+ */
+struct ofnode_cache_path {
+	u32 hash;
+	int offset;
+	char path[OFNODE_CACHE_PATH_LEN];
+};
+
+/**
+ * struct ofnode_cache - lookup cache for a flat tree
+ *
+ * Offsets in the cache only hold while the tree is unchanged. The ofnode write
+ * functions flush the cache. Changes made with libfdt directly which add or
+ * remove nodes or properties change the size of the structure block, which
+ * drops the cache. Other changes, such as renaming a node or changing a
+ * phandle in place, are caught by checking each cached result before it is
+ * used.
+ *
+ * @fdt: Devicetree which this cache is for, NULL if unused
+ * @struct_size: Size of the structure block when the cache was filled
+ * @phandles: Offset of the node for each phandle, or -FDT_ERR_NOTFOUND, NULL
+ *	if not built yet
+ * @num_phandles: Number of entries in @phandles, i.e. the largest phandle + 1,
+ *	or -1 if the phandles are too sparse to put in an array
+ * @paths: Paths looked up, indexed by hash
+ */
+struct ofnode_cache {
+	const void *fdt;
+	int struct_size;
+	int *phandles;
+	int num_phandles;
+	struct ofnode_cache_path paths[OFNODE_CACHE_PATHS];
+};
+
+static struct ofnode_cache *ofnode_caches[OFNODE_CACHE_TREES];
+static struct ofnode_cache_stats cache_stats;
+
+static void ofnode_cache_clear(struct ofnode_cache *cache)
+{
+	free(cache->phandles);
+	cache->phandles = NULL;
+	cache->num_phandles = 0;
+	memset(cache->paths, '\0', sizeof(cache->paths));
+	cache->struct_size = fdt_size_dt_struct(cache->fdt);
+}
+
+void ofnode_cache_flush(const void *fdt)
+{
+	struct ofnode_cache *cache;
+	int i;
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	for (i = 0; i < OFNODE_CACHE_TREES; i++) {
+		cache = ofnode_caches[i];
+		if (!cache || (fdt && cache->fdt != fdt))
+			continue;
+		cache_stats.flushes++;
+		free(cache->phandles);
+		free(cache);
+		ofnode_caches[i] = NULL;
+	}
+}
+
+void ofnode_get_cache_stats(struct ofnode_cache_stats *stats)
+{
+	*stats = cache_stats;
+}
+
+/**
+ * ofnode_cache_get() - Get the lookup cache for a flat tree
+ *
+ * The cache lives in BSS and the heap, so is only available after relocation.
+ *
+ * @fdt: Devicetree to look up
+ * Return: cache, or NULL if none is available
+ */
+static struct ofnode_cache *ofnode_cache_get(const void *fdt)
+{
+	struct ofnode_cache *cache;
+	int i, free_slot = -1;
+
+	if (!(gd->flags & GD_FLG_RELOC) || !fdt)
+		return NULL;
+	for (i = 0; i < OFNODE_CACHE_TREES; i++) {
+		cache = ofnode_caches[i];
+		if (!cache) {
+			if (free_slot == -1)
+				free_slot = i;
+			continue;
+		}
+		if (cache->fdt == fdt) {
+			if (cache->struct_size != fdt_size_dt_struct(fdt)) {
+				cache_stats.flushes++;
+				ofnode_cache_clear(cache);
+			}
+			return cache;
+		}
+	}
+	if (free_slot == -1)
+		return NULL;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	cache->fdt = fdt;
+	cache->struct_size = fdt_size_dt_struct(fdt);
+	ofnode_caches[free_slot] = cache;
+
+	return cache;
+}
+
+/**
+ * ofnode_cache_fill_phandles() - Build the phandle array for a flat tree
+ *
+ * @cache: Cache to fill
+ * Return: 0 if OK, -ve on error
+ */
+static int ofnode_cache_fill_phandles(struct ofnode_cache *cache)
+{
+	const void *fdt = cache->fdt;
+	uint32_t phandle, max;
+	int node, i;
+
+	if (fdt_find_max_phandle(fdt, &max) || !max ||
+	    max >= OFNODE_CACHE_MAX_PHANDLE) {
+		cache->num_phandles = -1;
+		return -E2BIG;
+	}
+	cache->phandles = malloc((max + 1) * sizeof(int));
+	if (!cache->phandles) {
+		cache->num_phandles = -1;
+		return -ENOMEM;
+	}
+	for (i = 0; i <= max; i++)
+		cache->phandles[i] = -FDT_ERR_NOTFOUND;
+	for (node = fdt_next_node(fdt, -1, NULL); node >= 0;
+	     node = fdt_next_node(fdt, node, NULL)) {
+		phandle = fdt_get_phandle(fdt, node);
+		if (phandle && phandle <= max &&
+		    cache->phandles[phandle] == -FDT_ERR_NOTFOUND)
+			cache->phandles[phandle] = node;
+	}
+	cache->num_phandles = max + 1;
+	log_debug("ofnode cache: %d phandles for %p\n", cache->num_phandles,
+		  fdt);
+
+	return 0;
+}
+
+/**
+ * fdt_phandle_offset() - Find a node by phandle, using the index or cache
+ *
+ * @fdt: Devicetree to search
+ * @phandle: Phandle to look for
+ * Return: offset of node, or -ve libfdt error
+ */
+static int fdt_phandle_offset(const void *fdt, uint phandle)
+{
+	struct ofnode_cache *cache;
+	int offset;
+
+	if (dtb_index_phandle(fdt, phandle, &offset))
+		return offset;
+
+	/* leave invalid phandles to libfdt, which reports them */
+	cache = phandle && phandle != (uint)-1 ? ofnode_cache_get(fdt) : NULL;
+	if (!cache)
+		return fdt_node_offset_by_phandle(fdt, phandle);
+	if (!cache->num_phandles)
+		ofnode_cache_fill_phandles(cache);
+
+	/* check the node still has this phandle, in case the tree changed */
+	if (phandle < cache->num_phandles) {
+		offset = cache->phandles[phandle];
+		if (offset >= 0 && fdt_get_phandle(fdt, offset) == phandle) {
+			cache_stats.phandle_hits++;
+			return offset;
+		}
+	}
+
+	cache_stats.phandle_misses++;
+	offset = fdt_node_offset_by_phandle(fdt, phandle);
+	if (cache->num_phandles > 0 &&
+	    (phandle < cache->num_phandles ? cache->phandles[phandle] :
+	     -FDT_ERR_NOTFOUND) != offset) {
+		log_debug("ofnode cache: phandle %x moved, dropping\n",
+			  phandle);
+		cache_stats.flushes++;
+		ofnode_cache_clear(cache);
+	}
+
+	return offset;
+}
+
+/**
+ * fdt_path_name_matches() - Check a cached path lookup against the tree
+ *
+ * This checks that the node at @offset has the name given by the last
+ * component of @path, or of the path of the alias if @path is an alias. It
+ * does not check the parent nodes.
+ *
+ * @fdt: Devicetree to check
+ * @offset: Offset of node which @path was found at
+ * @path: Path or alias that was looked up
+ * Return: true if the node matches @path
+ */
+static bool fdt_path_name_matches(const void *fdt, int offset,
+				  const char *path)
+{
+	const char *comp, *name;
+	int len;
+
+	comp = strrchr(path, '/');
+	if (!comp) {
+		path = fdt_get_alias(fdt, path);
+		comp = path ? strrchr(path, '/') : NULL;
+		if (!comp)
+			return false;
+	}
+	comp++;
+
+	name = fdt_get_name(fdt, offset, NULL);
+	if (!name)
+		return false;
+	if (!strcmp(name, comp))
+		return true;
+
+	/* the path may leave out the unit address */
+	len = strlen(comp);
+
+	return !strchr(comp, '@') && !strncmp(name, comp, len) &&
+		name[len] == '@';
+}
+
+/**
+ * fdt_path_offset_cached() - Find a node by path, using the cache
+ *
+ * Only lookups which succeed are cached, since a failed one cannot be checked
+ * against the tree before it is used.
+ *
+ * @fdt: Devicetree to search
+ * @path: Path to the node, or an alias
+ * Return: offset of node, or -ve libfdt error
+ */
+static int fdt_path_offset_cached(const void *fdt, const char *path)
+{
+	struct ofnode_cache_path *ent;
+	struct ofnode_cache *cache;
+	const char *p;
+	u32 hash = 5381;
+	int offset;
+
+	cache = ofnode_cache_get(fdt);
+	if (!cache)
+		return fdt_path_offset(fdt, path);
+
+	for (p = path; *p; p++)
+		hash = hash * 33 + *p;
+	ent = &cache->paths[hash % OFNODE_CACHE_PATHS];
+	hash |= 1;	/* 0 marks an empty entry */
+	if (ent->hash == hash && !strcmp(ent->path, path) &&
+	    fdt_path_name_matches(fdt, ent->offset, path)) {
+		cache_stats.path_hits++;
+		return ent->offset;
+	}
+
+	cache_stats.path_misses++;
+	offset = fdt_path_offset(fdt, path);
+	if (offset < 0 || p - path >= OFNODE_CACHE_PATH_LEN) {
+		if (ent->hash == hash && !strcmp(ent->path, path))
+			ent->hash = 0;
+		return offset;
+	}
+	ent->hash = hash;
+	ent->offset = offset;
+	strcpy(ent->path, path);
+
+	return offset;
+}
+#else
+static int fdt_phandle_offset(const void *fdt, uint phandle)
+{
+	int offset;
+
+	if (dtb_index_phandle(fdt, phandle, &offset))
+		return offset;
+
+	return fdt_node_offset_by_phandle(fdt, phandle);
+}
+
+static int fdt_path_offset_cached(const void *fdt, const char *path)
+{
+	return fdt_path_offset(fdt, path);
+}
+#endif /* OFNODE_CACHE */
+
 ofnode ofnode_get_by_phandle(uint phandle)
 {
 	ofnode node;
@@ -750,8 +1068,7 @@ ofnode ofnode_get_by_phandle(uint phandle)
 	if (of_live_active())
 		node = np_to_ofnode(of_find_node_by_phandle(NULL, phandle));
 	else
-		node.of_offset = fdt_node_offset_by_phandle(gd->fdt_blob,
-							    phandle);
+		node.of_offset = fdt_phandle_offset(gd->fdt_blob, phandle);
 
 	return node;
 }
@@ -759,13 +1076,14 @@ ofnode ofnode_get_by_phandle(uint phandle)
 ofnode oftree_get_by_phandle(oftree tree, uint phandle)
 {
 	ofnode node;
+	int offset;
 
-	if (of_live_active())
+	if (of_live_active()) {
 		node = np_to_ofnode(of_find_node_by_phandle(tree.np, phandle));
-	else
-		node = ofnode_from_tree_offset(tree,
-			fdt_node_offset_by_phandle(oftree_lookup_fdt(tree),
-						   phandle));
+	} else {
+		offset = fdt_phandle_offset(oftree_lookup_fdt(tree), phandle);
+		node = ofnode_from_tree_offset(tree, offset);
+	}
 
 	return node;
 }
@@ -1082,12 +1400,31 @@ int oftree_count_phandle_with_args(oftree tree, ofnode node, const char *list_na
 				cell_count, -1, NULL);
 }
 
+/**
+ * fdt_path_offset_index() - Find a node by path, using the index or cache
+ *
+ * @fdt: Devicetree to search
+ * @path: Path to the node, or an alias
+ * Return: offset of node, or -ve libfdt error
+ */
+static int fdt_path_offset_index(const void *fdt, const char *path)
+{
+	int offset;
+
+	if (*path != '/' && !strpbrk(path, "/:") &&
+	    dtb_index_alias(fdt, path, &offset))
+		return offset;
+
+	return fdt_path_offset_cached(fdt, path);
+}
+
 ofnode ofnode_path(const char *path)
 {
 	if (of_live_active())
 		return np_to_ofnode(of_find_node_by_path(path));
 	else
-		return offset_to_ofnode(fdt_path_offset(gd->fdt_blob, path));
+		return offset_to_ofnode(fdt_path_offset_index(gd->fdt_blob,
+							      path));
 }
 
 ofnode oftree_root(oftree tree)
@@ -1107,7 +1444,7 @@ ofnode oftree_path(oftree tree, const char *path)
 	} else if (*path != '/' && tree.fdt != gd->fdt_blob) {
 		return ofnode_null();  /* Aliases only on control FDT */
 	} else {
-		int offset = fdt_path_offset(tree.fdt, path);
+		int offset = fdt_path_offset_index(tree.fdt, path);
 
 		return ofnode_from_tree_offset(tree, offset);
 	}
@@ -1724,9 +2061,15 @@ ofnode ofnode_by_compatible(ofnode from, const char *compat)
 			(struct device_node *)ofnode_to_np(from), NULL,
 			compat));
 	} else {
-		return noffset_to_ofnode(from,
-			fdt_node_offset_by_compatible(ofnode_to_fdt(from),
-					ofnode_to_offset(from), compat));
+		const void *fdt = ofnode_to_fdt(from);
+		int offset;
+
+		if (!dtb_index_compatible(fdt, ofnode_to_offset(from), compat,
+					  &offset))
+			offset = fdt_node_offset_by_compatible(fdt,
+					ofnode_to_offset(from), compat);
+
+		return noffset_to_ofnode(from, offset);
 	}
 }
 
@@ -1767,6 +2110,7 @@ int ofnode_write_prop(ofnode node, const char *propname, const void *value,
 	} else {
 		ret = fdt_setprop(ofnode_to_fdt(node), ofnode_to_offset(node),
 				  propname, value, len);
+		ofnode_cache_flush(ofnode_to_fdt(node));
 		if (ret)
 			return ret == -FDT_ERR_NOSPACE ? -ENOSPC : -EINVAL;
 
@@ -1833,6 +2177,8 @@ int ofnode_delete_prop(ofnode node, const char *propname)
 			return of_remove_property(ofnode_to_np(node), prop);
 		return 0;
 	} else {
+		ofnode_cache_flush(ofnode_to_fdt(node));
+
 		return fdt_delprop(ofnode_to_fdt(node), ofnode_to_offset(node),
 				   propname);
 	}
@@ -2057,6 +2403,7 @@ int ofnode_add_subnode(ofnode node, const char *name, ofnode *subnodep)
 		int poffset = ofnode_to_offset(node);
 		int offset;
 
+		ofnode_cache_flush(fdt);
 		offset = fdt_add_subnode(fdt, poffset, name);
 		if (offset == -FDT_ERR_EXISTS) {
 			offset = fdt_subnode_offset(fdt, poffset, name);
@@ -2084,6 +2431,7 @@ int ofnode_delete(ofnode *nodep)
 		void *fdt = ofnode_to_fdt(node);
 		int offset = ofnode_to_offset(node);
 
+		ofnode_cache_flush(fdt);
 		ret = fdt_del_node(fdt, offset);
 		if (ret)
 			ret = -EFAULT;
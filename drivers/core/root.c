@@ -91,6 +91,39 @@ static int dm_setup_inst(void)
 	return 0;
 }
 
+/**
+ * dm_setup_uclass_tbl() - Set up the table of uclasses indexed by ID
+ *
+ * The table is allocated the first time and emptied after that. It is only
+ * allocated once the full heap is available, so that it does not use up the
+ * small pre-relocation heap. Until then, or if it cannot be allocated,
+ * uclass_find() searches the list of uclasses instead.
+ */
+static void dm_setup_uclass_tbl(void)
+{
+	struct uclass **tbl = gd_uclass_tbl();
+	struct uclass *uc;
+
+	if (!CONFIG_IS_ENABLED(DM_UCLASS_TABLE))
+		return;
+	if (!tbl && !(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return;
+	if (tbl) {
+		memset(tbl, '\0', UCLASS_COUNT * sizeof(*tbl));
+	} else {
+		tbl = calloc(UCLASS_COUNT, sizeof(*tbl));
+		if (!tbl) {
+			log_debug("Cannot allocate uclass table\n");
+			return;
+		}
+		gd_set_uclass_tbl(tbl);
+	}
+
+	/* With of-platdata-inst the uclasses exist already */
+	list_for_each_entry(uc, gd->uclass_root, sibling_node)
+		tbl[uc->uc_drv->id] = uc;
+}
+
 int dm_init(bool of_live)
 {
 	int ret;
@@ -105,6 +138,7 @@ int dm_init(bool of_live)
 		gd->uclass_root = &DM_UCLASS_ROOT_S_NON_CONST;
 		INIT_LIST_HEAD(DM_UCLASS_ROOT_NON_CONST);
 	}
+	dm_setup_uclass_tbl();
 
 	if (CONFIG_IS_ENABLED(OF_PLATDATA_INST)) {
 		ret = dm_setup_inst();
@@ -28,11 +28,9 @@ struct uclass *uclass_find(enum uclass_id key)
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+	if (gd_uclass_tbl())
+		return (uint)key < UCLASS_COUNT ? gd_uclass_tbl()[key] : NULL;
+
 	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -85,6 +83,8 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, DM_UCLASS_ROOT_NON_CONST);
+	if (gd_uclass_tbl())
+		gd_uclass_tbl()[id] = uc;
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -101,6 +101,8 @@ fail:
 		uclass_set_priv(uc, NULL);
 	}
 	list_del(&uc->sibling_node);
+	if (gd_uclass_tbl())
+		gd_uclass_tbl()[id] = NULL;
 fail_mem:
 	free(uc);
 
@@ -134,6 +136,8 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+	if (gd_uclass_tbl())
+		gd_uclass_tbl()[uc_drv->id] = NULL;
 	if (uc_drv->priv_auto)
 		free(uclass_get_priv(uc));
 	free(uc);
@@ -218,6 +218,8 @@ static void process_flash_blkdev(const char *cmdbuf, void *download_buffer,
 				sparse.size = info.size;
 				sparse.write = mmc_sparse_write;
 				sparse.reserve = mmc_sparse_reserve;
+				sparse.erase = NULL;
+				sparse.erase_grp = 0;
 				sparse.mssg = fastboot_fail;
 				printf("Flashing sparse image at offset " LBAFU "\n",
 				       sparse.start);
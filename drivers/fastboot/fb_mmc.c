@@ -164,6 +164,15 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+static lbaint_t fb_mmc_sparse_erase(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	struct blk_desc *dev_desc = sparse->dev_desc;
+
+	return fb_mmc_blk_write(dev_desc, blk, blkcnt, NULL);
+}
+
 static void write_raw_image(struct blk_desc *dev_desc,
 			    struct disk_partition *info, const char *part_name,
 			    void *buffer, u32 download_bytes, char *response)
@@ -611,6 +620,7 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	if (is_sparse_image(download_buffer)) {
 		struct fb_mmc_sparse sparse_priv;
 		struct sparse_storage sparse;
+		struct mmc *mmc;
 		int err;
 
 		sparse_priv.dev_desc = dev_desc;
@@ -620,8 +630,17 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		sparse.size = info.size;
 		sparse.write = fb_mmc_sparse_write;
 		sparse.reserve = fb_mmc_sparse_reserve;
+		sparse.erase = NULL;
+		sparse.erase_grp = 0;
 		sparse.mssg = fastboot_fail;
 
+		/* zeroes can be erased rather than written */
+		mmc = find_mmc_device(dev_desc->devnum);
+		if (mmc && mmc_erase_reads_zero(mmc)) {
+			sparse.erase = fb_mmc_sparse_erase;
+			sparse.erase_grp = mmc->erase_grp_size;
+		}
+
 		printf("Flashing sparse image at offset " LBAFU "\n",
 		       sparse.start);
 
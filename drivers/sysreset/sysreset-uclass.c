@@ -6,6 +6,7 @@
 
 #define LOG_CATEGORY UCLASS_SYSRESET
 
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <dm.h>
@@ -57,6 +58,10 @@ int sysreset_walk(enum sysreset_t type)
 	struct udevice *dev;
 	int ret = -ENOSYS;
 
+	/* Write back anything still held in the block cache */
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE))
+		blk_flush_all();
+
 	while (ret != -EINPROGRESS && type < SYSRESET_COUNT) {
 		for (uclass_first_device(UCLASS_SYSRESET, &dev);
 		     dev;
@@ -14,8 +14,29 @@
 #include <virtio_ring.h>
 #include "virtio_blk.h"
 
+/* Number of requests which can be submitted at a time */
+#define VIRTIO_BLK_ASYNC_REQS	4
+
+/**
+ * struct virtio_blk_slot - a submitted request in flight on the virtqueue
+ *
+ * @req: Request, NULL if the slot is free
+ * @head: Head descriptor of the request, which identifies it when done
+ * @out_hdr: Request header
+ * @status: Status written by the device
+ */
+struct virtio_blk_slot {
+	struct blk_req *req;
+	unsigned int head;
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	struct virtio_blk_slot slots[VIRTIO_BLK_ASYNC_REQS];
+#endif
 };
 
 static const u32 feature[] = {
@@ -59,19 +80,23 @@ static void virtio_blk_init_data_sg(void *buffer, lbaint_t blkcnt, struct virtio
 	sg->length = blkcnt * 512;
 }
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/*
+ * Queue a request. The headers and status must stay valid until the device
+ * has completed it. The head descriptor identifies the request when it is
+ * done, since the buffer addresses may be changed by bounce buffering.
+ */
+static int virtio_blk_add_req(struct udevice *dev, u64 sector,
+			      lbaint_t blkcnt, void *buffer, u32 type,
+			      struct virtio_blk_outhdr *out_hdr,
+			      struct virtio_blk_discard_write_zeroes *wz_hdr,
+			      u8 *status, unsigned int *headp)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	struct virtio_blk_outhdr out_hdr;
-	struct virtio_blk_discard_write_zeroes wz_hdr;
 	unsigned int num_out = 0, num_in = 0;
 	struct virtio_sg hdr_sg, wz_sg, data_sg, status_sg;
 	struct virtio_sg *sgs[3];
-	u8 status;
-	int ret;
 
-	virtio_blk_init_header_sg(dev, sector, type, &out_hdr, &hdr_sg);
+	virtio_blk_init_header_sg(dev, sector, type, out_hdr, &hdr_sg);
 	sgs[num_out++] = &hdr_sg;
 
 	switch (type) {
@@ -85,7 +110,7 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 		break;
 
 	case VIRTIO_BLK_T_WRITE_ZEROES:
-		virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt, &wz_hdr, &wz_sg);
+		virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt, wz_hdr, &wz_sg);
 		sgs[num_out++] = &wz_sg;
 		break;
 
@@ -93,20 +118,59 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 		return -EINVAL;
 	}
 
-	virtio_blk_init_status_sg(&status, &status_sg);
+	virtio_blk_init_status_sg(status, &status_sg);
 	sgs[num_out + num_in++] = &status_sg;
 	log_debug("dev=%s, active=%d, priv=%p, priv->vq=%p\n", dev->name,
 		  device_active(dev), priv, priv->vq);
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
+	return virtqueue_add_head(priv->vq, sgs, num_out, num_in, headp);
+}
+
+/* Complete the submitted request whose head descriptor is 'head' */
+static void virtio_blk_complete(struct udevice *dev, int head)
+{
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_slot *slot;
+	int i;
+
+	for (i = 0; i < VIRTIO_BLK_ASYNC_REQS; i++) {
+		slot = &priv->slots[i];
+		if (slot->req && head == (int)slot->head) {
+			slot->req->ret = slot->status == VIRTIO_BLK_S_OK ?
+				slot->req->blkcnt : -EIO;
+			slot->req->done = true;
+			slot->req = NULL;
+			return;
+		}
+	}
+#endif
+	log_err("%s: unexpected descriptor %d\n", dev->name, head);
+}
+
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_outhdr out_hdr;
+	struct virtio_blk_discard_write_zeroes wz_hdr;
+	unsigned int head;
+	u8 status;
+	int ret;
+
+	ret = virtio_blk_add_req(dev, sector, blkcnt, buffer, type, &out_hdr,
+				 &wz_hdr, &status, &head);
 	if (ret)
 		return ret;
 
 	virtqueue_kick(priv->vq);
 
 	log_debug("wait...");
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+	/* submitted requests may complete first */
+	while ((ret = virtqueue_get_head(priv->vq, NULL)) != (int)head) {
+		if (ret >= 0)
+			virtio_blk_complete(dev, ret);
+	}
 	log_debug("done\n");
 
 	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
@@ -136,6 +200,46 @@ static ulong virtio_blk_erase(struct udevice *dev, lbaint_t start,
 	return virtio_blk_do_req(dev, start, blkcnt, NULL, VIRTIO_BLK_T_WRITE_ZEROES);
 }
 
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+static int virtio_blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_slot *slot;
+	int i, ret;
+
+	for (i = 0; i < VIRTIO_BLK_ASYNC_REQS; i++) {
+		slot = &priv->slots[i];
+		if (!slot->req)
+			break;
+	}
+	if (i == VIRTIO_BLK_ASYNC_REQS)
+		return -EBUSY;
+
+	ret = virtio_blk_add_req(dev, req->start, req->blkcnt, req->buffer,
+				 req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
+				 &slot->out_hdr, NULL, &slot->status,
+				 &slot->head);
+	if (ret)
+		return ret == -ENOSPC ? -EBUSY : ret;
+
+	slot->req = req;
+	virtqueue_kick(priv->vq);
+
+	return 0;
+}
+
+static int virtio_blk_poll(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	int head;
+
+	while ((head = virtqueue_get_head(priv->vq, NULL)) >= 0)
+		virtio_blk_complete(dev, head);
+
+	return 0;
+}
+#endif
+
 static int virtio_blk_bind(struct udevice *dev)
 {
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev->parent);
@@ -194,6 +298,10 @@ static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
 	.erase	= virtio_blk_erase,
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
+#endif
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
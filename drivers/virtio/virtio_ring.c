@@ -97,8 +97,9 @@ static void virtqueue_detach_desc(struct virtqueue *vq, unsigned int idx)
 	desc->addr = cpu_to_virtio64(vq->vdev, (u64)(uintptr_t)bb->user_buffer);
 }
 
-int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
-		  unsigned int out_sgs, unsigned int in_sgs)
+int virtqueue_add_head(struct virtqueue *vq, struct virtio_sg *sgs[],
+		       unsigned int out_sgs, unsigned int in_sgs,
+		       unsigned int *headp)
 {
 	struct vring_desc *desc;
 	unsigned int descs_used = out_sgs + in_sgs;
@@ -169,9 +170,18 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	if (unlikely(vq->num_added == (1 << 16) - 1))
 		virtqueue_kick(vq);
 
+	if (headp)
+		*headp = head;
+
 	return 0;
 }
 
+int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
+		  unsigned int out_sgs, unsigned int in_sgs)
+{
+	return virtqueue_add_head(vq, sgs, out_sgs, in_sgs, NULL);
+}
+
 static bool virtqueue_kick_prepare(struct virtqueue *vq)
 {
 	u16 new, old;
@@ -234,7 +244,7 @@ static inline bool more_used(const struct virtqueue *vq)
 			vq->vring.used->idx);
 }
 
-void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
+int virtqueue_get_head(struct virtqueue *vq, unsigned int *len)
 {
 	unsigned int i;
 	u16 last_used;
@@ -242,7 +252,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 	if (!more_used(vq)) {
 		debug("(%s.%d): No more buffers in queue\n",
 		      vq->vdev->name, vq->index);
-		return NULL;
+		return -ENOENT;
 	}
 
 	/* Only get used array entries after they have been exposed by host */
@@ -260,13 +270,13 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 	if (unlikely(i >= vq->vring.num)) {
 		printf("(%s.%d): id %u out of range\n",
 		       vq->vdev->name, vq->index, i);
-		return NULL;
+		return -EIO;
 	}
 
 	if (unlikely(!vq->vring_desc_shadow[i].chain_head)) {
 		printf("(%s.%d): id %u is not a head\n",
 		       vq->vdev->name, vq->index, i);
-		return NULL;
+		return -EIO;
 	}
 
 	detach_buf(vq, i);
@@ -280,7 +290,18 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
-	return (void *)(uintptr_t)vq->vring_desc_shadow[i].addr;
+	return i;
+}
+
+void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
+{
+	int head;
+
+	head = virtqueue_get_head(vq, len);
+	if (head < 0)
+		return NULL;
+
+	return (void *)(uintptr_t)vq->vring_desc_shadow[head].addr;
 }
 
 static struct virtqueue *__vring_new_virtqueue(unsigned int index,
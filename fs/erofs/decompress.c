@@ -36,11 +36,14 @@ static int z_erofs_decompress_deflate(struct z_erofs_decompress_req *rq)
 	if (inputmargin >= rq->inputsize)
 		return -EFSCORRUPTED;
 
+	/*
+	 * The skipped head only needs a scratch buffer, since inflate keeps
+	 * its own window for back-references; the rest is decoded in place.
+	 */
 	if (rq->decodedskip) {
-		buff = malloc(rq->decodedlength);
+		buff = malloc(min(rq->decodedskip, erofs_blksiz()));
 		if (!buff)
 			return -ENOMEM;
-		dest = buff;
 	}
 
 	/* allocate inflate state */
@@ -57,8 +60,20 @@ static int z_erofs_decompress_deflate(struct z_erofs_decompress_req *rq)
 
 	strm.next_in = src + inputmargin;
 	strm.avail_in = rq->inputsize - inputmargin;
+
+	while (strm.total_out < rq->decodedskip) {
+		strm.next_out = buff;
+		strm.avail_out = min_t(unsigned long, erofs_blksiz(),
+				       rq->decodedskip - strm.total_out);
+		ret = inflate(&strm, Z_SYNC_FLUSH);
+		if (ret != Z_OK) {
+			ret = zerr(ret);
+			goto out_inflate_end;
+		}
+	}
+
 	strm.next_out = dest;
-	strm.avail_out = rq->decodedlength;
+	strm.avail_out = rq->decodedlength - rq->decodedskip;
 
 	ret = inflate(&strm, rq->partial_decoding ? Z_SYNC_FLUSH : Z_FINISH);
 	if (ret != Z_STREAM_END || strm.total_out != rq->decodedlength) {
@@ -68,10 +83,6 @@ static int z_erofs_decompress_deflate(struct z_erofs_decompress_req *rq)
 		}
 	}
 
-	if (rq->decodedskip)
-		memcpy(rq->out, dest + rq->decodedskip,
-		       rq->decodedlength - rq->decodedskip);
-
 out_inflate_end:
 	inflateEnd(&strm);
 	if (buff)
@@ -21,6 +21,7 @@
 #include <blk.h>
 #include <ext_common.h>
 #include <ext4fs.h>
+#include <fs.h>
 #include <log.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -1640,6 +1641,84 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/**
+ * read_allocated_run() - Map a run of file blocks to device blocks
+ *
+ * For inodes using extents this returns the part of the extent (or hole)
+ * which starts at @fileblock, so that the caller can read it with a single
+ * device access. Other inodes are mapped one block at a time.
+ *
+ * @inode:	Inode of the file
+ * @fileblock:	First file block of the run
+ * @cache:	Extent block cache to use, or NULL
+ * @count:	Returns the number of blocks in the run
+ * Return: first filesystem block of the run, 0 for a hole, -ve on error
+ */
+long int read_allocated_run(struct ext2_inode *inode, int fileblock,
+			    struct ext_block_cache *cache, int *count)
+{
+	struct ext_block_cache *c, cd;
+	struct ext4_extent_header *ext_block, *root;
+	struct ext4_extent *extent;
+	long int startblock, endblock;
+	unsigned long long start;
+	long int blknr = 0;
+	int log2_blksz;
+	int i;
+
+	*count = 1;
+	if (!(le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL))
+		return read_allocated_block(inode, fileblock, cache);
+
+	root = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+	if (cache) {
+		c = cache;
+	} else {
+		c = &cd;
+		ext_cache_init(c);
+	}
+	ext_block = ext4fs_get_extent_block(ext4fs_root, c, root, fileblock,
+					    log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		blknr = -EINVAL;
+		goto out;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	/*
+	 * Past the last extent of the tree the rest of the file is a hole. With
+	 * a deeper tree the next leaf may hold more extents, so only report a
+	 * one-block hole and let the caller look again.
+	 */
+	*count = le16_to_cpu(root->eh_depth) ? 1 : INT_MAX - fileblock;
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		endblock = startblock + le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			*count = startblock - fileblock;
+			break;
+		} else if (fileblock < endblock) {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			*count = endblock - fileblock;
+			blknr = (fileblock - startblock) + start;
+			break;
+		}
+	}
+out:
+	if (!cache)
+		ext_cache_fini(c);
+
+	return blknr;
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache)
 {
@@ -2308,16 +2387,25 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 int ext4fs_open(const char *filename, loff_t *len)
 {
 	struct ext2fs_node *fdiro = NULL;
-	int status;
+	int status, ino;
 
 	if (ext4fs_root == NULL)
 		return -1;
 
 	ext4fs_file = NULL;
-	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
-				  FILETYPE_REG);
-	if (status == 0)
-		goto fail;
+	if (!fs_dcache_lookup(filename, &ino, sizeof(ino))) {
+		fdiro = zalloc(sizeof(struct ext2fs_node));
+		if (!fdiro)
+			return -1;
+		fdiro->data = ext4fs_root;
+		fdiro->ino = ino;
+	} else {
+		status = ext4fs_find_file(filename, &ext4fs_root->diropen,
+					  &fdiro, FILETYPE_REG);
+		if (status == 0)
+			goto fail;
+		fs_dcache_add(filename, &fdiro->ino, sizeof(fdiro->ino));
+	}
 
 	if (!fdiro->inode_read) {
 		status = ext4fs_read_inode(fdiro->data, fdiro->ino,
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <ext_common.h>
 #include <ext4fs.h>
+#include <fs.h>
 #include <malloc.h>
 #include <part.h>
 #include <u-boot/uuid.h>
@@ -71,134 +72,95 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
 	lbaint_t delayed_extent = 0;
 	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
+	loff_t remaining;
+	int skipfirst;
+	int status;
+	int count;
+	long int blknr;
+	lbaint_t i;
 	struct ext_block_cache cache;
 
-	ext_cache_init(&cache);
-
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
 		len = (filesize - pos);
 
-	if (blocksize <= 0 || len <= 0) {
-		ext_cache_fini(&cache);
+	if (blocksize <= 0 || len <= 0)
 		return -1;
-	}
-
-	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
-
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-
-		blknr = blknr << log2_fs_blocksize;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+	ext_cache_init(&cache);
 
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
-		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
-			}
+	/*
+	 * Walk the file one run of blocks at a time: with extents, a run is
+	 * the rest of an extent or hole, so a contiguous file takes a single
+	 * device read per extent. Adjacent runs are merged as well.
+	 */
+	i = lldiv(pos, blocksize);
+	skipfirst = pos - (loff_t)blocksize * i;
+	for (remaining = len; remaining > 0; i += count) {
+		loff_t n;
+
+		blknr = read_allocated_run(&node->inode, i, &cache, &count);
+		if (blknr < 0)
+			goto fail;
+
+		n = (loff_t)count * blocksize - skipfirst;
+		if (n > remaining)
+			n = remaining;
+
+		if (blknr && delayed_extent && delayed_next == blknr &&
+		    delayed_extent + n <= INT_MAX) {
+			delayed_extent += n;
+			delayed_next += count;
 		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
+			if (delayed_extent) {
 				/* spill */
 				status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
 							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
+				if (status == 0)
+					goto fail;
+				delayed_extent = 0;
+			}
+			if (blknr) {
+				delayed_start = (lbaint_t)blknr <<
+					log2_fs_blocksize;
+				delayed_extent = n;
+				delayed_skipfirst = skipfirst;
+				delayed_buf = buf;
+				delayed_next = blknr + count;
+			} else {
+				memset(buf, 0, n);
 			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
 		}
-		buf += blocksize - skipfirst;
+		buf += n;
+		remaining -= n;
+		skipfirst = 0;
 	}
-	if (previous_block_number != -1) {
+	if (delayed_extent) {
 		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-		previous_block_number = -1;
+		status = ext4fs_devread(delayed_start, delayed_skipfirst,
+					delayed_extent, delayed_buf);
+		if (status == 0)
+			goto fail;
 	}
 
 	*actread  = len;
 	ext_cache_fini(&cache);
 	return 0;
+
+fail:
+	ext_cache_fini(&cache);
+	return -1;
 }
 
 int ext4fs_opendir(const char *dirname, struct fs_dir_stream **dirsp)
@@ -354,6 +316,8 @@ int ext4fs_exists(const char *filename)
 				&filetype);
 	if (dirnode)
 		ext4fs_free_node(dirnode, &ext4fs_root->diropen);
+	if (!ret)
+		fs_dcache_add(filename, NULL, 0);
 
 	return ret;
 }
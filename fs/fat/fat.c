@@ -150,17 +150,120 @@ static void get_name(dir_entry *dirent, char *s_name)
 		*s_name = DELETED_FLAG;
 }
 
-static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, struct fat_win *win);
 
 #if !CONFIG_IS_ENABLED(FAT_WRITE)
 /* Stub for read only operation */
-int flush_dirty_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, struct fat_win *win)
 {
 	(void)(mydata);
+	(void)(win);
 	return 0;
 }
 #endif
 
+/*
+ * Allocate the FAT cache and mark all windows unused.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_alloc(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE * FATBUFWINDOWS);
+	if (!mydata->fatbuf) {
+		debug("Error: allocating memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		mydata->fatwin[i].num = -1;
+		mydata->fatwin[i].dirty = 0;
+		mydata->fatwin[i].stamp = 0;
+	}
+	mydata->fatstamp = 0;
+	mydata->fatwinlast = 0;
+
+	return 0;
+}
+
+static __u8 *fat_win_buf(fsdata *mydata, struct fat_win *win)
+{
+	return mydata->fatbuf + (win - mydata->fatwin) * FATBUFSIZE;
+}
+
+/*
+ * Write all modified FAT windows back to the disk.
+ * Return 0 on success, -1 otherwise.
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		if (mydata->fatwin[i].dirty &&
+		    flush_fat_window(mydata, &mydata->fatwin[i]) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Get the buffer holding window 'bufnum' of the FAT. If it is not cached, it
+ * is read into the least recently used window, writing that back first if
+ * it was modified. If 'dirty' is set, the window is marked as modified.
+ * Return NULL on failure.
+ */
+static __u8 *get_fat_window(fsdata *mydata, __u32 bufnum, bool dirty)
+{
+	struct fat_win *win = &mydata->fatwin[mydata->fatwinlast];
+	struct fat_win *victim = &mydata->fatwin[0];
+	int i;
+
+	if (win->num != (int)bufnum) {
+		for (i = 0; i < FATBUFWINDOWS; i++) {
+			win = &mydata->fatwin[i];
+			if (win->num == (int)bufnum)
+				break;
+			if (win->stamp < victim->stamp)
+				victim = win;
+		}
+
+		if (i == FATBUFWINDOWS) {
+			__u32 getsize = FATBUFBLOCKS;
+			__u32 fatlength = mydata->fatlength;
+			__u32 startblock = bufnum * FATBUFBLOCKS;
+
+			/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+			if (startblock + getsize > fatlength)
+				getsize = fatlength - startblock;
+
+			startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+			/* Write back the window being replaced */
+			win = victim;
+			if (win->dirty && flush_fat_window(mydata, win) < 0)
+				return NULL;
+
+			if (disk_read(startblock, getsize,
+				      fat_win_buf(mydata, win)) < 0) {
+				debug("Error reading FAT blocks\n");
+				win->num = -1;
+				return NULL;
+			}
+			win->num = bufnum;
+		}
+		mydata->fatwinlast = win - mydata->fatwin;
+	}
+
+	win->stamp = ++mydata->fatstamp;
+	if (dirty)
+		win->dirty = 1;
+
+	return fat_win_buf(mydata, win);
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -170,6 +273,7 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
+	__u8 *fatbuf;
 
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		log_err("Invalid FAT entry: %#08x\n", entry);
@@ -198,42 +302,23 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Find the block of FAT entries in the cache, or read it */
+	fatbuf = get_fat_window(mydata, bufnum, false);
+	if (!fatbuf)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *)fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *)fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -308,6 +393,122 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Cluster runs of the file read last, kept across reads so that reading a
+ * file piece by piece does not follow its cluster chain from the start each
+ * time. Each run is a sequence of adjacent clusters, read with one
+ * disk_read(). The map is extended as far as needed by each read and is
+ * dropped when the FAT is modified or the filesystem is mounted again.
+ */
+struct fat_run {
+	__u32	fclust;		/* Index of the first cluster in the file */
+	__u32	clust;		/* First cluster on the disk */
+	__u32	count;		/* Number of clusters */
+};
+
+static struct {
+	__u32	mount_id;	/* Mount the map belongs to */
+	__u32	start;		/* First cluster of the file */
+	struct fat_run *runs;	/* Runs found so far */
+	int	nruns;		/* Number of runs used */
+	int	size;		/* Number of runs allocated */
+} runmap;
+
+static void fat_runmap_drop(void)
+{
+	free(runmap.runs);
+	runmap.runs = NULL;
+	runmap.nruns = 0;
+	runmap.size = 0;
+}
+
+static int fat_runmap_add(__u32 fclust, __u32 clust)
+{
+	struct fat_run *run;
+
+	if (runmap.nruns == runmap.size) {
+		int size = runmap.size ? runmap.size * 2 : 16;
+
+		run = realloc(runmap.runs, size * sizeof(*run));
+		if (!run) {
+			debug("Error: allocating memory\n");
+			return -1;
+		}
+		runmap.runs = run;
+		runmap.size = size;
+	}
+
+	run = &runmap.runs[runmap.nruns++];
+	run->fclust = fclust;
+	run->clust = clust;
+	run->count = 1;
+
+	return 0;
+}
+
+/*
+ * Map the clusters of the file starting at cluster 'start', up to and
+ * including cluster number 'last' within the file.
+ * Return 0 on success, -1 if the cluster chain is invalid.
+ */
+static int fat_runmap_get(fsdata *mydata, __u32 start, __u32 last)
+{
+	struct fat_run *run;
+	__u32 next;
+
+	if (runmap.mount_id != mydata->mount_id || runmap.start != start) {
+		runmap.nruns = 0;
+		runmap.mount_id = mydata->mount_id;
+		runmap.start = start;
+	}
+
+	if (!runmap.nruns) {
+		if (CHECK_CLUST(start, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", start);
+			return -1;
+		}
+		if (fat_runmap_add(0, start))
+			return -1;
+	}
+
+	run = &runmap.runs[runmap.nruns - 1];
+	while (run->fclust + run->count <= last) {
+		next = get_fatent(mydata, run->clust + run->count - 1);
+		if (CHECK_CLUST(next, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", next);
+			return -1;
+		}
+		if (next == run->clust + run->count) {
+			run->count++;
+			continue;
+		}
+		if (fat_runmap_add(run->fclust + run->count, next)) {
+			runmap.nruns = 0;
+			return -1;
+		}
+		run = &runmap.runs[runmap.nruns - 1];
+	}
+
+	return 0;
+}
+
+/* Return the index of the run holding cluster number 'fclust' of the file */
+static int fat_runmap_find(__u32 fclust)
+{
+	int lo = 0, hi = runmap.nruns - 1;
+
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+
+		if (runmap.runs[mid].fclust <= fclust)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -328,9 +529,11 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	int shift = ilog2(bytesperclust);
+	struct fat_run *run;
+	__u32 fclust, count;
 	loff_t actsize;
+	int i;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -345,21 +548,17 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
+	/* map the clusters holding the data to read */
+	if (fat_runmap_get(mydata, START(dentptr), (filesize - 1) >> shift)) {
+		printf("Invalid FAT entry\n");
+		return -1;
 	}
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
+	/* go to cluster at pos */
+	fclust = pos >> shift;
+	i = fat_runmap_find(fclust);
+	run = &runmap.runs[i];
+	actsize = (loff_t)fclust << shift;
 	filesize -= actsize;
 	pos -= actsize;
 
@@ -374,7 +573,8 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			return -1;
 		}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
+		if (get_cluster(mydata, run->clust + fclust - run->fclust,
+				tmp_buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
 			free(tmp_buffer);
 			return -1;
@@ -384,62 +584,29 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 		memcpy(buffer, tmp_buffer + pos, actsize);
 		free(tmp_buffer);
 		*gotsize += actsize;
-		if (!filesize)
-			return 0;
 		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
+		fclust++;
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
+	/* read the rest one run of consecutive clusters at a time */
+	while (filesize > 0) {
+		if (fclust >= run->fclust + run->count)
+			run++;
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		count = run->fclust + run->count - fclust;
+		actsize = min(filesize, (loff_t)count << shift);
+		if (get_cluster(mydata, run->clust + fclust - run->fclust,
+				buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		fclust += count;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -615,7 +782,10 @@ out_free:
 	return ret;
 }
 
-static int get_fs_info(fsdata *mydata)
+/* Last value given to fsdata.mount_id */
+static __u32 fat_mount_id;
+
+static int read_fs_info(fsdata *mydata)
 {
 	boot_sector bs;
 	volume_info volinfo;
@@ -683,13 +853,10 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
+	if (fat_cache_alloc(mydata))
 		return -1;
-	}
+
+	mydata->mount_id = ++fat_mount_id;
 
 	debug("FAT%d, fat_sect: %d, fatlength: %d\n",
 	       mydata->fatsize, mydata->fat_sect, mydata->fatlength);
@@ -704,6 +871,112 @@ static int get_fs_info(fsdata *mydata)
 	return 0;
 }
 
+/*
+ * The mounted volume: the parameters and FAT cache of the filesystem used
+ * last are kept across operations, so that a sequence of commands on the
+ * same partition reads and parses the boot sector only once. The mount is
+ * valid while the block device generation is unchanged, which it is not
+ * after any write to the device (including our own), a hardware partition
+ * switch or media change.
+ *
+ * One operation at a time borrows the cached FAT windows; an operation
+ * started while they are borrowed, e.g. with a directory stream open, gets
+ * a private copy of the parameters and its own FAT cache.
+ */
+static struct {
+	bool	valid;		/* fsdata holds a mounted volume */
+	bool	busy;		/* fsdata.fatbuf is lent to an operation */
+	struct blk_desc *dev;	/* Device and partition of the volume */
+	lbaint_t part_start;
+	lbaint_t part_size;
+	u32	gen;		/* Generation of the device when mounted */
+	fsdata	fsdata;
+	struct fat_mount_stats stats;
+} fat_mount;
+
+static bool fat_mount_valid(void)
+{
+	return fat_mount.valid && fat_mount.dev == cur_dev &&
+	       fat_mount.part_start == cur_part_info.start &&
+	       fat_mount.part_size == cur_part_info.size &&
+	       fat_mount.gen == cur_dev->gen;
+}
+
+static void fat_mount_drop(void)
+{
+	if (fat_mount.valid && !fat_mount.busy)
+		free(fat_mount.fsdata.fatbuf);
+	fat_mount.valid = false;
+	fat_mount.busy = false;
+}
+
+/*
+ * Set up 'mydata' for the current device, from the mounted volume if it is
+ * still valid. Release it with put_fs_info().
+ * Return 0 on success, -1 otherwise.
+ */
+static int get_fs_info(fsdata *mydata)
+{
+	int ret;
+
+	if (!CONFIG_IS_ENABLED(BLK) || !cur_dev)
+		return read_fs_info(mydata);
+
+	if (fat_mount_valid()) {
+		fat_mount.stats.hits++;
+		*mydata = fat_mount.fsdata;
+		if (!fat_mount.busy) {
+			fat_mount.busy = true;
+			return 0;
+		}
+
+		return fat_cache_alloc(mydata);
+	}
+
+	fat_mount.stats.misses++;
+	ret = read_fs_info(mydata);
+	if (ret || fat_mount.busy)
+		return ret;
+
+	fat_mount_drop();
+
+	fat_mount.fsdata = *mydata;
+	fat_mount.dev = cur_dev;
+	fat_mount.part_start = cur_part_info.start;
+	fat_mount.part_size = cur_part_info.size;
+	fat_mount.gen = cur_dev->gen;
+	fat_mount.valid = true;
+	fat_mount.busy = true;
+
+	return 0;
+}
+
+/* Release 'mydata' set up by get_fs_info(), keeping the FAT cache if shared */
+static void put_fs_info(fsdata *mydata)
+{
+	int i;
+
+	if (!fat_mount.busy || mydata->fatbuf != fat_mount.fsdata.fatbuf) {
+		free(mydata->fatbuf);
+		return;
+	}
+
+	/* windows left dirty by a failed write may not match the disk */
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		if (mydata->fatwin[i].dirty) {
+			mydata->fatwin[i].num = -1;
+			mydata->fatwin[i].dirty = 0;
+		}
+	}
+	fat_mount.fsdata = *mydata;
+	fat_mount.busy = false;
+}
+
+void fat_get_mount_stats(struct fat_mount_stats *stats)
+{
+	*stats = fat_mount.stats;
+}
+
 /**
  * struct fat_itr - directory iterator, to simplify filesystem traversal
  *
@@ -1192,6 +1465,37 @@ static int fat_itr_resolve(fat_itr *itr, const char *path, unsigned type)
 	return -ENOENT;
 }
 
+/*
+ * Look up 'path' from the root directory, using the directory entry cache
+ * of the fs layer. 'dent' is set to a copy of the directory entry; for
+ * directories only the ATTR_DIR attribute is set.
+ * Return 0 on success, -ENOENT if the path does not exist, other -ve on error
+ */
+static int fat_itr_lookup(fat_itr *itr, const char *path, dir_entry *dent)
+{
+	int ret;
+
+	ret = fs_dcache_lookup(path, dent, sizeof(*dent));
+	if (ret != -ENODATA)
+		return ret;
+
+	ret = fat_itr_resolve(itr, path, TYPE_ANY);
+	if (ret == -ENOENT)
+		fs_dcache_add(path, NULL, 0);
+	if (ret)
+		return ret;
+
+	if (itr->dent) {
+		memcpy(dent, itr->dent, sizeof(*dent));
+	} else {
+		memset(dent, '\0', sizeof(*dent));
+		dent->attr = ATTR_DIR;
+	}
+	fs_dcache_add(path, dent, sizeof(*dent));
+
+	return 0;
+}
+
 int file_fat_detectfs(void)
 {
 	boot_sector bs;
@@ -1219,6 +1523,9 @@ int file_fat_detectfs(void)
 	vol_label[11] = '\0';
 
 	printf("Filesystem: FAT%d \"%s\"\n", fatsize, vol_label);
+	if (CONFIG_IS_ENABLED(BLK))
+		printf("Mount cache: %u hits, %u misses\n",
+		       fat_mount.stats.hits, fat_mount.stats.misses);
 
 	return 0;
 }
@@ -1226,6 +1533,7 @@ int file_fat_detectfs(void)
 int fat_exists(const char *filename)
 {
 	fsdata fsdata;
+	dir_entry dent;
 	fat_itr *itr;
 	int ret;
 
@@ -1236,8 +1544,8 @@ int fat_exists(const char *filename)
 	if (ret)
 		goto out;
 
-	ret = fat_itr_resolve(itr, filename, TYPE_ANY);
-	free(fsdata.fatbuf);
+	ret = fat_itr_lookup(itr, filename, &dent);
+	put_fs_info(&fsdata);
 out:
 	free(itr);
 	return ret == 0;
@@ -1268,6 +1576,7 @@ static void __maybe_unused fat2rtc(u16 date, u16 time, struct rtc_time *tm)
 int fat_size(const char *filename, loff_t *size)
 {
 	fsdata fsdata;
+	dir_entry dent;
 	fat_itr *itr;
 	int ret;
 
@@ -1278,25 +1587,20 @@ int fat_size(const char *filename, loff_t *size)
 	if (ret)
 		goto out_free_itr;
 
-	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
-	if (ret) {
-		/*
-		 * Directories don't have size, but fs_size() is not
-		 * expected to fail if passed a directory path:
-		 */
-		free(fsdata.fatbuf);
-		ret = fat_itr_root(itr, &fsdata);
-		if (ret)
-			goto out_free_itr;
-		ret = fat_itr_resolve(itr, filename, TYPE_DIR);
-		if (!ret)
-			*size = 0;
+	ret = fat_itr_lookup(itr, filename, &dent);
+	if (ret)
 		goto out_free_both;
-	}
 
-	*size = FAT2CPU32(itr->dent->size);
+	/*
+	 * Directories don't have size, but fs_size() is not
+	 * expected to fail if passed a directory path:
+	 */
+	if (dent.attr & ATTR_DIR)
+		*size = 0;
+	else
+		*size = FAT2CPU32(dent.size);
 out_free_both:
-	free(fsdata.fatbuf);
+	put_fs_info(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1306,6 +1610,7 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		  loff_t *actread)
 {
 	fsdata fsdata;
+	dir_entry dent;
 	fat_itr *itr;
 	int ret;
 
@@ -1316,19 +1621,20 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	if (ret)
 		goto out_free_itr;
 
-	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	ret = fat_itr_lookup(itr, filename, &dent);
 	if (ret)
 		goto out_free_both;
+	if (dent.attr & ATTR_DIR) {
+		ret = -ENOENT;
+		goto out_free_both;
+	}
 
 	debug("reading %s at pos %llu\n", filename, offset);
 
-	/* For saving default max clustersize memory allocated to malloc pool */
-	dir_entry *dentptr = itr->dent;
-
-	ret = get_contents(&fsdata, dentptr, offset, buf, len, actread);
+	ret = get_contents(&fsdata, &dent, offset, buf, len, actread);
 
 out_free_both:
-	free(fsdata.fatbuf);
+	put_fs_info(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1375,7 +1681,7 @@ int fat_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	return 0;
 
 fail_free_both:
-	free(dir->fsdata.fatbuf);
+	put_fs_info(&dir->fsdata);
 fail_free_dir:
 	free(dir);
 	return ret;
@@ -1415,7 +1721,7 @@ int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
 void fat_closedir(struct fs_dir_stream *dirs)
 {
 	fat_dir *dir = (fat_dir *)dirs;
-	free(dir->fsdata.fatbuf);
+	put_fs_info(&dir->fsdata);
 	free(dir);
 }
 
@@ -474,11 +474,172 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 	return -1;
 }
 
+#if CONFIG_IS_ENABLED(FS_DCACHE)
+#define FS_DCACHE_PATH_MAX	128
+
+/**
+ * struct fs_dcache_entry - path looked up on a partition
+ *
+ * @desc:	block device of the partition
+ * @part:	partition number
+ * @fstype:	filesystem type (FS_TYPE_...)
+ * @gen:	generation of the block device when the entry was added
+ * @stamp:	time of last use for LRU replacement, 0 if the entry is unused
+ * @hash:	hash of @path
+ * @len:	number of bytes in @data, -1 if @path does not exist
+ * @data:	data stored by the filesystem
+ * @path:	normalised path, without leading, trailing or repeated slashes
+ */
+struct fs_dcache_entry {
+	struct blk_desc *desc;
+	int part;
+	int fstype;
+	u32 gen;
+	u32 stamp;
+	u32 hash;
+	int len;
+	u8 data[FS_DCACHE_DATA_MAX];
+	char path[FS_DCACHE_PATH_MAX];
+};
+
+static struct fs_dcache_entry *fs_dcache;
+static u32 fs_dcache_stamp;
+
+/*
+ * Copy @path to @out in normalised form and return its hash, or 0 if the path
+ * is too long to be cached
+ */
+static u32 fs_dcache_key(const char *path, char *out)
+{
+	u32 hash = 5381;
+	int len = 0;
+
+	while (*path) {
+		if (*path == '/' && (!len || out[len - 1] == '/')) {
+			path++;
+			continue;
+		}
+		if (len == FS_DCACHE_PATH_MAX - 1)
+			return 0;
+		hash = hash * 33 + *path;
+		out[len++] = *path++;
+	}
+	if (len && out[len - 1] == '/')
+		len--;
+	out[len] = '\0';
+
+	return hash ? hash : 1;
+}
+
+/* Find the valid entry for @path on the current partition, if any */
+static struct fs_dcache_entry *fs_dcache_find(const char *path, u32 hash)
+{
+	struct fs_dcache_entry *ent;
+	int i;
+
+	if (!fs_dcache || !fs_dev_desc || fs_type == FS_TYPE_ANY)
+		return NULL;
+
+	for (i = 0, ent = fs_dcache; i < CONFIG_FS_DCACHE_ENTRIES; i++, ent++) {
+		if (!ent->stamp || ent->hash != hash || ent->desc != fs_dev_desc ||
+		    ent->part != fs_dev_part || ent->fstype != fs_type ||
+		    strcmp(ent->path, path))
+			continue;
+
+		/* the device has been written to or re-initialised since */
+		if (ent->gen != fs_dev_desc->gen) {
+			ent->stamp = 0;
+			return NULL;
+		}
+		ent->stamp = ++fs_dcache_stamp;
+
+		return ent;
+	}
+
+	return NULL;
+}
+
+int fs_dcache_lookup(const char *path, void *data, int size)
+{
+	struct fs_dcache_entry *ent;
+	char key[FS_DCACHE_PATH_MAX];
+	u32 hash;
+
+	hash = fs_dcache_key(path, key);
+	if (!hash)
+		return -ENODATA;
+
+	ent = fs_dcache_find(key, hash);
+	if (!ent)
+		return -ENODATA;
+	if (ent->len < 0)
+		return -ENOENT;
+	if (data && ent->len != size)
+		return -ENODATA;
+	if (data)
+		memcpy(data, ent->data, size);
+
+	return 0;
+}
+
+void fs_dcache_add(const char *path, const void *data, int size)
+{
+	struct fs_dcache_entry *ent, *victim;
+	char key[FS_DCACHE_PATH_MAX];
+	u32 hash;
+	int i;
+
+	if (!fs_dev_desc || fs_type == FS_TYPE_ANY || size > FS_DCACHE_DATA_MAX)
+		return;
+
+	hash = fs_dcache_key(path, key);
+	if (!hash)
+		return;
+
+	if (!fs_dcache) {
+		fs_dcache = calloc(CONFIG_FS_DCACHE_ENTRIES, sizeof(*fs_dcache));
+		if (!fs_dcache)
+			return;
+	}
+
+	victim = fs_dcache_find(key, hash);
+	if (!victim) {
+		victim = fs_dcache;
+		for (i = 0, ent = fs_dcache; i < CONFIG_FS_DCACHE_ENTRIES;
+		     i++, ent++) {
+			if (ent->stamp < victim->stamp)
+				victim = ent;
+		}
+	}
+
+	victim->desc = fs_dev_desc;
+	victim->part = fs_dev_part;
+	victim->fstype = fs_type;
+	victim->gen = fs_dev_desc->gen;
+	victim->stamp = ++fs_dcache_stamp;
+	victim->hash = hash;
+	victim->len = data ? size : -1;
+	if (data)
+		memcpy(victim->data, data, size);
+	strcpy(victim->path, key);
+}
+#endif
+
+/* Write back anything the block cache holds for the filesystem's device */
+static int fs_flush(void)
+{
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE) || !fs_dev_desc)
+		return 0;
+
+	return blk_dflush(fs_dev_desc);
+}
+
 void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
 	info->close();
+	fs_flush();
 
 	fs_type = FS_TYPE_ANY;
 }
@@ -509,7 +670,11 @@ int fs_exists(const char *filename)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	ret = info->exists(filename);
+	ret = fs_dcache_lookup(filename, NULL, 0);
+	if (ret == -ENODATA)
+		ret = info->exists(filename);
+	else
+		ret = !ret;
 
 	fs_close();
 
@@ -522,7 +687,10 @@ int fs_size(const char *filename, loff_t *size)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	ret = info->size(filename, size);
+	/* bootflow scanning probes many paths which do not exist */
+	ret = fs_dcache_lookup(filename, NULL, 0);
+	if (ret != -ENOENT)
+		ret = info->size(filename, size);
 
 	fs_close();
 
@@ -569,6 +737,11 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	void *buf;
 	int ret;
 
+	if (fs_dcache_lookup(filename, NULL, 0) == -ENOENT) {
+		fs_close();
+		return -ENOENT;
+	}
+
 #if CONFIG_IS_ENABLED(LMB)
 	if (do_lmb_check) {
 		ret = fs_read_lmb_check(filename, addr, offset, len, info);
@@ -607,12 +780,17 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	int ret;
 
 	buf = map_sysmem(addr, len);
+	blkcache_hold_writes(true);
 	ret = info->write(filename, buf, offset, len, actwrite);
+	blkcache_hold_writes(false);
 	unmap_sysmem(buf);
 
 	if (ret < 0 && len != *actwrite) {
 		log_err("** Unable to write file %s **\n", filename);
 		ret = -1;
+	} else if (fs_flush()) {
+		log_err("** Unable to write file %s **\n", filename);
+		ret = -EIO;
 	}
 	fs_close();
 
@@ -677,7 +855,9 @@ int fs_unlink(const char *filename)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	blkcache_hold_writes(true);
 	ret = info->unlink(filename);
+	blkcache_hold_writes(false);
 
 	fs_close();
 
@@ -690,7 +870,9 @@ int fs_mkdir(const char *dirname)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	blkcache_hold_writes(true);
 	ret = info->mkdir(dirname);
+	blkcache_hold_writes(false);
 
 	fs_close();
 
@@ -702,7 +884,9 @@ int fs_ln(const char *fname, const char *target)
 	struct fstype_info *info = fs_get_info(fs_type);
 	int ret;
 
+	blkcache_hold_writes(true);
 	ret = info->ln(fname, target);
+	blkcache_hold_writes(false);
 
 	if (ret < 0) {
 		log_err("** Unable to create link %s -> %s **\n", fname, target);
@@ -743,6 +927,7 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	loff_t len_read;
 	int ret;
 	unsigned long time;
+	unsigned long blksz;
 	char *ep;
 
 	if (argc < 2)
@@ -784,6 +969,7 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	else
 		pos = 0;
 
+	blksz = fs_dev_desc ? fs_dev_desc->blksz : 0;
 	time = get_timer(0);
 	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
 	time = get_timer(time);
@@ -803,6 +989,10 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 		puts(")");
 	}
 	puts("\n");
+	if (time > 0 && blksz)
+		log_debug("%llu blocks of %lu bytes, %llu blocks/s\n",
+			  div_u64(len_read, blksz), blksz,
+			  div_u64(div_u64(len_read, blksz) * 1000, time));
 
 	env_set_hex("fileaddr", addr);
 	env_set_hex("filesize", len_read);
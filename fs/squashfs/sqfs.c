@@ -29,6 +29,37 @@
 static struct squashfs_ctxt ctxt;
 static int symlinknest;
 
+/* A decompressed fragment block */
+struct sqfs_frag_slot {
+	u64 start;		/* Position of the block in the volume */
+	void *buf;		/* Decompressed block, NULL if unused */
+	uint stamp;		/* For least-recently-used replacement */
+};
+
+/*
+ * Each operation probes the volume again, so the decompressed inode and
+ * directory tables, the last fragment table block and a few fragment blocks
+ * are kept here between operations, for as long as the device is unchanged.
+ *
+ * Directory streams borrow the tables, 'users' counts them. While the tables
+ * are borrowed, another volume is read without the cache.
+ */
+static struct {
+	bool valid;			/* Holds data of the volume below */
+	struct blk_desc *dev;
+	lbaint_t part_start;
+	u32 gen;			/* Generation of the device */
+	int users;
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	u32 *pos_list;
+	int metablks_count;
+	u64 frag_meta;			/* Position of 'frag_entries' */
+	struct squashfs_fragment_block_entry *frag_entries;
+	struct sqfs_frag_slot frag[CONFIG_SQUASHFS_FRAG_CACHE];
+	uint stamp;
+} sqfs_cache;
+
 static int sqfs_readdir_nest(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp);
 
 static int sqfs_disk_read(__u32 block, __u32 nr_blocks, void *buf)
@@ -98,6 +129,79 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
 }
 
+static void sqfs_cache_drop(void)
+{
+	int i;
+
+	free(sqfs_cache.inode_table);
+	free(sqfs_cache.dir_table);
+	free(sqfs_cache.pos_list);
+	free(sqfs_cache.frag_entries);
+	for (i = 0; i < ARRAY_SIZE(sqfs_cache.frag); i++)
+		free(sqfs_cache.frag[i].buf);
+	memset(&sqfs_cache, '\0', sizeof(sqfs_cache));
+}
+
+/*
+ * Check whether the cache can be used for the current volume, taking it over
+ * if it holds data of another one which is not in use.
+ */
+static bool sqfs_cache_use(void)
+{
+	if (!CONFIG_IS_ENABLED(BLK))
+		return false;
+
+	if (sqfs_cache.valid && sqfs_cache.dev == ctxt.cur_dev &&
+	    sqfs_cache.part_start == ctxt.cur_part_info.start &&
+	    sqfs_cache.gen == ctxt.cur_dev->gen)
+		return true;
+
+	if (sqfs_cache.users)
+		return false;
+
+	sqfs_cache_drop();
+	sqfs_cache.dev = ctxt.cur_dev;
+	sqfs_cache.part_start = ctxt.cur_part_info.start;
+	sqfs_cache.gen = ctxt.cur_dev->gen;
+	sqfs_cache.valid = true;
+
+	return true;
+}
+
+/* Return the cached fragment block at 'start', or NULL */
+static void *sqfs_frag_cache_find(u64 start)
+{
+	struct sqfs_frag_slot *slot;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sqfs_cache.frag); i++) {
+		slot = &sqfs_cache.frag[i];
+		if (slot->buf && slot->start == start) {
+			slot->stamp = ++sqfs_cache.stamp;
+			return slot->buf;
+		}
+	}
+
+	return NULL;
+}
+
+/* Keep the decompressed fragment block 'buf', which the cache then owns */
+static void sqfs_frag_cache_add(u64 start, void *buf)
+{
+	struct sqfs_frag_slot *slot, *victim = &sqfs_cache.frag[0];
+	int i;
+
+	for (i = 1; i < ARRAY_SIZE(sqfs_cache.frag); i++) {
+		slot = &sqfs_cache.frag[i];
+		if (victim->buf && (!slot->buf || slot->stamp < victim->stamp))
+			victim = slot;
+	}
+	free(victim->buf);
+	victim->start = start;
+	victim->buf = buf;
+	victim->stamp = ++sqfs_cache.stamp;
+}
+
 /*
  * Retrieves fragment block entry and returns true if the fragment block is
  * compressed
@@ -111,6 +215,7 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	unsigned long dest_len;
 	int block, offset, ret;
+	bool cache;
 	u16 header;
 
 	metadata_buffer = NULL;
@@ -154,6 +259,14 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	start_block = get_unaligned_le64(table + table_offset + block *
 					 sizeof(u64));
 
+	cache = sqfs_cache_use();
+	if (cache && sqfs_cache.frag_entries &&
+	    sqfs_cache.frag_meta == start_block) {
+		*e = sqfs_cache.frag_entries[offset];
+		ret = SQFS_COMPRESSED_BLOCK(e->size);
+		goto out;
+	}
+
 	start = start_block / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
 				  sblk->fragment_table_start, &table_offset);
@@ -200,6 +313,13 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	*e = entries[offset];
 	ret = SQFS_COMPRESSED_BLOCK(e->size);
 
+	if (cache) {
+		free(sqfs_cache.frag_entries);
+		sqfs_cache.frag_entries = entries;
+		sqfs_cache.frag_meta = start_block;
+		entries = NULL;
+	}
+
 out:
 	free(entries);
 	free(metadata_buffer);
@@ -905,9 +1025,67 @@ out:
 	return metablks_count;
 }
 
+/*
+ * Set up the inode and directory tables of 'dirs', from the cache if
+ * possible. Release them with sqfs_put_tables().
+ * Return the number of metadata blocks in the directory table, -ve on error
+ */
+static int sqfs_get_tables(struct squashfs_dir_stream *dirs, u32 **pos_list)
+{
+	unsigned char *inode_table, *dir_table;
+	int metablks_count, ret;
+	bool cache;
+
+	cache = sqfs_cache_use();
+	if (cache && sqfs_cache.inode_table) {
+		sqfs_cache.users++;
+		dirs->inode_table = sqfs_cache.inode_table;
+		dirs->dir_table = sqfs_cache.dir_table;
+		*pos_list = sqfs_cache.pos_list;
+
+		return sqfs_cache.metablks_count;
+	}
+
+	ret = sqfs_read_inode_table(&inode_table);
+	if (ret)
+		return -EINVAL;
+
+	metablks_count = sqfs_read_directory_table(&dir_table, pos_list);
+	if (metablks_count < 1) {
+		free(inode_table);
+		return -EINVAL;
+	}
+
+	dirs->inode_table = inode_table;
+	dirs->dir_table = dir_table;
+	if (!cache) {
+		dirs->own_tables = true;
+		return metablks_count;
+	}
+
+	sqfs_cache.inode_table = inode_table;
+	sqfs_cache.dir_table = dir_table;
+	sqfs_cache.pos_list = *pos_list;
+	sqfs_cache.metablks_count = metablks_count;
+	sqfs_cache.users++;
+
+	return metablks_count;
+}
+
+static void sqfs_put_tables(struct squashfs_dir_stream *dirs)
+{
+	if (dirs->own_tables) {
+		free(dirs->inode_table);
+		free(dirs->dir_table);
+	} else if (dirs->inode_table) {
+		sqfs_cache.users--;
+	}
+	dirs->inode_table = NULL;
+	dirs->dir_table = NULL;
+}
+
 static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
 	int j, token_count = 0, ret = 0, metablks_count;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
@@ -924,13 +1102,7 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
+	metablks_count = sqfs_get_tables(dirs, &pos_list);
 	if (metablks_count < 1) {
 		ret = -EINVAL;
 		goto out;
@@ -963,8 +1135,6 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	 * ldir's (extended directory) size is greater than dir, so it works as
 	 * a general solution for the malloc size, since 'i' is a union.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
 	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
 			      metablks_count);
 	if (ret)
@@ -990,10 +1160,11 @@ out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
+	if (dirs->own_tables)
+		free(pos_list);
 	free(path);
 	if (ret) {
-		free(inode_table);
+		sqfs_put_tables(dirs);
 		free(dirs);
 	}
 
@@ -1363,6 +1534,9 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 {
 	char *dir = NULL, *fragment_block, *datablock = NULL;
 	char *fragment = NULL, *file = NULL, *resolved, *data;
+	char *frag_buf = NULL, *batch = NULL;
+	u64 batch_start, batch_end;
+	u32 batch_size;
 	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
 	int ret, j, i_number, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
@@ -1498,32 +1672,60 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 			ret = -ENOMEM;
 			goto out;
 		}
+
+		/*
+		 * Data blocks are stored back to back, so read several of
+		 * them from the device at once
+		 */
+		batch_size = max_t(u32, SQFS_DATA_BATCH_SIZE,
+				   get_unaligned_le32(&sblk->block_size));
+		batch = malloc_cache_aligned(batch_size +
+					     2 * ctxt.cur_dev->blksz);
+		if (!batch) {
+			ret = -ENOMEM;
+			goto out;
+		}
 	}
 
+	batch_start = 0;
+	batch_end = 0;
 	for (j = 0; j < datablk_count; j++) {
-		char *data_buffer;
-
-		start = lldiv(data_offset, ctxt.cur_dev->blksz);
 		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
-		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
-		n_blks = DIV_ROUND_UP(table_size + table_offset,
-				      ctxt.cur_dev->blksz);
 
 		/* Don't load any data for sparse blocks */
 		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+			sparse_size = get_unaligned_le32(&sblk->block_size);
+			if ((*actread + sparse_size) > len)
+				sparse_size = len - *actread;
+			memset(buf + *actread, 0, sparse_size);
+			*actread += sparse_size;
+			if (*actread >= len)
+				break;
+			continue;
+		}
 
-			if (!data_buffer) {
-				ret = -ENOMEM;
-				goto out;
+		if (data_offset + table_size > batch_end) {
+			u64 needed = len - *actread;
+			int k;
+
+			/* Read this block and those following it, if needed */
+			batch_end = data_offset + table_size;
+			for (k = j + 1; k < datablk_count; k++) {
+				u32 size = SQFS_BLOCK_SIZE(finfo.blk_sizes[k]);
+
+				if (needed <= (u64)(k - j) *
+				    get_unaligned_le32(&sblk->block_size) ||
+				    batch_end + size - data_offset > batch_size)
+					break;
+				batch_end += size;
 			}
 
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
+			start = lldiv(data_offset, ctxt.cur_dev->blksz);
+			batch_start = start * ctxt.cur_dev->blksz;
+			n_blks = DIV_ROUND_UP(batch_end - batch_start,
+					      ctxt.cur_dev->blksz);
+
+			ret = sqfs_disk_read(start, n_blks, batch);
 			if (ret < 0) {
 				/*
 				 * Possible causes: too many data blocks or too large
@@ -1533,28 +1735,27 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 				printf("Error: too many data blocks to be read.\n");
 				goto out;
 			}
-
-			data = data_buffer + table_offset;
 		}
 
+		data = batch + (data_offset - batch_start);
+
 		/* Load the data */
-		if (finfo.blk_sizes[j] == 0) {
-			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
+		if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
+			char *dest = datablock;
+
+			/* Decompress whole blocks straight into the file */
 			dest_len = get_unaligned_le32(&sblk->block_size);
-			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
+			if (*actread + dest_len <= len)
+				dest = buf + *actread;
+			ret = sqfs_decompress(&ctxt, dest, &dest_len,
 					      data, table_size);
 			if (ret)
 				goto out;
 
 			if ((*actread + dest_len) > len)
 				dest_len = len - *actread;
-			memcpy(buf + *actread, datablock, dest_len);
+			if (dest == datablock)
+				memcpy(buf + *actread, datablock, dest_len);
 			*actread += dest_len;
 		} else {
 			if ((*actread + table_size) > len)
@@ -1563,8 +1764,7 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 			*actread += table_size;
 		}
 
-		data_offset += table_size;
-		free(data_buffer);
+		data_offset += SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
 		if (*actread >= len)
 			break;
 	}
@@ -1577,55 +1777,67 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
+	/* Compressed fragment blocks are usually shared by several files */
+	fragment_block = NULL;
+	if (finfo.comp && sqfs_cache_use())
+		fragment_block = sqfs_frag_cache_find(frag_entry.start);
 
-	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size))
-		return -EINVAL;
+	if (!fragment_block) {
+		start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
+		table_size = SQFS_BLOCK_SIZE(frag_entry.size);
+		table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
+		n_blks = DIV_ROUND_UP(table_size + table_offset,
+				      ctxt.cur_dev->blksz);
 
-	fragment = malloc_cache_aligned(buf_size);
+		if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz,
+					   &buf_size)) {
+			ret = -EINVAL;
+			goto out;
+		}
 
-	if (!fragment) {
-		ret = -ENOMEM;
-		goto out;
-	}
+		fragment = malloc_cache_aligned(buf_size);
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
-		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
+		if (!fragment) {
 			ret = -ENOMEM;
 			goto out;
 		}
 
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
+		ret = sqfs_disk_read(start, n_blks, fragment);
+		if (ret < 0)
 			goto out;
-		}
 
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
+		if (finfo.comp) {
+			/* File compressed and fragmented */
+			dest_len = get_unaligned_le32(&sblk->block_size);
+			frag_buf = malloc(dest_len);
+			if (!frag_buf) {
+				ret = -ENOMEM;
+				goto out;
+			}
 
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
+			ret = sqfs_decompress(&ctxt, frag_buf, &dest_len,
+					      (void *)fragment + table_offset,
+					      frag_entry.size);
+			if (ret)
+				goto out;
 
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
+			fragment_block = frag_buf;
+			if (sqfs_cache_use()) {
+				sqfs_frag_cache_add(frag_entry.start, frag_buf);
+				frag_buf = NULL;
+			}
+		} else {
+			fragment_block = (void *)fragment + table_offset;
+		}
 	}
 
+	memcpy(buf + *actread, &fragment_block[finfo.offset],
+	       finfo.size - *actread);
+	*actread = finfo.size;
+
 out:
+	free(frag_buf);
+	free(batch);
 	free(fragment);
 	free(datablock);
 	free(file);
@@ -1680,6 +1892,7 @@ static int sqfs_size_nest(const char *filename, loff_t *size)
 
 	if (ret) {
 		printf("File not found.\n");
+		fs_dcache_add(filename, NULL, 0);
 		*size = 0;
 		ret = -EINVAL;
 		goto free_strings;
@@ -1776,6 +1989,8 @@ int sqfs_exists(const char *filename)
 	}
 
 	sqfs_closedir(dirsp);
+	if (ret)
+		fs_dcache_add(filename, NULL, 0);
 
 free_strings:
 	free(dir);
@@ -1806,8 +2021,7 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_put_tables(sqfs_dirs);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
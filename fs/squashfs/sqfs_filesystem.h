@@ -18,6 +18,8 @@
 #define SQFS_DIR_INDEX_BASE_LENGTH 12
 /* size of metadata (inode and directory) blocks */
 #define SQFS_METADATA_BLOCK_SIZE 8192
+/* Data blocks are read from the device in batches of up to 1MiB */
+#define SQFS_DATA_BATCH_SIZE (1024 * 1024)
 /* Max. number of fragment entries in a metadata block is 512 */
 #define SQFS_MAX_ENTRIES 512
 /* Metadata blocks start by a 2-byte length header */
@@ -272,10 +274,12 @@ struct squashfs_dir_stream {
 	struct squashfs_ldir_inode i_ldir;
 	/*
 	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * sqfs_opendir() and released in sqfs_closedir(). Unless 'own_tables'
+	 * is set, they are borrowed from the table cache.
 	 */
 	unsigned char *inode_table;
 	unsigned char *dir_table;
+	bool own_tables;
 };
 
 struct squashfs_file_info {
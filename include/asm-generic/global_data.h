@@ -242,6 +242,22 @@ struct global_data {
 	 * @uclass_root_s.
 	 */
 	struct list_head *uclass_root;
+# if CONFIG_IS_ENABLED(DM_UCLASS_TABLE)
+	/**
+	 * @uclass_tbl: table of uclasses indexed by uclass ID
+	 *
+	 * This has UCLASS_COUNT entries, each NULL if the uclass does not
+	 * exist yet
+	 */
+	struct uclass **uclass_tbl;
+# endif
+# if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/**
+	 * @dm_compat_idx: index of driver compatible strings, used when
+	 * binding devices. This is built once the full heap is available
+	 */
+	struct dm_compat_idx *dm_compat_idx;
+# endif
 # if CONFIG_IS_ENABLED(OF_PLATDATA_DRIVER_RT)
 	/** @dm_driver_rt: Dynamic info about the driver */
 	struct driver_rt *dm_driver_rt;
@@ -269,6 +285,18 @@ struct global_data {
 	 */
 	struct device_node *of_root;
 #endif
+#if CONFIG_IS_ENABLED(OF_DTB_INDEX)
+	/**
+	 * @dtb_index_fdt: devicetree for which @dtb_index_node was found, or
+	 * NULL if none
+	 */
+	const void *dtb_index_fdt;
+	/**
+	 * @dtb_index_node: offset of the index node in @dtb_index_fdt, or -ve
+	 * if it has none
+	 */
+	int dtb_index_node;
+#endif
 #if CONFIG_IS_ENABLED(MULTI_DTB_FIT)
 	/**
 	 * @multi_dtb_fit: pointer to uncompressed multi-dtb FIT image
@@ -483,6 +511,22 @@ static_assert(sizeof(struct global_data) == GD_SIZE);
 #define gd_dm_driver_rt()		NULL
 #endif
 
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+#define gd_dm_compat_idx()		gd->dm_compat_idx
+#define gd_set_dm_compat_idx(_idx)	gd->dm_compat_idx = (_idx)
+#else
+#define gd_dm_compat_idx()		((struct dm_compat_idx *)NULL)
+#define gd_set_dm_compat_idx(_idx)
+#endif
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_TABLE)
+#define gd_uclass_tbl()			gd->uclass_tbl
+#define gd_set_uclass_tbl(_tbl)		gd->uclass_tbl = (_tbl)
+#else
+#define gd_uclass_tbl()			((struct uclass **)NULL)
+#define gd_set_uclass_tbl(_tbl)
+#endif
+
 #if CONFIG_IS_ENABLED(OF_PLATDATA_RT)
 #define gd_set_dm_udevice_rt(dyn)	gd->dm_udevice_rt = dyn
 #define gd_dm_udevice_rt()		gd->dm_udevice_rt
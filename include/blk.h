@@ -48,6 +48,54 @@ enum sig_type {
 	SIG_TYPE_COUNT			/* Number of signature types */
 };
 
+/* Number of buckets in the latency and size histograms of struct blk_stats */
+#define BLK_STATS_BUCKETS	20
+
+/* Operations counted separately by struct blk_stats */
+enum blk_stats_op {
+	BLK_STATS_READ,
+	BLK_STATS_WRITE,
+	BLK_STATS_ERASE,
+
+	BLK_STATS_OPS,			/* Number of operations */
+};
+
+/**
+ * struct blk_op_stats - statistics for one type of operation on a device
+ *
+ * Only transfers which reach the driver are counted. Bucket i of the
+ * histograms counts values from 2^(i - 1) up to 2^i - 1, with bucket 0 for
+ * zero and the last bucket taking everything larger.
+ *
+ * @reqs:	Number of requests
+ * @errors:	Number of requests which failed or were short
+ * @blocks:	Number of blocks transferred
+ * @time_us:	Total time taken by the requests in microseconds
+ * @max_us:	Time taken by the slowest request in microseconds
+ * @lat_hist:	Histogram of request times in microseconds
+ * @size_hist:	Histogram of request sizes in blocks
+ */
+struct blk_op_stats {
+	u32 reqs;
+	u32 errors;
+	u64 blocks;
+	u64 time_us;
+	u32 max_us;
+	u32 lat_hist[BLK_STATS_BUCKETS];
+	u32 size_hist[BLK_STATS_BUCKETS];
+};
+
+/**
+ * struct blk_stats - I/O statistics of a block device
+ *
+ * @op:		Statistics for each enum blk_stats_op
+ * @cache_hits:	Number of reads served by the block cache without a transfer
+ */
+struct blk_stats {
+	struct blk_op_stats op[BLK_STATS_OPS];
+	u32 cache_hits;
+};
+
 /*
  * With driver model (CONFIG_BLK) this is uclass platform data, accessible
  * with dev_get_uclass_plat(dev)
@@ -80,6 +128,13 @@ struct blk_desc {
 		uint32_t mbr_sig;	/* MBR integer signature */
 		efi_guid_t guid_sig;	/* GPT GUID Signature */
 	};
+	/*
+	 * Generation number, changed by blk_changed() whenever the contents
+	 * of the device may have changed. Filesystems use it to tell whether
+	 * what they cached about the device is still valid. Only maintained
+	 * with CONFIG_BLK.
+	 */
+	u32		gen;
 #if CONFIG_IS_ENABLED(BLK)
 	/*
 	 * For now we have a few functions which take struct blk_desc as a
@@ -87,6 +142,9 @@ struct blk_desc {
 	 * device. Once these functions are removed we can drop this field.
 	 */
 	struct udevice *bdev;
+#if IS_ENABLED(CONFIG_BLK_STATS)
+	struct blk_stats stats;		/* I/O statistics, see blk_stats_reset() */
+#endif
 #else
 	unsigned long	(*block_read)(struct blk_desc *block_dev,
 				      lbaint_t start,
@@ -107,6 +165,19 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/**
+ * typedef blkcache_write_t - write blocks to a device for blkcache_flush()
+ *
+ * @param priv - private data passed to blkcache_flush()
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param buffer - data to write, aligned for DMA
+ *
+ * Return: 0 if OK, -ve on error
+ */
+typedef int (*blkcache_write_t)(void *priv, lbaint_t start, lbaint_t blkcnt,
+				const void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
@@ -140,6 +211,112 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_write() - pass data written to a block device to the cache
+ *
+ * In write-back mode, small writes are kept in the cache as dirty blocks and
+ * written to the device later by blkcache_flush(). Otherwise any cached
+ * copies of the blocks are discarded and the caller must write the data.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param blksz - size in bytes of each block
+ * @param buffer - buffer containing the data to write
+ *
+ * Return: 1 if the cache holds the data, 0 if the caller must write it to
+ * the device, -ENOSPC if too much dirty data is held and the device should
+ * be flushed before trying again
+ */
+int blkcache_write(int iftype, int dev,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer);
+
+/**
+ * blkcache_discard() - drop cached blocks, including dirty ones
+ *
+ * This is used when a range of blocks is overwritten or erased on the
+ * device, so that the cache holds nothing stale.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks
+ */
+void blkcache_discard(int iftype, int dev, lbaint_t start, lbaint_t blkcnt);
+
+/**
+ * blkcache_dirty() - check whether any dirty block may be in a range
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks
+ *
+ * Return: true if the device must be flushed before reading the range from
+ * it, false if not
+ */
+bool blkcache_dirty(int iftype, int dev, lbaint_t start, lbaint_t blkcnt);
+
+/**
+ * blkcache_flush() - write the dirty blocks of a device back
+ *
+ * Dirty blocks are sorted and runs of adjacent blocks are written with a
+ * single call to @write.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param write - function to write blocks to the device
+ * @param priv - private data for @write
+ *
+ * Return: 0 if OK, -ve on error, in which case blocks not yet written stay
+ * dirty
+ */
+int blkcache_flush(int iftype, int dev, blkcache_write_t write, void *priv);
+
+/**
+ * blkcache_set_writeback() - enable or disable write-back mode
+ *
+ * Disabling write-back does not write dirty blocks; use blkcache_flush() for
+ * that.
+ *
+ * @param enable - true to hold small writes in the cache
+ */
+void blkcache_set_writeback(bool enable);
+
+/**
+ * blkcache_hold_writes() - allow writes to be held in the cache, or not
+ *
+ * In write-back mode, only writes made while this is enabled are held. The
+ * filesystem layer enables it around its own writes and flushes afterwards,
+ * so that raw writes, e.g. from saveenv or 'mmc write', always go straight
+ * to the device.
+ *
+ * @param hold - true to hold writes, false to write them through
+ */
+void blkcache_hold_writes(bool hold);
+
+/**
+ * blkcache_readahead() - check whether a read should be followed by read-ahead
+ *
+ * This is called after a successful read from the device. If the read
+ * continues a sequential stream, the cache records a pending read-ahead and
+ * returns its size. The caller should then read that many blocks, starting
+ * at @start + @blkcnt, so they end up in the cache via blkcache_fill().
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number of the read just done
+ * @param blkcnt - number of blocks read
+ * @param blksz - size in bytes of each block
+ *
+ * Return: number of blocks to read ahead, 0 for none
+ */
+lbaint_t blkcache_readahead(int iftype, int dev,
+			    lbaint_t start, lbaint_t blkcnt,
+			    unsigned long blksz);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -152,10 +329,11 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * @param blocks - maximum blocks per read which is cached
+ * @param size_mb - total size of the cache in MiB, 0 to disable it
+ * @param readahead - number of blocks to read ahead, 0 to disable
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned blocks, unsigned size_mb, unsigned readahead);
 
 /*
  * statistics of the block cache
@@ -163,9 +341,19 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
-	unsigned entries; /* current entry count */
+	unsigned entries; /* current number of cached blocks */
 	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned size_mb;
+	unsigned readahead; /* read-ahead window in blocks */
+	unsigned long bytes; /* bytes currently cached */
+	u64 bytes_served; /* bytes returned from the cache */
+	unsigned ra_blocks; /* blocks read ahead */
+	unsigned ra_hits; /* read-ahead blocks which were then used */
+	bool writeback; /* write-back mode enabled */
+	unsigned dirty; /* current number of dirty blocks */
+	unsigned wb_writes; /* writes held in the cache */
+	unsigned flush_writes; /* device writes issued by flushing */
+	unsigned flush_blocks; /* blocks written by flushing */
 };
 
 /**
@@ -191,6 +379,37 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline int blkcache_write(int iftype, int dev,
+				 lbaint_t start, lbaint_t blkcnt,
+				 unsigned long blksz, const void *buffer)
+{
+	return 0;
+}
+
+static inline void blkcache_discard(int iftype, int dev, lbaint_t start,
+				    lbaint_t blkcnt) {}
+
+static inline bool blkcache_dirty(int iftype, int dev, lbaint_t start,
+				  lbaint_t blkcnt)
+{
+	return false;
+}
+
+static inline int blkcache_flush(int iftype, int dev, blkcache_write_t write,
+				 void *priv)
+{
+	return 0;
+}
+
+static inline lbaint_t blkcache_readahead(int iftype, int dev,
+					  lbaint_t start, lbaint_t blkcnt,
+					  unsigned long blksz)
+{
+	return 0;
+}
+
+static inline void blkcache_hold_writes(bool hold) {}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 static inline void blkcache_free(void) {}
@@ -199,6 +418,36 @@ static inline void blkcache_free(void) {}
 
 struct udevice;
 
+/**
+ * struct blk_req - a block-device transfer which may complete later
+ *
+ * Requests are started with blk_submit() and are complete once @done is set,
+ * which happens in blk_poll() or blk_wait(). The request and its buffer must
+ * stay valid until then, and the blocks it covers must not be accessed in
+ * other ways meanwhile.
+ *
+ * @write:	true to write to the device, false to read from it
+ * @start:	Start block number
+ * @blkcnt:	Number of blocks
+ * @buffer:	Data buffer
+ * @done:	Set when the transfer is complete
+ * @ret:	Once complete, number of blocks transferred or -ve error
+ * @async:	For the uclass: the request was passed to the driver's submit()
+ * @start_us:	For the uclass: time the request was submitted
+ * @priv:	For the driver: state of the request
+ */
+struct blk_req {
+	bool write;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool done;
+	long ret;
+	bool async;
+	ulong start_us;
+	void *priv;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -275,6 +524,32 @@ struct blk_ops {
 	 */
 	int (*buffer_aligned)(struct udevice *dev, struct bounce_buffer *state);
 #endif	/* CONFIG_BOUNCE_BUFFER */
+
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+	/**
+	 * submit() - start a transfer without waiting for it to complete
+	 *
+	 * This is optional. Without it, requests are carried out by read()
+	 * and write() when they are submitted.
+	 *
+	 * @dev:	Block device to access
+	 * @req:	Request to start; the driver sets req->done and req->ret
+	 *		once the transfer is complete, from poll() or submit()
+	 * @return 0 if OK, -EBUSY if no more requests can be queued for now,
+	 * other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - complete any submitted transfers which have finished
+	 *
+	 * Required if submit() is provided.
+	 *
+	 * @dev:	Block device to check
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
+#endif
 };
 
 #if CONFIG_IS_ENABLED(BLK)
@@ -291,6 +566,26 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt, const void *buffer);
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
+int blk_dflush(struct blk_desc *desc);
+
+/**
+ * blk_changed() - note that the contents of a block device may have changed
+ *
+ * This gives the device a new generation number, one which no block device
+ * has had before, so that any state cached for the old contents is seen to
+ * be stale. It is called for writes, erases, hardware-partition switches and
+ * when the media is (re)initialised.
+ *
+ * @desc: Block device descriptor
+ */
+void blk_changed(struct blk_desc *desc);
+
+/**
+ * blk_stats_reset() - Clear the I/O statistics of a block device
+ *
+ * @desc: Block device descriptor
+ */
+void blk_stats_reset(struct blk_desc *desc);
 
 #endif /* BLK */
 
@@ -331,6 +626,58 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
  */
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 
+/**
+ * blk_submit() - Start a transfer to or from a block device
+ *
+ * The transfer completes in the background on devices which support it, so
+ * that the caller can do other work meanwhile. On other devices, and for
+ * reads satisfied by the block cache, it completes before this returns.
+ * Either way, the caller must call blk_poll() until it returns 0, or
+ * blk_wait(), before using the data or reusing @req.
+ *
+ * @dev: Device to access
+ * @req: Request, with @write, @start, @blkcnt and @buffer set up
+ * Return: 0 if OK, -ve on error, in which case the request was not started
+ */
+int blk_submit(struct udevice *dev, struct blk_req *req);
+
+/**
+ * blk_poll() - Check whether a submitted transfer has completed
+ *
+ * @dev: Device the request was submitted to
+ * @req: Request to check
+ * Return: 0 if complete, -EINPROGRESS if not yet, other -ve on error
+ */
+int blk_poll(struct udevice *dev, struct blk_req *req);
+
+/**
+ * blk_wait() - Wait for a submitted transfer to complete
+ *
+ * @dev: Device the request was submitted to
+ * @req: Request to wait for
+ * Return: number of blocks transferred (which may be less than @blkcnt),
+ * or -ve on error
+ */
+long blk_wait(struct udevice *dev, struct blk_req *req);
+
+/**
+ * blk_flush() - Write back data held in the block cache for a device
+ *
+ * With the block cache in write-back mode, writes may be held in memory.
+ * This writes them to the device.
+ *
+ * @dev: Device to flush
+ * Return: 0 if OK, -ve on error
+ */
+int blk_flush(struct udevice *dev);
+
+/**
+ * blk_flush_all() - Write back data held in the block cache for all devices
+ *
+ * Return: 0 if OK, -ve on error (all devices are flushed regardless)
+ */
+int blk_flush_all(void);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -559,6 +906,15 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
+static inline int blk_dflush(struct blk_desc *block_dev)
+{
+	return 0;
+}
+
+static inline void blk_changed(struct blk_desc *block_dev)
+{
+}
+
 /**
  * struct blk_driver - Driver for block interface types
  *
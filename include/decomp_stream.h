@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Streaming decompression
+ */
+
+#ifndef __DECOMP_STREAM_H
+#define __DECOMP_STREAM_H
+
+#include <linux/types.h>
+
+struct decomp_stream;
+
+/**
+ * struct decomp_stream_ops - operations for one compression type
+ *
+ * Normally the output window of the stream is the whole destination buffer,
+ * so decompressors can refer back to earlier output instead of keeping
+ * their own copy of it. In window mode (see decomp_stream_init_window()) the
+ * buffer is reused, so decompressors which support it keep their own
+ * history.
+ *
+ * @window: true if window mode is supported
+ */
+struct decomp_stream_ops {
+	bool window;
+
+	/**
+	 * init() - set up the decompressor, e.g. allocate ds->priv
+	 *
+	 * @ds: Stream to set up
+	 * Return: 0 if OK, -ENOMEM if out of memory
+	 */
+	int (*init)(struct decomp_stream *ds);
+
+	/**
+	 * feed() - decompress the next part of the input
+	 *
+	 * All of @len bytes must be consumed, buffering any which cannot be
+	 * used yet. Output is written at ds->out + ds->out_len and ds->done
+	 * is set once the end of the compressed data is found.
+	 *
+	 * In window mode, this stops once ds->out is full instead, setting
+	 * ds->in_used to the number of bytes of @in used. Any output which
+	 * is ready but does not fit must be held until the next call, which
+	 * may have no input.
+	 *
+	 * @ds: Stream
+	 * @in: Compressed data
+	 * @len: Number of bytes at @in
+	 * Return: 0 if OK, -ENOSPC if the output does not fit, other -ve on
+	 *	error
+	 */
+	int (*feed)(struct decomp_stream *ds, const void *in, ulong len);
+
+	/**
+	 * free() - release the resources of the decompressor
+	 *
+	 * @ds: Stream
+	 */
+	void (*free)(struct decomp_stream *ds);
+};
+
+/**
+ * struct decomp_stream - a decompression in progress
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @out:	Destination buffer
+ * @out_size:	Size of destination buffer
+ * @out_len:	Number of bytes decompressed so far, in window mode into the
+ *		current buffer
+ * @in_len:	Number of bytes of input used so far
+ * @in_used:	Window mode: number of bytes used by the last feed()
+ * @done:	true once the end of the compressed data has been reached
+ * @window:	true in window mode, see decomp_stream_init_window()
+ * @ops:	Operations for @comp
+ * @priv:	Private data of the decompressor
+ */
+struct decomp_stream {
+	int comp;
+	u8 *out;
+	ulong out_size;
+	ulong out_len;
+	ulong in_len;
+	ulong in_used;
+	bool done;
+	bool window;
+	const struct decomp_stream_ops *ops;
+	void *priv;
+};
+
+extern const struct decomp_stream_ops gzip_stream_ops;
+extern const struct decomp_stream_ops lz4_stream_ops;
+extern const struct decomp_stream_ops lzma_stream_ops;
+extern const struct decomp_stream_ops zstd_stream_ops;
+
+/**
+ * decomp_stream_supported() - Check whether a compression type can stream
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * Return: true if decomp_stream_init() supports @comp
+ */
+bool decomp_stream_supported(int comp);
+
+/**
+ * decomp_stream_init() - Start decompressing data which arrives in pieces
+ *
+ * The compressed data is passed in with decomp_stream_feed(), in pieces of
+ * any size, so it need not all be in memory at once.
+ *
+ * @ds: Stream to set up
+ * @comp: Compression type (IH_COMP_...)
+ * @out: Destination buffer
+ * @out_size: Size of destination buffer
+ * Return: 0 if OK, -EPROTONOSUPPORT if @comp cannot be streamed, -ENOMEM if
+ *	out of memory
+ */
+int decomp_stream_init(struct decomp_stream *ds, int comp, void *out,
+		       ulong out_size);
+
+/**
+ * decomp_stream_feed() - Decompress the next part of the data
+ *
+ * Data after the end of the compressed stream is ignored.
+ *
+ * @ds: Stream
+ * @in: Next part of the compressed data
+ * @len: Number of bytes at @in
+ * Return: 0 if OK, -ENOSPC if the destination buffer is too small, other -ve
+ *	if the data is corrupt
+ */
+int decomp_stream_feed(struct decomp_stream *ds, const void *in, ulong len);
+
+/**
+ * decomp_stream_init_window() - Start decompressing into a reused buffer
+ *
+ * The output is written with decomp_stream_fill(), one buffer at a time.
+ * The caller is done with each buffer before the next call, so the buffer
+ * may be reused and the output may be far larger than memory. This is
+ * supported for gzip, lz4 and Zstandard, whose decompressors then keep
+ * their own history.
+ *
+ * @ds: Stream to set up
+ * @comp: Compression type (IH_COMP_...)
+ * Return: 0 if OK, -EPROTONOSUPPORT if @comp cannot be streamed in this way,
+ *	-ENOMEM if out of memory
+ */
+int decomp_stream_init_window(struct decomp_stream *ds, int comp);
+
+/**
+ * decomp_stream_window_supported() - Check for window mode
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * Return: true if decomp_stream_init_window() supports @comp
+ */
+bool decomp_stream_window_supported(int comp);
+
+/**
+ * decomp_stream_fill() - Decompress into a buffer until it is full
+ *
+ * Output from earlier calls is not kept. On return ds->out_len is the
+ * number of bytes written to @out. This is less than @size only if all of
+ * @in was used or the end of the compressed data was reached (ds->done).
+ * Pass the input which was not used to the next call.
+ *
+ * @ds: Stream set up by decomp_stream_init_window()
+ * @in: Next part of the compressed data
+ * @len: Number of bytes at @in, which may be 0 to collect held output
+ * @out: Buffer to write to
+ * @size: Size of @out
+ * Return: number of bytes of @in used, or -ve if the data is corrupt
+ */
+long decomp_stream_fill(struct decomp_stream *ds, const void *in, ulong len,
+			void *out, ulong size);
+
+/**
+ * decomp_stream_finish() - Finish decompressing and release resources
+ *
+ * This must be called once for every successful decomp_stream_init() or
+ * decomp_stream_init_window(), even after an error.
+ *
+ * @ds: Stream
+ * Return: number of bytes decompressed (0 in window mode), or -EBADMSG if
+ *	the compressed data was incomplete
+ */
+long decomp_stream_finish(struct decomp_stream *ds);
+
+#endif
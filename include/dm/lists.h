@@ -23,6 +23,20 @@
  */
 struct driver *lists_driver_lookup_name(const char *name);
 
+/**
+ * lists_driver_lookup_compat() - Find the driver for a compatible string
+ *
+ * This returns the first driver in the linker list with a matching of_match
+ * entry, which is the one that lists_bind_fdt() binds. With DM_COMPAT_INDEX
+ * this uses an index of all the strings once the full heap is available.
+ *
+ * @compat: Compatible string to look up
+ * @idp: Returns the matching of_match entry, or NULL if not found
+ * Return: pointer to driver, or NULL if not found
+ */
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp);
+
 /**
  * lists_uclass_lookup() - Return uclass_driver based on ID of the class
  *
@@ -385,6 +385,50 @@ static inline oftree oftree_from_np(struct device_node *root)
  */
 void oftree_dispose(oftree tree);
 
+/**
+ * struct ofnode_cache_stats - counters for the flat-tree lookup cache
+ *
+ * @phandle_hits: Phandle lookups answered from the cache
+ * @phandle_misses: Phandle lookups which had to search the tree
+ * @path_hits: Path and alias lookups answered from the cache
+ * @path_misses: Path and alias lookups which had to search the tree
+ * @flushes: Number of times a cache was emptied because its tree changed
+ */
+struct ofnode_cache_stats {
+	uint phandle_hits;
+	uint phandle_misses;
+	uint path_hits;
+	uint path_misses;
+	uint flushes;
+};
+
+#if CONFIG_IS_ENABLED(OFNODE_CACHE)
+/**
+ * ofnode_cache_flush() - Drop cached lookups for a flat tree
+ *
+ * This must be called before changing a flat tree in a way which moves its
+ * nodes, unless the change goes through the ofnode interface, which does it
+ * automatically.
+ *
+ * @fdt: Devicetree which is changing, or NULL for all trees
+ */
+void ofnode_cache_flush(const void *fdt);
+
+/**
+ * ofnode_get_cache_stats() - Get the counters for the flat-tree lookup cache
+ *
+ * @stats: Returns the counters, for all trees since U-Boot started
+ */
+void ofnode_get_cache_stats(struct ofnode_cache_stats *stats);
+#else
+static inline void ofnode_cache_flush(const void *fdt) {}
+
+static inline void ofnode_get_cache_stats(struct ofnode_cache_stats *stats)
+{
+	memset(stats, '\0', sizeof(*stats));
+}
+#endif
+
 /**
  * ofnode_name_eq() - Check a node name ignoring its unit address
  *
@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Index of the control devicetree, added at build time
+ *
+ * The build can add a node to the devicetree which holds the offsets of the
+ * nodes that are looked up most, so that they can be found without searching
+ * the whole flat tree. Offsets are from the start of the structure block and
+ * only hold while the structure block keeps the size it was built with.
+ *
+ * The node has these properties, all cells being big-endian u32:
+ *
+ * struct-size:		size of the structure block the offsets are for
+ * phandles:		offset of the node with each phandle, indexed by
+ *			phandle, or -1 if there is none. This may be missing
+ *			if the phandles are too sparse
+ * alias-names:		string list of the properties in /aliases
+ * aliases:		offset of the node for each of alias-names, or -1
+ * compat-strings:	string list of the compatible strings of all nodes
+ * compat-nodes:	for each of compat-strings, the number of nodes which
+ *			have it followed by their offsets, in increasing order
+ */
+
+#ifndef __DTB_INDEX_H
+#define __DTB_INDEX_H
+
+#define DTB_INDEX_NODE		"__dtb_index__"
+#define DTB_INDEX_STRUCT_SIZE	"struct-size"
+#define DTB_INDEX_PHANDLES	"phandles"
+#define DTB_INDEX_ALIAS_NAMES	"alias-names"
+#define DTB_INDEX_ALIASES	"aliases"
+#define DTB_INDEX_COMPAT_STRINGS "compat-strings"
+#define DTB_INDEX_COMPAT_NODES	"compat-nodes"
+
+#ifndef USE_HOSTCC
+#include <linux/types.h>
+
+#if CONFIG_IS_ENABLED(OF_DTB_INDEX)
+/**
+ * dtb_index_phandle() - Find a node by phandle using the index
+ *
+ * This checks that the node still has the phandle, and leaves phandles which
+ * are not in the index to libfdt.
+ *
+ * @fdt: Devicetree to search, which must be the control devicetree
+ * @phandle: Phandle to look for
+ * @offsetp: Returns the node offset
+ * Return: true if the index was used, false to search the tree instead
+ */
+bool dtb_index_phandle(const void *fdt, uint phandle, int *offsetp);
+
+/**
+ * dtb_index_alias() - Find the node for an alias using the index
+ *
+ * This checks that the alias still ends with the name of the node, and leaves
+ * aliases which are not in the index, or whose node is missing, to libfdt.
+ *
+ * @fdt: Devicetree to search, which must be the control devicetree
+ * @name: Alias name, without any '/' or ':'
+ * @offsetp: Returns the node offset
+ * Return: true if the index was used, false to search the tree instead
+ */
+bool dtb_index_alias(const void *fdt, const char *name, int *offsetp);
+
+/**
+ * dtb_index_compatible() - Find the next compatible node using the index
+ *
+ * This does the same as fdt_node_offset_by_compatible(). It checks that the
+ * node found still has the compatible string.
+ *
+ * @fdt: Devicetree to search, which must be the control devicetree
+ * @startoffset: Only find nodes after this one, or -1 for all nodes
+ * @compat: Compatible string to look for
+ * @offsetp: Returns the node offset, or -FDT_ERR_NOTFOUND if there is none
+ * Return: true if the index was used, false to search the tree instead
+ */
+bool dtb_index_compatible(const void *fdt, int startoffset, const char *compat,
+			  int *offsetp);
+#else
+static inline bool dtb_index_phandle(const void *fdt, uint phandle,
+				     int *offsetp)
+{
+	return false;
+}
+
+static inline bool dtb_index_alias(const void *fdt, const char *name,
+				   int *offsetp)
+{
+	return false;
+}
+
+static inline bool dtb_index_compatible(const void *fdt, int startoffset,
+					const char *compat, int *offsetp)
+{
+	return false;
+}
+#endif
+
+#endif /* USE_HOSTCC */
+
+#endif
@@ -26,6 +26,7 @@ struct disk_partition;
 			 sizeof(dir_entry))
 
 #define FATBUFBLOCKS	6
+#define FATBUFWINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -155,6 +156,15 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/*
+ * Window of FATBUFBLOCKS sectors of the FAT held in fsdata.fatbuf
+ */
+struct fat_win {
+	int	num;		/* Window number in the FAT, -1 if unused */
+	__u8	dirty;		/* Set if the window has been modified */
+	__u32	stamp;		/* Time of last use, for LRU replacement */
+};
+
 /*
  * Private filesystem parameters
  *
@@ -162,16 +172,18 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT cache, FATBUFWINDOWS windows */
+	struct fat_win fatwin[FATBUFWINDOWS];
+	__u32	fatstamp;	/* Clock for fatwin[].stamp */
+	int	fatwinlast;	/* Index of the last window used */
+	__u32	mount_id;	/* Changes each time the volume is mounted */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
@@ -191,6 +203,27 @@ static inline u32 sect_to_clust(fsdata *fsdata, int sect)
 	return (sect - fsdata->data_begin) / fsdata->clust_size;
 }
 
+/**
+ * struct fat_mount_stats - statistics of the FAT mount cache
+ *
+ * @hits:	operations which reused the mounted volume
+ * @misses:	operations which had to read the boot sector
+ */
+struct fat_mount_stats {
+	unsigned int hits;
+	unsigned int misses;
+};
+
+/**
+ * fat_get_mount_stats() - get statistics of the FAT mount cache
+ *
+ * The mount cache keeps the parameters and FAT sectors of the volume used
+ * last, as long as the block device has not changed since.
+ *
+ * @stats:	returns the statistics
+ */
+void fat_get_mount_stats(struct fat_mount_stats *stats);
+
 int file_fat_detectfs(void);
 int fat_exists(const char *filename);
 int fat_size(const char *filename, loff_t *size);
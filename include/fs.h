@@ -5,6 +5,7 @@
 #ifndef _FS_H
 #define _FS_H
 
+#include <errno.h>
 #include <rtc.h>
 
 struct cmd_tbl;
@@ -120,6 +121,47 @@ const char *fs_get_type_name(void);
  */
 int fs_ls(const char *dirname);
 
+#define FS_DCACHE_DATA_MAX	32
+
+#if CONFIG_IS_ENABLED(FS_DCACHE)
+/**
+ * fs_dcache_lookup() - look up a path in the directory entry cache
+ *
+ * Filesystems call this to avoid resolving again a path on the current
+ * partition that they have resolved before. Entries are only returned while
+ * the block device is unchanged (see blk_changed()).
+ *
+ * @path:	path of the file or directory
+ * @data:	returns the data stored by fs_dcache_add(), may be NULL
+ * @size:	size of @data; the entry must hold exactly this much data
+ * Return: 0 if found, -ENOENT if the path is known not to exist, -ENODATA if
+ * the path is not in the cache
+ */
+int fs_dcache_lookup(const char *path, void *data, int size);
+
+/**
+ * fs_dcache_add() - add a path to the directory entry cache
+ *
+ * Filesystems call this after resolving @path on the current partition, to
+ * record whatever they need to find it again quickly (such as an inode
+ * number), or that it does not exist.
+ *
+ * @path:	path of the file or directory
+ * @data:	data to store, or NULL to record that @path does not exist
+ * @size:	size of @data, at most FS_DCACHE_DATA_MAX bytes
+ */
+void fs_dcache_add(const char *path, const void *data, int size);
+#else
+static inline int fs_dcache_lookup(const char *path, void *data, int size)
+{
+	return -ENODATA;
+}
+
+static inline void fs_dcache_add(const char *path, const void *data, int size)
+{
+}
+#endif
+
 /*
  * Determine whether a file exists
  *
@@ -11,6 +11,7 @@
 #endif
 
 struct cmd_tbl;
+struct image_region;
 
 /*
  * Maximum digest size for all algorithms we support. Having this value
@@ -149,6 +150,25 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop);
 
+/**
+ * hash_regions() - Hash a list of regions with the given algorithm
+ *
+ * If a hash driver is available and the regions add up to at least
+ * CONFIG_HASH_OFFLOAD_MIN bytes, the driver is used. Otherwise, or if the
+ * driver fails, the regions are hashed on the CPU.
+ *
+ * @algo: Hash algorithm to use
+ * @region: Regions to hash, in order
+ * @count: Number of regions
+ * @output: Place to put the hash value, algo->digest_size bytes
+ *
+ * Return: 0 if ok, -EINVAL if @count is less than 1, -EPROTONOSUPPORT if
+ * several regions are given and @algo has no progressive hashing, other -ve
+ * on error. A single region is always hashed successfully.
+ */
+int hash_regions(struct hash_algo *algo, const struct image_region *region,
+		 int count, uint8_t *output);
+
 /**
  * hash_parse_string() - Parse hash string into a binary array
  *
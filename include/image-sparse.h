@@ -11,11 +11,30 @@
 
 #define ROUNDUP(x, y)	(((x) + ((y) - 1)) & ~((y) - 1))
 
+/**
+ * struct sparse_storage - where and how to write a sparse image
+ *
+ * @blksz:	Block size of the storage in bytes
+ * @start:	First block to write
+ * @size:	Number of blocks available from @start
+ * @priv:	Private data for the callbacks
+ * @erase_grp:	Erase group size in blocks; @erase is only called for whole,
+ *		aligned groups. 0 is treated as 1
+ * @write:	Write blocks, returning the number of blocks used, which may be
+ *		more than @blkcnt if bad blocks are skipped
+ * @reserve:	Skip blocks which the image does not care about, returning
+ *		the number of blocks used
+ * @erase:	Erase blocks so that they read as zero, returning the number
+ *		of blocks erased. This is optional and is used instead of
+ *		writing zeroes. If it fails, the zeroes are written instead
+ * @mssg:	Report an error to the host
+ */
 struct sparse_storage {
 	lbaint_t	blksz;
 	lbaint_t	start;
 	lbaint_t	size;
 	void		*priv;
+	lbaint_t	erase_grp;
 
 	lbaint_t	(*write)(struct sparse_storage *info,
 				 lbaint_t blk,
@@ -26,6 +45,10 @@ struct sparse_storage {
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
 
+	lbaint_t	(*erase)(struct sparse_storage *info,
+				 lbaint_t blk,
+				 lbaint_t blkcnt);
+
 	void		(*mssg)(const char *str, char *response);
 };
 
@@ -40,5 +63,18 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * write_sparse_image() - Write an Android sparse image
+ *
+ * Adjacent RAW chunks are gathered into large writes. FILL chunks of zeroes
+ * are erased with @info->erase where possible, as are DONT_CARE chunks with
+ * CONFIG_IMAGE_SPARSE_DISCARD. The time taken is printed when done.
+ *
+ * @info:	Storage to write to
+ * @part_name:	Name of the partition, for messages
+ * @data:	Sparse image
+ * @response:	Buffer for the response to the host, passed to @info->mssg
+ * Return: 0 if OK, -1 on error
+ */
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
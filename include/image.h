@@ -344,6 +344,72 @@ struct image_info {
 	uint8_t		arch;			/* CPU architecture */
 };
 
+/* Maximum number of hash nodes in an image checked by struct fit_hash_stream */
+#define FIT_HASH_STREAM_MAX	4
+
+struct hash_algo;
+
+/**
+ * struct fit_hash_stream - hashes of a FIT image checked as its data is used
+ *
+ * This allows the hash nodes of an image to be checked while the data is
+ * being decompressed, instead of reading it all once beforehand. See
+ * fit_image_hash_start().
+ *
+ * @wanted:	Set by the caller of fit_image_load() to allow the hashes of a
+ *		compressed kernel to be checked later
+ * @count:	Number of hashes being calculated, 0 if none
+ * @fit:	FIT containing the image
+ * @noffset:	Offset of the image node
+ * @hash:	Progress of each hash
+ * @hash.algo:	Hash algorithm
+ * @hash.ctx:	Hash context
+ * @hash.noffset: Offset of the hash node
+ */
+struct fit_hash_stream {
+	bool wanted;
+	int count;
+	const void *fit;
+	int noffset;
+	struct {
+		struct hash_algo *algo;
+		void *ctx;
+		int noffset;
+	} hash[FIT_HASH_STREAM_MAX];
+};
+
+/* Maximum number of images recorded in struct fit_verified */
+#define FIT_VERIFIED_MAX	8
+
+/**
+ * struct fit_verified - FIT images whose hashes were checked ahead of use
+ *
+ * With FIT_PARALLEL_HASH, the images of a configuration are all checked at
+ * once when the kernel is found, so that this can be spread across CPUs.
+ * The images which passed are recorded here until they are loaded. An entry
+ * is dropped if anything is loaded over its data in the meantime.
+ *
+ * @wanted:	Set by the caller of fit_image_load() to allow images to be
+ *		checked ahead of use, clearing the rest of this struct
+ *		afterwards
+ * @fit:	FIT containing the images, NULL if none were checked
+ * @count:	Number of images which passed
+ * @image:	Each image which passed
+ * @image.noffset: Offset of the image node
+ * @image.data:	Image data which was hashed
+ * @image.size:	Size of the image data
+ */
+struct fit_verified {
+	bool wanted;
+	const void *fit;
+	int count;
+	struct {
+		int noffset;
+		const void *data;
+		size_t size;
+	} image[FIT_VERIFIED_MAX];
+};
+
 /*
  * Legacy and FIT format headers used by do_bootm() and do_bootm_<os>()
  * routines.
@@ -368,6 +434,10 @@ struct bootm_headers {
 	void		*fit_hdr_os;	/* os FIT image header */
 	const char	*fit_uname_os;	/* os subimage node unit name */
 	int		fit_noffset_os;	/* os subimage node offset */
+	/* os hashes checked as it is decompressed by bootm_load_os() */
+	struct fit_hash_stream	os_hash;
+	/* images checked when the configuration was selected */
+	struct fit_verified	verified;
 
 	void		*fit_hdr_rd;	/* init ramdisk FIT image header */
 	const char	*fit_uname_rd;	/* init ramdisk subimage node unit name */
@@ -1013,6 +1083,72 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * image_decomp_data() - decompress data without showing a message
+ *
+ * This does the decompression for image_decomp(), for use where the data is
+ * not an image being loaded, e.g. for benchmarking the decompressors.
+ *
+ * @comp:	Compression type being used (IH_COMP_...)
+ * @load_buf:	Place to decompress to
+ * @image_buf:	Compressed data (copied if @comp is IH_COMP_NONE)
+ * @image_len:	Number of bytes at @image_buf
+ * @unc_len:	Available space at @load_buf
+ * @sizep:	Returns the number of bytes written to @load_buf
+ * Return: 0 if OK, -ENOSYS if @comp is not supported, other -ve on error
+ */
+int image_decomp_data(int comp, void *load_buf, void *image_buf,
+		      ulong image_len, uint unc_len, ulong *sizep);
+
+/**
+ * image_decomp_margin() - Find the space needed to decompress in place
+ *
+ * Some compression types can be decompressed into memory which overlaps the
+ * compressed data, if the data starts within the output and ends at least a
+ * margin beyond the end of the decompressed data. The margin allows for the
+ * data growing where it does not compress and for the decompressor writing
+ * ahead of its output.
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @image_buf:	Compressed data
+ * @image_len:	Number of bytes at @image_buf
+ * @sizep:	Returns the size of the decompressed data
+ * @marginp:	Returns the margin needed after the decompressed data
+ * Return: 0 if OK, -ENOSYS if @comp cannot be decompressed in place,
+ *	-ENODATA if the compressed data does not record its decompressed size,
+ *	other -ve if the compressed data is not valid
+ */
+int image_decomp_margin(int comp, const void *image_buf, ulong image_len,
+			ulong *sizep, ulong *marginp);
+
+/**
+ * typedef image_input_t - called with the input of a decompressor
+ *
+ * @priv:	Private data passed to image_decomp_input()
+ * @buf:	Next part of the compressed data
+ * @size:	Number of bytes at @buf
+ */
+typedef void (*image_input_t)(void *priv, const void *buf, ulong size);
+
+/**
+ * image_decomp_input() - decompress an image, passing its data to a function
+ *
+ * This is the same as image_decomp() except that @input is called with each
+ * part of the compressed data just before it is decompressed, so that it can
+ * be hashed while it is in the cache. Every byte of @image_buf is passed to
+ * @input exactly once, in order, even if decompression fails. Compression
+ * types which cannot be decompressed piece by piece pass all the data first.
+ *
+ * @input:	Function to call with the data
+ * @priv:	Private data for @input
+ * For the other arguments, see image_decomp()
+ * Return: 0 if OK, -ve on error (BOOTM_ERR_...)
+ */
+int image_decomp_input(int comp, ulong load, ulong image_start, int type,
+		       void *load_buf, void *image_buf, ulong image_len,
+		       uint unc_len, ulong *load_end, image_input_t input,
+		       void *priv);
+
 /**
  * Set up properties in the FDT
  *
@@ -1342,6 +1478,48 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       size_t size);
 
 int fit_image_verify(const void *fit, int noffset);
+
+/**
+ * fit_image_hash_start() - Start checking the hashes of an image as it is used
+ *
+ * This is an alternative to fit_image_verify() for images which are read
+ * once anyway, e.g. to decompress them. It is only possible if all the image
+ * has is hash nodes using algorithms which support progressive hashing, since
+ * signatures and ciphered data need the whole image.
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @noffset:	Offset of the image node
+ * @hs:		Returns the hashing state
+ * Return: 0 if OK, -ENOTSUPP if the image must be checked with
+ *	fit_image_verify(), other -ve on error
+ */
+int fit_image_hash_start(const void *fit, int noffset,
+			 struct fit_hash_stream *hs);
+
+/**
+ * fit_image_hash_update() - Add image data to the hashes
+ *
+ * This has the type image_input_t so that it can be passed to
+ * image_decomp_input()
+ *
+ * @priv:	Hashing state (struct fit_hash_stream *)
+ * @buf:	Next part of the image data
+ * @size:	Number of bytes at @buf
+ */
+void fit_image_hash_update(void *priv, const void *buf, ulong size);
+
+/**
+ * fit_image_hash_finish() - Check the hashes of an image
+ *
+ * This completes the hashes started by fit_image_hash_start() and compares
+ * them with the hash values in the FIT, showing the result. It must be called
+ * once all data is hashed, or to abandon the hashes.
+ *
+ * @hs:		Hashing state
+ * Return: 0 if the hashes match, -EACCES if not
+ */
+int fit_image_hash_finish(struct fit_hash_stream *hs);
+
 #if CONFIG_IS_ENABLED(FIT_SIGNATURE)
 int fit_config_verify(const void *fit, int conf_noffset);
 #else
@@ -455,4 +455,23 @@ struct abuf;
  */
 int zstd_decompress(struct abuf *in, struct abuf *out);
 
+/**
+ * zstd_inplace_margin() - Find the space needed to decompress in place
+ *
+ * A zstd frame can be decompressed by zstd_decompress() into a buffer which
+ * overlaps it, so long as the frame starts within the buffer and ends at
+ * least the margin beyond the end of the decompressed data. This needs the
+ * frame to record the content size, which zstd does by default.
+ *
+ * @src: zstd frame
+ * @srcn: Length of @src
+ * @dstnp: Returns the length of the decompressed data
+ * @marginp: Returns the margin needed after the decompressed data
+ * Return: 0 if OK, -EINVAL if @src does not start with a zstd frame header,
+ *	-ENODATA if the content size is not recorded, -EFBIG if it is too large
+ *	for memory
+ */
+int zstd_inplace_margin(const void *src, size_t srcn, size_t *dstnp,
+			size_t *marginp);
+
 #endif  /* LINUX_ZSTD_H */
@@ -879,6 +879,24 @@ void malloc_enable_testing(int max_allocs);
 /** malloc_disable_testing() - Put malloc() into normal mode */
 void malloc_disable_testing(void);
 
+/**
+ * malloc_peak_reset() - Start measuring the peak heap use from now
+ *
+ * This only works if SYS_MALLOC_PEAK is enabled
+ */
+void malloc_peak_reset(void);
+
+/**
+ * malloc_peak() - Get the peak heap use since malloc_peak_reset()
+ *
+ * This only works if SYS_MALLOC_PEAK is enabled
+ *
+ * Return: most bytes held by allocations at any time since the last call to
+ *	malloc_peak_reset(), beyond those held at that call. This includes
+ *	the overhead of each allocation.
+ */
+ulong malloc_peak(void);
+
 #if CONFIG_IS_ENABLED(SYS_MALLOC_SIMPLE)
 #define malloc malloc_simple
 #define realloc realloc_simple
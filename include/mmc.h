@@ -75,6 +75,7 @@ struct bd_info;
 #define MMC_MODE_SPI		BIT(27)
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_DATA_STAT_AFTER_ERASE	0x00800000
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -221,6 +222,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_BOOT_WP			173	/* R/W & R/W/C_P */
 #define EXT_CSD_BOOT_WP_STATUS		174	/* R */
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
@@ -874,6 +876,25 @@ void print_mmc_devices(char separator);
  * Return: 0 if there is no MMC device, else the number of devices
  */
 int get_mmc_num(void);
+
+/**
+ * mmc_erase_reads_zero() - Check whether erased blocks read back as zero
+ *
+ * Depending on the card, erased blocks read as all zeroes or all ones. This
+ * is given by DATA_STAT_AFTER_ERASE in the SCR of an SD card and by
+ * ERASED_MEM_CONT in the EXT_CSD of an eMMC.
+ *
+ * @mmc: MMC device, which must be initialised
+ * Return: true if erased blocks read as zero, false if not or unknown
+ */
+static inline bool mmc_erase_reads_zero(struct mmc *mmc)
+{
+	if (IS_SD(mmc))
+		return !(mmc->scr[0] & SD_DATA_STAT_AFTER_ERASE);
+
+	return mmc->ext_csd && !mmc->ext_csd[EXT_CSD_ERASED_MEM_CONT];
+}
+
 int mmc_switch_part(struct mmc *mmc, unsigned int part_num);
 int mmc_hwpart_config(struct mmc *mmc, const struct mmc_hwpart_conf *conf,
 		      enum mmc_hwpart_conf_mode mode);
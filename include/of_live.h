@@ -30,7 +30,8 @@ int of_live_build(const void *fdt_blob, struct device_node **rootp);
  * unflattens a device-tree, creating the
  * tree of struct device_node. It also fills the "name" and "type"
  * pointers of the nodes so the normal device-tree walking functions
- * can be used.
+ * can be used. Property names and values are not copied, so @blob must stay
+ * in place for as long as the tree is used.
  * @blob: The blob to expand
  * @mynodes: The device_node tree created by the call
  * Return: 0 if OK, -ve on error
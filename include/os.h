@@ -548,4 +548,24 @@ long os_get_time_offset(void);
  */
 void os_set_time_offset(long offset);
 
+/**
+ * os_thread_start() - run a function on a new host thread
+ *
+ * The function must not use anything in U-Boot which is not thread-safe,
+ * which is almost everything, including malloc() and printf().
+ *
+ * @threadp:	Returns the thread, for passing to os_thread_join()
+ * @func:	Function to run
+ * @priv:	Argument for @func
+ * Return:	0 if OK, -ve on error
+ */
+int os_thread_start(void **threadp, void (*func)(void *priv), void *priv);
+
+/**
+ * os_thread_join() - wait for a thread started by os_thread_start()
+ *
+ * @thread:	Thread to wait for, which is freed
+ */
+void os_thread_join(void *thread);
+
 #endif
@@ -33,6 +33,25 @@ int ulz4fn_legacy(const void *src, size_t srcn, void *dst, size_t *dstn);
  */
 int ulz4fn_auto(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * ulz4fn_inplace_margin() - Find the space needed to decompress in place
+ *
+ * LZ4 data can be decompressed by ulz4fn() into a buffer which overlaps it,
+ * so long as the data starts within the buffer and ends at least the margin
+ * beyond the end of the decompressed data. This needs the frame to record the
+ * content size, e.g. with 'lz4 --content-size'.
+ *
+ * @src: LZ4 frame
+ * @srcn: Length of @src
+ * @dstnp: Returns the length of the decompressed data
+ * @marginp: Returns the margin needed after the decompressed data
+ * Return: 0 if OK, -EPROTONOSUPPORT if @src is not an LZ4 frame which ulz4fn()
+ *	can decompress, -EINVAL if the frame header is invalid, -ENODATA if the
+ *	content size is not recorded, -EFBIG if it is too large for memory
+ */
+int ulz4fn_inplace_margin(const void *src, size_t srcn, size_t *dstnp,
+			  size_t *marginp);
+
 /**
  * LZ4_decompress_safe() - Decompression protected against buffer overflow
  * @source: source address of the compressed data
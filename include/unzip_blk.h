@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Decompressing an image straight to a block device
+ */
+
+#ifndef __UNZIP_BLK_H
+#define __UNZIP_BLK_H
+
+#include <blk.h>
+
+/* Flags for unzip_blk() */
+enum unzip_blk_flags {
+	/* erase buffers which are all zeroes, instead of writing them */
+	UNZIP_BLK_ERASE_ZERO	= 1 << 0,
+};
+
+/**
+ * struct unzip_blk_stats - what unzip_blk() did
+ *
+ * @in_len:	Number of bytes of compressed data used
+ * @out_len:	Number of bytes decompressed
+ * @erased:	Number of those bytes which were erased instead of written
+ * @time_us:	Time taken in microseconds
+ */
+struct unzip_blk_stats {
+	u64 in_len;
+	u64 out_len;
+	u64 erased;
+	ulong time_us;
+};
+
+/**
+ * unzip_blk_supported() - Check whether a compression type can be written
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * Return: true if unzip_blk() supports @comp
+ */
+bool unzip_blk_supported(int comp);
+
+/**
+ * unzip_blk() - Decompress an image and write it to a block device
+ *
+ * The data is decompressed into one buffer while the previous buffer is
+ * being written, so that on devices which support blk_submit() in the
+ * background the two overlap. Buffers are written as whole blocks, the last
+ * one being padded with zeroes.
+ *
+ * With UNZIP_BLK_ERASE_ZERO, full buffers which are all zeroes are erased
+ * instead, if the device supports it. This is only correct for devices whose
+ * erased blocks read as zero, and @bufsize and @start should be multiples of
+ * the erase size.
+ *
+ * gzip, zstd and lz4 frames with independent blocks are supported. Only
+ * the first frame is decompressed.
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @src:	Compressed data
+ * @len:	Number of bytes at @src
+ * @desc:	Block device to write to
+ * @bufsize:	Size of each buffer, a multiple of the block size
+ * @start:	First block to write
+ * @flags:	Flags (enum unzip_blk_flags)
+ * @stats:	Returns what was done, also on error
+ * Return: 0 if OK, -EPROTONOSUPPORT if @comp is not supported, -EINVAL if
+ *	@bufsize is not valid, -ENOMEM if out of memory, -ENOSPC if the data
+ *	does not fit on the device, -EBADMSG if the compressed data is corrupt
+ *	or incomplete, -EINTR if interrupted by Ctrl-C, -EIO if writing failed
+ */
+int unzip_blk(int comp, const void *src, ulong len, struct blk_desc *desc,
+	      ulong bufsize, lbaint_t start, uint flags,
+	      struct unzip_blk_stats *stats);
+
+#endif
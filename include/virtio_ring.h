@@ -195,6 +195,27 @@ struct virtio_sg;
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs);
 
+/**
+ * virtqueue_add_head - expose buffers to other end, noting the chain head
+ *
+ * This is the same as virtqueue_add() but also returns the index of the
+ * first descriptor of the chain, which virtqueue_get_head() returns when the
+ * other end has used the buffers. Unlike the buffer address, this is not
+ * changed by bounce buffering.
+ *
+ * @vq:		the struct virtqueue we're talking about
+ * @sgs:	array of terminated scatterlists
+ * @out_sgs:	the number of scatterlists readable by other side
+ * @in_sgs:	the number of scatterlists which are writable
+ *		(after readable ones)
+ * @headp:	returns the index of the head descriptor
+ *
+ * Returns zero or a negative error (ie. ENOSPC, ENOMEM, EIO).
+ */
+int virtqueue_add_head(struct virtqueue *vq, struct virtio_sg *sgs[],
+		       unsigned int out_sgs, unsigned int in_sgs,
+		       unsigned int *headp);
+
 /**
  * virtqueue_kick - update after add_buf
  *
@@ -227,6 +248,20 @@ void virtqueue_kick(struct virtqueue *vq);
  */
 void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len);
 
+/**
+ * virtqueue_get_head - get the next used buffer by its head descriptor
+ *
+ * This is the same as virtqueue_get_buf() but returns the index of the head
+ * descriptor of the used chain, as given by virtqueue_add_head().
+ *
+ * @vq:		the struct virtqueue we're talking about
+ * @len:	the length written into the buffer
+ *
+ * Returns the head index, -ENOENT if there are no used buffers, or -EIO if
+ * the other end returned an invalid index.
+ */
+int virtqueue_get_head(struct virtqueue *vq, unsigned int *len);
+
 /**
  * vring_create_virtqueue - create a virtqueue for a virtio device
  *
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running independent jobs on secondary CPUs
+ */
+
+#ifndef __WORKER_H
+#define __WORKER_H
+
+/**
+ * typedef worker_func_t - Function which carries out a job
+ *
+ * This may run on a secondary CPU, at the same time as other jobs. It must
+ * only do calculations on memory it owns: it must not call malloc(),
+ * printf(), schedule() or driver model, none of which is thread-safe.
+ *
+ * @priv: Private data for the job
+ */
+typedef void (*worker_func_t)(void *priv);
+
+/**
+ * struct worker_job - A job for worker_run()
+ *
+ * @func:	Function to run
+ * @priv:	Argument for @func
+ */
+struct worker_job {
+	worker_func_t func;
+	void *priv;
+};
+
+#if CONFIG_IS_ENABLED(WORKER)
+/**
+ * worker_count() - Get the number of CPUs used by worker_run()
+ *
+ * Return: number of CPUs, including the boot CPU, so at least 1
+ */
+int worker_count(void);
+
+/**
+ * worker_run() - Run jobs across the available CPUs
+ *
+ * The jobs are shared among the CPUs in turn, with the boot CPU taking the
+ * first. This returns when all jobs are done, with their results visible to
+ * the caller.
+ *
+ * @jobs:	Jobs to run
+ * @count:	Number of jobs
+ */
+void worker_run(struct worker_job *jobs, int count);
+#else
+static inline int worker_count(void)
+{
+	return 1;
+}
+
+static inline void worker_run(struct worker_job *jobs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		jobs[i].func(jobs[i].priv);
+}
+#endif
+
+/**
+ * arch_worker_count() - Get the number of secondary CPUs which can run jobs
+ *
+ * Return: number of CPUs, not including the boot CPU
+ */
+int arch_worker_count(void);
+
+/**
+ * arch_worker_start() - Start a function on a secondary CPU
+ *
+ * @cpu:	Secondary CPU to use, from 0 to arch_worker_count() - 1
+ * @func:	Function to run
+ * @priv:	Argument for @func
+ * Return: 0 if OK, -ve if the CPU cannot be used, in which case the caller
+ *	runs the function itself
+ */
+int arch_worker_start(int cpu, worker_func_t func, void *priv);
+
+/**
+ * arch_worker_wait() - Wait for a secondary CPU to finish its function
+ *
+ * On return, everything written by the function must be visible to the boot
+ * CPU.
+ *
+ * @cpu:	Secondary CPU, which was started by arch_worker_start()
+ */
+void arch_worker_wait(int cpu);
+
+#endif
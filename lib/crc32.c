@@ -29,7 +29,90 @@
 
 #define tole(x) cpu_to_le32(x)
 
+/* Host tools always use the larger, faster tables */
+#ifdef USE_HOSTCC
+#ifndef CONFIG_ARM64_CRC32
+#define CRC32_SLICE_BY_8
+#endif
+#elif CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#define CRC32_SLICE_BY_8
+#endif
+
+#ifdef CRC32_SLICE_BY_8
+#ifdef CONFIG_DYNAMIC_CRC_TABLE
+
+static int __efi_runtime_data crc_slice_empty = 1;
+static uint32_t __efi_runtime_data crc_slice[8][256];
+
+/*
+ * Generate the tables for slicing-by-8. The first is the usual byte-wise
+ * table: entry n is the CRC of the byte n, using the reflected polynomial
+ * 0xedb88320. Each entry in the following tables is the CRC of the
+ * corresponding entry in the previous table followed by a zero byte, i.e. the
+ * effect of a byte which is one position further from the end of an
+ * eight-byte group.
+ */
+static void __efi_runtime make_crc_slice(void)
+{
+	uint32_t c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = n;
+		for (k = 0; k < 8; k++)
+			c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_slice[0][n] = c;
+	}
+	for (n = 0; n < 256; n++) {
+		c = crc_slice[0][n];
+		for (k = 1; k < 8; k++) {
+			c = crc_slice[0][c & 0xff] ^ (c >> 8);
+			crc_slice[k][n] = c;
+		}
+	}
+	crc_slice_empty = 0;
+}
+#else
+#include "crc32_table.h"
+#endif
+
+/*
+ * Calculate the CRC eight bytes at a time, with one lookup per byte but no
+ * dependency between the lookups for a group. This is several times faster
+ * than the byte-wise loop on CPUs without CRC instructions.
+ */
+static uint32_t __efi_runtime crc32_slice8(uint32_t crc, const Bytef *buf,
+					   uInt len)
+{
+	const uint32_t *b;
+	uint32_t one, two;
+
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
+	if (crc_slice_empty)
+		make_crc_slice();
+#endif
+	for (; len && ((ulong)buf & 3); len--)
+		crc = crc_slice[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	for (b = (const uint32_t *)buf; len >= 8; len -= 8) {
+		one = le32_to_cpu(*b++) ^ crc;
+		two = le32_to_cpu(*b++);
+		crc = crc_slice[7][one & 0xff] ^
+		      crc_slice[6][(one >> 8) & 0xff] ^
+		      crc_slice[5][(one >> 16) & 0xff] ^
+		      crc_slice[4][one >> 24] ^
+		      crc_slice[3][two & 0xff] ^
+		      crc_slice[2][(two >> 8) & 0xff] ^
+		      crc_slice[1][(two >> 16) & 0xff] ^
+		      crc_slice[0][two >> 24];
+	}
+
+	for (buf = (const Bytef *)b; len; len--)
+		crc = crc_slice[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+#elif defined(CONFIG_DYNAMIC_CRC_TABLE)
 
 static int __efi_runtime_data crc_table_empty = 1;
 static uint32_t __efi_runtime_data crc_table[256];
@@ -187,6 +270,8 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     while (len--)
         crc = __builtin_aarch64_crc32b(crc, *buf++);
     return le32_to_cpu(crc);
+#elif defined(CRC32_SLICE_BY_8)
+    return crc32_slice8(crc, buf, len);
 #else
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming decompression
+ */
+
+#define LOG_CATEGORY LOGC_BOOT
+
+#include <decomp_stream.h>
+#include <image.h>
+#include <log.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+
+static const struct decomp_stream_ops *decomp_stream_get_ops(int comp)
+{
+	switch (comp) {
+	case IH_COMP_GZIP:
+		if (CONFIG_IS_ENABLED(GZIP))
+			return &gzip_stream_ops;
+		break;
+	case IH_COMP_LZ4:
+		if (CONFIG_IS_ENABLED(LZ4))
+			return &lz4_stream_ops;
+		break;
+	case IH_COMP_LZMA:
+		if (CONFIG_IS_ENABLED(LZMA))
+			return &lzma_stream_ops;
+		break;
+	case IH_COMP_ZSTD:
+		if (CONFIG_IS_ENABLED(ZSTD))
+			return &zstd_stream_ops;
+		break;
+	}
+
+	return NULL;
+}
+
+bool decomp_stream_supported(int comp)
+{
+	return decomp_stream_get_ops(comp);
+}
+
+bool decomp_stream_window_supported(int comp)
+{
+	const struct decomp_stream_ops *ops = decomp_stream_get_ops(comp);
+
+	return ops && ops->window;
+}
+
+int decomp_stream_init(struct decomp_stream *ds, int comp, void *out,
+		       ulong out_size)
+{
+	memset(ds, '\0', sizeof(*ds));
+	ds->ops = decomp_stream_get_ops(comp);
+	if (!ds->ops)
+		return -EPROTONOSUPPORT;
+	ds->comp = comp;
+	ds->out = out;
+	ds->out_size = out_size;
+
+	return ds->ops->init(ds);
+}
+
+int decomp_stream_init_window(struct decomp_stream *ds, int comp)
+{
+	memset(ds, '\0', sizeof(*ds));
+	ds->ops = decomp_stream_get_ops(comp);
+	if (!ds->ops || !ds->ops->window)
+		return -EPROTONOSUPPORT;
+	ds->comp = comp;
+	ds->window = true;
+
+	return ds->ops->init(ds);
+}
+
+int decomp_stream_feed(struct decomp_stream *ds, const void *in, ulong len)
+{
+	int ret;
+
+	if (ds->done || !len)
+		return 0;
+	ret = ds->ops->feed(ds, in, len);
+	if (ret)
+		log_debug("decompression failed at input byte %lx: %d\n",
+			  ds->in_len, ret);
+	ds->in_len += len;
+
+	return ret;
+}
+
+long decomp_stream_fill(struct decomp_stream *ds, const void *in, ulong len,
+			void *out, ulong size)
+{
+	int ret;
+
+	ds->out = out;
+	ds->out_size = size;
+	ds->out_len = 0;
+	if (ds->done)
+		return 0;
+	ds->in_used = len;
+	ret = ds->ops->feed(ds, in, len);
+	if (ret) {
+		log_debug("decompression failed at input byte %lx: %d\n",
+			  ds->in_len, ret);
+		return ret;
+	}
+	ds->in_len += ds->in_used;
+
+	return ds->in_used;
+}
+
+long decomp_stream_finish(struct decomp_stream *ds)
+{
+	ds->ops->free(ds);
+	ds->priv = NULL;
+	if (!ds->done)
+		return -EBADMSG;
+
+	return ds->window ? 0 : ds->out_len;
+}
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Look up nodes in the control devicetree using the index added by the build
+ *
+ * See include/dtb_index.h for the layout of the index.
+ */
+
+#include <dtb_index.h>
+#include <errno.h>
+#include <log.h>
+#include <asm/global_data.h>
+#include <linux/libfdt.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/**
+ * dtb_index_get() - Find the index node, if it can be used
+ *
+ * The build puts the index first among the children of the root node, so it
+ * is found without searching the tree. It can only be used while the
+ * structure block has the size it was built with, since anything that adds
+ * or removes nodes or properties moves the offsets.
+ *
+ * @fdt: Devicetree to look in
+ * Return: offset of index node, or -ve if it cannot be used
+ */
+static int dtb_index_get(const void *fdt)
+{
+	const fdt32_t *size;
+	int node;
+
+	if (fdt != gd->fdt_blob)
+		return -ENOENT;
+	if (gd->dtb_index_fdt != fdt) {
+		gd->dtb_index_fdt = fdt;
+		gd->dtb_index_node = fdt_subnode_offset(fdt, 0, DTB_INDEX_NODE);
+		log_debug("dtb index at %d\n", gd->dtb_index_node);
+	}
+	node = gd->dtb_index_node;
+	if (node < 0)
+		return node;
+	size = fdt_getprop(fdt, node, DTB_INDEX_STRUCT_SIZE, NULL);
+	if (!size || fdt32_to_cpu(*size) != fdt_size_dt_struct(fdt))
+		return -ESTALE;
+
+	return node;
+}
+
+/**
+ * dtb_index_is_node() - Check that an offset from the index is still a node
+ *
+ * A change which keeps the size of the structure block, such as
+ * fdt_nop_node(), can leave the index pointing at something else.
+ *
+ * @fdt: Devicetree to check
+ * @offset: Offset from the index
+ * Return: true if there is a node at @offset
+ */
+static bool dtb_index_is_node(const void *fdt, int offset)
+{
+	int next;
+
+	return offset >= 0 && !(offset & (FDT_TAGSIZE - 1)) &&
+		fdt_next_tag(fdt, offset, &next) == FDT_BEGIN_NODE;
+}
+
+bool dtb_index_phandle(const void *fdt, uint phandle, int *offsetp)
+{
+	const fdt32_t *tbl;
+	int node, len;
+
+	/* leave invalid phandles to libfdt, which reports them */
+	if (!phandle || phandle == (uint)-1)
+		return false;
+	node = dtb_index_get(fdt);
+	if (node < 0)
+		return false;
+	tbl = fdt_getprop(fdt, node, DTB_INDEX_PHANDLES, &len);
+	if (!tbl)
+		return false;
+
+	/*
+	 * Check the node still has the phandle, since it can be changed in
+	 * place. Leave phandles which are not in the index to libfdt, since
+	 * one of those may have been set in the same way.
+	 */
+	if (phandle >= len / sizeof(*tbl))
+		return false;
+	node = fdt32_to_cpu(tbl[phandle]);
+	if (!dtb_index_is_node(fdt, node) ||
+	    fdt_get_phandle(fdt, node) != phandle)
+		return false;
+	*offsetp = node;
+
+	return true;
+}
+
+bool dtb_index_alias(const void *fdt, const char *name, int *offsetp)
+{
+	const char *path, *comp, *nodename;
+	const fdt32_t *tbl;
+	int node, len, idx;
+
+	node = dtb_index_get(fdt);
+	if (node < 0)
+		return false;
+	tbl = fdt_getprop(fdt, node, DTB_INDEX_ALIASES, &len);
+	if (!tbl)
+		return false;
+
+	idx = fdt_stringlist_search(fdt, node, DTB_INDEX_ALIAS_NAMES, name);
+	if (idx < 0 || idx >= len / sizeof(*tbl))
+		return false;
+
+	/*
+	 * The alias can be changed in place to a path of the same length, so
+	 * check that it still ends with the name of the node
+	 */
+	node = fdt32_to_cpu(tbl[idx]);
+	path = fdt_get_alias(fdt, name);
+	comp = path ? strrchr(path, '/') : NULL;
+	if (!comp || !dtb_index_is_node(fdt, node))
+		return false;
+	comp++;
+	nodename = fdt_get_name(fdt, node, NULL);
+	len = strlen(comp);
+	if (!nodename || strncmp(nodename, comp, len) ||
+	    (nodename[len] && (nodename[len] != '@' || strchr(comp, '@'))))
+		return false;
+	*offsetp = node;
+
+	return true;
+}
+
+bool dtb_index_compatible(const void *fdt, int startoffset, const char *compat,
+			  int *offsetp)
+{
+	const fdt32_t *tbl, *end;
+	int node, len, idx;
+	uint count = 0;
+
+	node = dtb_index_get(fdt);
+	if (node < 0)
+		return false;
+	tbl = fdt_getprop(fdt, node, DTB_INDEX_COMPAT_NODES, &len);
+	if (!tbl)
+		return false;
+	end = tbl + len / sizeof(*tbl);
+
+	*offsetp = -FDT_ERR_NOTFOUND;
+	idx = fdt_stringlist_search(fdt, node, DTB_INDEX_COMPAT_STRINGS, compat);
+	if (idx < 0)
+		return true;
+
+	/* skip the lists for the strings before this one */
+	for (; tbl < end; tbl += count + 1) {
+		count = fdt32_to_cpu(*tbl);
+		if (!idx--)
+			break;
+	}
+	if (tbl >= end || count > end - tbl - 1)
+		return false;
+
+	for (tbl++; count; tbl++, count--) {
+		node = fdt32_to_cpu(*tbl);
+		if (node > startoffset) {
+			/* check the node still has the compatible string */
+			if (!dtb_index_is_node(fdt, node) ||
+			    fdt_node_check_compatible(fdt, node, compat))
+				return false;
+			*offsetp = node;
+			break;
+		}
+	}
+
+	return true;
+}
@@ -7,6 +7,7 @@
 
 #define LOG_CATEGORY LOGC_EFI
 
+#include <blk.h>
 #include <bootm.h>
 #include <div64.h>
 #include <dm/device.h>
@@ -2235,6 +2236,10 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 			list_del(&evt->link);
 	}
 
+	/* The OS owns the disks from now on */
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE) && blk_flush_all())
+		log_err("Block cache flush failed\n");
+
 	if (!efi_st_keep_devices) {
 		bootm_disable_interrupts();
 		if (IS_ENABLED(CONFIG_USB_DEVICE))
@@ -14,6 +14,7 @@
 #include <boot_fit.h>
 #include <display_options.h>
 #include <dm.h>
+#include <dtb_index.h>
 #include <hang.h>
 #include <init.h>
 #include <log.h>
@@ -794,8 +795,9 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				if (!dtb_index_phandle(blob, phandle, &node))
+					node = fdt_node_offset_by_phandle(blob,
+									  phandle);
 				if (node < 0) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
@@ -7,6 +7,7 @@
 #include <blk.h>
 #include <command.h>
 #include <console.h>
+#include <decomp_stream.h>
 #include <div64.h>
 #include <gzip.h>
 #include <image.h>
@@ -27,6 +28,9 @@
 #define RESERVED		0xe0
 #define DEFLATED		8
 
+/* Most compressed data passed to inflate() at once, as avail_in is a uInt */
+#define GZIP_IN_MAX		(1U << 30)
+
 void *gzalloc(void *x, unsigned items, unsigned size)
 {
 	void *p;
@@ -82,6 +86,184 @@ __rcode int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *len
 	return zunzip(dst, dstlen, src, lenp, 1, offset);
 }
 
+#if CONFIG_IS_ENABLED(DECOMP_STREAM)
+enum gzip_stream_state {
+	GZS_FIXED,	/* the first 10 bytes of the header */
+	GZS_XLEN,	/* length of the extra field */
+	GZS_SKIP,	/* extra field or header CRC */
+	GZS_STRING,	/* file name or comment */
+	GZS_DATA,	/* deflate stream */
+};
+
+/**
+ * struct gzip_stream - state of a streaming gunzip
+ *
+ * @s: zlib stream, set up once the header has been parsed
+ * @state: Part of the gzip file expected next
+ * @flags: Header flags not yet dealt with
+ * @hdr: Header bytes collected so far
+ * @hdr_len: Number of bytes in @hdr
+ * @skip: Bytes left to skip in GZS_SKIP
+ */
+struct gzip_stream {
+	z_stream s;
+	enum gzip_stream_state state;
+	int flags;
+	u8 hdr[12];
+	int hdr_len;
+	uint skip;
+};
+
+static void gzip_stream_next(struct gzip_stream *gz)
+{
+	if (gz->flags & EXTRA_FIELD) {
+		gz->flags &= ~EXTRA_FIELD;
+		gz->state = GZS_XLEN;
+	} else if (gz->flags & ORIG_NAME) {
+		gz->flags &= ~ORIG_NAME;
+		gz->state = GZS_STRING;
+	} else if (gz->flags & COMMENT) {
+		gz->flags &= ~COMMENT;
+		gz->state = GZS_STRING;
+	} else if (gz->flags & HEAD_CRC) {
+		gz->flags &= ~HEAD_CRC;
+		gz->skip = 2;
+		gz->state = GZS_SKIP;
+	} else {
+		gz->state = GZS_DATA;
+	}
+}
+
+/* parse the header, returning the number of bytes used from @in */
+static int gzip_stream_header(struct gzip_stream *gz, const u8 *in, ulong len)
+{
+	ulong used = 0, n;
+
+	while (used < len && gz->state != GZS_DATA) {
+		switch (gz->state) {
+		case GZS_FIXED:
+			gz->hdr[gz->hdr_len++] = in[used++];
+			if (gz->hdr_len < 10)
+				break;
+			gz->flags = gz->hdr[3];
+			if (gz->hdr[2] != DEFLATED || (gz->flags & RESERVED)) {
+				puts("Error: Bad gzipped data\n");
+				return -EINVAL;
+			}
+			gzip_stream_next(gz);
+			break;
+		case GZS_XLEN:
+			gz->hdr[gz->hdr_len++] = in[used++];
+			if (gz->hdr_len < 12)
+				break;
+			gz->skip = gz->hdr[10] | gz->hdr[11] << 8;
+			gz->state = GZS_SKIP;
+			if (!gz->skip)
+				gzip_stream_next(gz);
+			break;
+		case GZS_SKIP:
+			n = min_t(ulong, gz->skip, len - used);
+			used += n;
+			gz->skip -= n;
+			if (!gz->skip)
+				gzip_stream_next(gz);
+			break;
+		case GZS_STRING:
+			if (!in[used++])
+				gzip_stream_next(gz);
+			break;
+		case GZS_DATA:
+			break;
+		}
+	}
+
+	return used;
+}
+
+static int gzip_stream_init(struct decomp_stream *ds)
+{
+	struct gzip_stream *gz;
+	int r;
+
+	gz = calloc(1, sizeof(*gz));
+	if (!gz)
+		return -ENOMEM;
+	gz->s.zalloc = gzalloc;
+	gz->s.zfree = gzfree;
+	r = inflateInit2(&gz->s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(gz);
+		return -ENOMEM;
+	}
+	ds->priv = gz;
+
+	return 0;
+}
+
+static int gzip_stream_feed(struct decomp_stream *ds, const void *in, ulong len)
+{
+	struct gzip_stream *gz = ds->priv;
+	const u8 *end = in + len;
+	int used, r;
+
+	used = gzip_stream_header(gz, in, len);
+	if (used < 0)
+		return used;
+	if (gz->state != GZS_DATA || (used == len && !ds->window))
+		return 0;
+
+	/*
+	 * In window mode inflate() may still hold output when there is no
+	 * more input, so it is called even then. It keeps its own window.
+	 */
+	gz->s.next_in = (u8 *)in + used;
+	gz->s.avail_in = 0;
+	gz->s.next_out = ds->out + ds->out_len;
+	gz->s.avail_out = ds->out_size - ds->out_len;
+	do {
+		if (!gz->s.avail_in)
+			gz->s.avail_in = min_t(ulong, end - gz->s.next_in,
+					       GZIP_IN_MAX);
+		r = inflate(&gz->s, Z_NO_FLUSH);
+		ds->out_len = gz->s.next_out - ds->out;
+		if (r == Z_STREAM_END) {
+			ds->done = true;
+			break;
+		}
+		/* no progress without more input or more room for output */
+		if (r == Z_BUF_ERROR && ds->window)
+			break;
+		if (r == Z_BUF_ERROR && !gz->s.avail_out)
+			return -ENOSPC;
+		if (r != Z_OK) {
+			printf("Error: inflate() returned %d\n", r);
+			return -EBADMSG;
+		}
+		if (ds->window && !gz->s.avail_out)
+			break;
+	} while (gz->s.next_in != end);
+	ds->in_used = gz->s.next_in - (u8 *)in;
+
+	return 0;
+}
+
+static void gzip_stream_free(struct decomp_stream *ds)
+{
+	struct gzip_stream *gz = ds->priv;
+
+	inflateEnd(&gz->s);
+	free(gz);
+}
+
+const struct decomp_stream_ops gzip_stream_ops = {
+	.window	= true,
+	.init	= gzip_stream_init,
+	.feed	= gzip_stream_feed,
+	.free	= gzip_stream_free,
+};
+#endif
+
 #ifdef CONFIG_CMD_UNZIP
 __weak
 void gzwrite_progress_init(ulong expectedsize)
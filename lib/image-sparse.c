@@ -42,90 +42,213 @@
 #include <malloc.h>
 #include <part.h>
 #include <sparse_format.h>
+#include <time.h>
 #include <asm/cache.h>
 
 #include <linux/math64.h>
 #include <linux/err.h>
 
+#define FILL_BUF_SIZE	CONFIG_IMAGE_SPARSE_FILLBUF_SIZE
+
 static void default_log(const char *ignored, char *response) {}
 
-static lbaint_t write_sparse_chunk_raw(struct sparse_storage *info,
-				       lbaint_t blk, lbaint_t blkcnt,
-				       void *data,
-				       char *response)
+/**
+ * struct sparse_writer - state while writing a sparse image
+ *
+ * @info:	Storage being written
+ * @response:	Buffer for the response to the host
+ * @buf:	Bounce buffer which gathers adjacent RAW chunks
+ * @buf_blks:	Size of @buf in blocks
+ * @pend_blks:	Number of blocks in @buf still to be written
+ * @fill_buf:	Buffer for FILL chunks, allocated when first needed
+ * @write_us:	Time spent writing, in microseconds
+ * @erase_us:	Time spent erasing, in microseconds
+ * @erased:	Number of blocks erased
+ */
+struct sparse_writer {
+	struct sparse_storage *info;
+	char *response;
+	void *buf;
+	lbaint_t buf_blks;
+	lbaint_t pend_blks;
+	uint32_t *fill_buf;
+	ulong write_us;
+	ulong erase_us;
+	lbaint_t erased;
+};
+
+/* Write blocks, moving *blkp past the blocks used */
+static int sparse_write(struct sparse_writer *w, lbaint_t *blkp,
+			lbaint_t blkcnt, const void *buffer)
+{
+	struct sparse_storage *info = w->info;
+	ulong start = timer_get_us();
+	lbaint_t blks;
+
+	/* blks might be > blkcnt due to NAND bad-blocks */
+	blks = info->write(info, *blkp, blkcnt, buffer);
+	w->write_us += timer_get_us() - start;
+	if (IS_ERR_VALUE(blks)) {
+		printf("%s: Write failed, block #" LBAFU " [" LBAFU "] (%lld)\n",
+		       __func__, *blkp, blkcnt, (long long)blks);
+		info->mssg("flash write failure", w->response);
+		return -1;
+	}
+	if (blks < blkcnt) {
+		printf("%s: Write failed, block #" LBAFU " [" LBAFU "]\n",
+		       __func__, *blkp, blkcnt);
+		info->mssg("flash write failure(incomplete)", w->response);
+		return -1;
+	}
+	*blkp += blks;
+
+	return 0;
+}
+
+/* Write out the RAW data gathered in the bounce buffer, which starts at *blkp */
+static int sparse_flush(struct sparse_writer *w, lbaint_t *blkp)
 {
-	lbaint_t n = blkcnt, write_blks, blks = 0;
-	lbaint_t aligned_buf_blks = FASTBOOT_MAX_BLK_WRITE;
-	uint32_t *aligned_buf = NULL;
+	int ret;
 
-	if (CONFIG_IS_ENABLED(SYS_DCACHE_OFF)) {
-		write_blks = info->write(info, blk, n, data);
-		if (write_blks < n)
-			goto write_fail;
+	if (!w->pend_blks)
+		return 0;
+	ret = sparse_write(w, blkp, w->pend_blks, w->buf);
+	w->pend_blks = 0;
+
+	return ret;
+}
+
+/*
+ * Add a RAW chunk after the data already gathered, writing the bounce buffer
+ * each time it fills up. Large chunks which can be written where they are do
+ * not need to be copied.
+ */
+static int sparse_raw(struct sparse_writer *w, lbaint_t *blkp,
+		      lbaint_t blkcnt, const void *data)
+{
+	lbaint_t blksz = w->info->blksz;
+	lbaint_t n;
 
-		return write_blks;
+	if (blkcnt >= w->buf_blks &&
+	    (CONFIG_IS_ENABLED(SYS_DCACHE_OFF) ||
+	     IS_ALIGNED((ulong)data, ARCH_DMA_MINALIGN))) {
+		if (sparse_flush(w, blkp))
+			return -1;
+		return sparse_write(w, blkp, blkcnt, data);
 	}
 
-	aligned_buf = memalign(ARCH_DMA_MINALIGN, info->blksz * aligned_buf_blks);
-	if (!aligned_buf) {
-		info->mssg("Malloc failed for: CHUNK_TYPE_RAW", response);
-		return -ENOMEM;
+	while (blkcnt) {
+		n = min(w->buf_blks - w->pend_blks, blkcnt);
+		memcpy(w->buf + w->pend_blks * blksz, data, n * blksz);
+		w->pend_blks += n;
+		data += n * blksz;
+		blkcnt -= n;
+		if (w->pend_blks == w->buf_blks && sparse_flush(w, blkp))
+			return -1;
 	}
 
-	while (blkcnt > 0) {
-		n = min(aligned_buf_blks, blkcnt);
-		memcpy(aligned_buf, data, n * info->blksz);
+	return 0;
+}
 
-		/* write_blks might be > n due to NAND bad-blocks */
-		write_blks = info->write(info, blk + blks, n, aligned_buf);
-		if (write_blks < n) {
-			free(aligned_buf);
-			goto write_fail;
-		}
+/*
+ * Find the whole erase groups within a region, returning the number of blocks
+ * in them, with the number of blocks before the first in *headp
+ */
+static lbaint_t sparse_erase_groups(struct sparse_storage *info, lbaint_t blk,
+				    lbaint_t blkcnt, lbaint_t *headp)
+{
+	u32 grp = info->erase_grp ? info->erase_grp : 1;
+	lbaint_t head;
+	u64 n;
+
+	if (!info->erase)
+		return 0;
+	n = blk;
+	head = do_div(n, grp);
+	if (head)
+		head = grp - head;
+	if (head >= blkcnt)
+		return 0;
+	*headp = head;
+	n = blkcnt - head;
+
+	return blkcnt - head - do_div(n, grp);
+}
 
-		blks += write_blks;
-		data += n * info->blksz;
-		blkcnt -= n;
+/* Erase blocks, returning true if they now read as zero */
+static bool sparse_erase(struct sparse_writer *w, lbaint_t blk,
+			 lbaint_t blkcnt)
+{
+	struct sparse_storage *info = w->info;
+	ulong start = timer_get_us();
+	lbaint_t blks;
+
+	blks = info->erase(info, blk, blkcnt);
+	w->erase_us += timer_get_us() - start;
+	if (blks != blkcnt) {
+		debug("%s: Erase failed, block #" LBAFU " [" LBAFU "]\n",
+		      __func__, blk, blkcnt);
+		return false;
 	}
+	w->erased += blkcnt;
 
-	free(aligned_buf);
-	return blks;
+	return true;
+}
 
-write_fail:
-	if (IS_ERR_VALUE(write_blks)) {
-		printf("%s: Write failed, block #" LBAFU " [" LBAFU "] (%lld)\n",
-		       __func__, blk + blks, n, (long long)write_blks);
-		info->mssg("flash write failure", response);
-		return write_blks;
+/* Write a FILL chunk from w->fill_buf, erasing instead if the fill is zero */
+static int sparse_fill(struct sparse_writer *w, lbaint_t *blkp,
+		       lbaint_t blkcnt, uint32_t fill_val)
+{
+	lbaint_t fill_blks = FILL_BUF_SIZE / w->info->blksz;
+	lbaint_t head = 0, mid = 0, n;
+
+	if (!fill_val)
+		mid = sparse_erase_groups(w->info, *blkp, blkcnt, &head);
+
+	while (blkcnt) {
+		if (mid && !head) {
+			if (sparse_erase(w, *blkp, mid)) {
+				*blkp += mid;
+				blkcnt -= mid;
+			}
+			mid = 0;
+			continue;
+		}
+		n = min(blkcnt, fill_blks);
+		if (mid)
+			n = min(n, head);
+		if (sparse_write(w, blkp, n, w->fill_buf))
+			return -1;
+		blkcnt -= n;
+		if (mid)
+			head -= n;
 	}
 
-	/* write_blks < n */
-	printf("%s: Write failed, block #" LBAFU " [" LBAFU "]\n",
-	       __func__, blk + blks, n);
-	info->mssg("flash write failure(incomplete)", response);
-	return -1;
+	return 0;
 }
 
 int write_sparse_image(struct sparse_storage *info,
 		       const char *part_name, void *data, char *response)
 {
+	struct sparse_writer w = {
+		.info = info,
+		.response = response,
+		.buf_blks = FASTBOOT_MAX_BLK_WRITE,
+	};
 	lbaint_t blk;
 	lbaint_t blkcnt;
-	lbaint_t blks;
+	lbaint_t head, count;
 	uint64_t bytes_written = 0;
 	unsigned int chunk;
 	unsigned int offset;
 	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
 	uint32_t fill_val;
 	sparse_header_t *sparse_header;
 	chunk_header_t *chunk_header;
 	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
+	ulong start_us, time_us, rate;
+	int ret = -1;
 	int i;
-	int j;
-
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
 
 	/* Read and skip over sparse image header */
 	sparse_header = (sparse_header_t *)data;
@@ -164,9 +287,19 @@ int write_sparse_image(struct sparse_storage *info,
 		return -1;
 	}
 
+	w.buf = memalign(ARCH_DMA_MINALIGN, info->blksz * w.buf_blks);
+	if (!w.buf) {
+		info->mssg("Malloc failed for: CHUNK_TYPE_RAW", response);
+		return -1;
+	}
+
 	puts("Flashing Sparse Image\n");
+	start_us = timer_get_us();
 
-	/* Start processing chunks */
+	/*
+	 * Start processing chunks. RAW data gathered in the bounce buffer
+	 * is to be written at blk, so it must be flushed before blk moves on.
+	 */
 	blk = info->start;
 	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
 		/* Read and skip over chunk header */
@@ -197,24 +330,22 @@ int write_sparse_image(struct sparse_storage *info,
 			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
 				info->mssg("Bogus chunk size for chunk type Raw",
 					   response);
-				return -1;
+				goto out;
 			}
 
-			if (blk + blkcnt > info->start + info->size) {
+			if (blk + w.pend_blks + blkcnt >
+			    info->start + info->size) {
 				printf(
 				    "%s: Request would exceed partition size!\n",
 				    __func__);
 				info->mssg("Request would exceed partition size!",
 					   response);
-				return -1;
+				goto out;
 			}
 
-			blks = write_sparse_chunk_raw(info, blk, blkcnt,
-						      data, response);
-			if (IS_ERR_VALUE(blks))
-				return -1;
+			if (sparse_raw(&w, &blk, blkcnt, data))
+				goto out;
 
-			blk += blks;
 			bytes_written += ((u64)blkcnt) * info->blksz;
 			total_blocks += chunk_header->chunk_sz;
 			data += chunk_data_sz;
@@ -224,28 +355,11 @@ int write_sparse_image(struct sparse_storage *info,
 			if (chunk_header->total_sz !=
 			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
 				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
+				goto out;
 			}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
-
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
+			if (sparse_flush(&w, &blk))
+				goto out;
 
 			if (blk + blkcnt > info->start + info->size) {
 				printf(
@@ -253,36 +367,49 @@ int write_sparse_image(struct sparse_storage *info,
 				    __func__);
 				info->mssg("Request would exceed partition size!",
 					   response);
-				free(fill_buf);
-				return -1;
+				goto out;
 			}
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
+			if (!w.fill_buf) {
+				w.fill_buf = memalign(ARCH_DMA_MINALIGN,
+						      ROUNDUP(FILL_BUF_SIZE,
+							      ARCH_DMA_MINALIGN));
+				if (!w.fill_buf) {
+					info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
 						   response);
-					free(fill_buf);
-					return -1;
+					goto out;
 				}
-				blk += blks;
-				i += j;
 			}
+
+			fill_val = *(uint32_t *)data;
+			data = (char *)data + sizeof(uint32_t);
+
+			for (i = 0;
+			     i < FILL_BUF_SIZE / sizeof(fill_val);
+			     i++)
+				w.fill_buf[i] = fill_val;
+
+			if (sparse_fill(&w, &blk, blkcnt, fill_val))
+				goto out;
+
 			bytes_written += ((u64)blkcnt) * info->blksz;
 			total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
 							 sparse_header->blk_sz);
-			free(fill_buf);
 			break;
 
 		case CHUNK_TYPE_DONT_CARE:
+			if (sparse_flush(&w, &blk))
+				goto out;
+
+			/* the contents do not matter, so let the device drop them */
+			if (IS_ENABLED(CONFIG_IMAGE_SPARSE_DISCARD) &&
+			    blk + blkcnt <= info->start + info->size) {
+				count = sparse_erase_groups(info, blk, blkcnt,
+							    &head);
+				if (count)
+					sparse_erase(&w, blk + head, count);
+			}
+
 			blk += info->reserve(info, blk, blkcnt);
 			total_blocks += chunk_header->chunk_sz;
 			break;
@@ -292,28 +419,42 @@ int write_sparse_image(struct sparse_storage *info,
 			    sparse_header->chunk_hdr_sz + sizeof(uint32_t)) {
 				info->mssg("Bogus chunk size for chunk type CRC32",
 					   response);
-				return -1;
+				goto out;
 			}
 			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
+			data += sizeof(uint32_t);
 			break;
 
 		default:
 			printf("%s: Unknown chunk type: %x\n", __func__,
 			       chunk_header->chunk_type);
 			info->mssg("Unknown chunk type", response);
-			return -1;
+			goto out;
 		}
 	}
 
+	if (sparse_flush(&w, &blk))
+		goto out;
+
+	time_us = timer_get_us() - start_us;
+	/* bytes per microsecond is MB/s; show it to one decimal place */
+	rate = time_us ? div64_u64(bytes_written * 10, time_us) : 0;
 	debug("Wrote %d blocks, expected to write %d blocks\n",
 	      total_blocks, sparse_header->total_blks);
 	printf("........ wrote %llu bytes to '%s'\n", bytes_written, part_name);
+	printf("........ took %lu ms (%lu.%lu MB/s): %lu ms writing, %lu ms erasing %llu bytes\n",
+	       time_us / 1000, rate / 10, rate % 10, w.write_us / 1000,
+	       w.erase_us / 1000, (u64)w.erased * info->blksz);
 
 	if (total_blocks != sparse_header->total_blks) {
 		info->mssg("sparse image write failure", response);
-		return -1;
+		goto out;
 	}
+	ret = 0;
 
-	return 0;
+out:
+	free(w.fill_buf);
+	free(w.buf);
+
+	return ret;
 }
@@ -14,9 +14,12 @@
 #include "avb_util.h"
 #include "avb_vbmeta_image.h"
 #include "avb_version.h"
+#include <hash.h>
+#include <image.h>
 #include <log.h>
 #include <malloc.h>
 #include <memalign.h>
+#include <u-boot/hash-checksum.h>
 #if defined(CONFIG_IMX_TRUSTY_OS) && !defined(CONFIG_IMX9)
 #include "trusty/hwcrypto.h"
 #endif
@@ -280,6 +283,31 @@ static AvbSlotVerifyResult initialize_persistent_digest(
   return ret;
 }
 
+/* Hashes the salt followed by the image through the U-Boot hash API, which
+ * uses a hash driver for large images if there is one. Returns false if the
+ * algorithm is not available there, so that the caller uses libavb's own.
+ */
+static bool hash_salted_image(const char* algorithm,
+                              const uint8_t* salt,
+                              size_t salt_len,
+                              const uint8_t* image,
+                              size_t image_len,
+                              uint8_t* digest) {
+#if CONFIG_IS_ENABLED(HASH)
+  struct image_region region[2] = {
+      {salt, salt_len},
+      {image, image_len},
+  };
+
+  if (image_len > INT_MAX) {
+    return false;
+  }
+  return hash_calculate(algorithm, region, 2, digest) == 0;
+#else
+  return false;
+#endif
+}
+
 static AvbSlotVerifyResult load_and_verify_hash_partition(
     AvbOps* ops,
     const char* const* requested_partitions,
@@ -297,6 +325,7 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
   uint8_t* image_buf = NULL;
   bool image_preloaded = false;
   uint8_t* digest;
+  uint8_t hash_digest[AVB_SHA512_DIGEST_SIZE];
   size_t digest_len;
   const char* found = NULL;
   uint64_t image_size;
@@ -435,17 +464,35 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
 
     digest = hash_out;
 #else
-    avb_sha256_init(&sha256_ctx);
-    avb_sha256_update(&sha256_ctx, desc_salt, hash_desc.salt_len);
-    avb_sha256_update(&sha256_ctx, image_buf, image_size_to_hash);
-    digest = avb_sha256_final(&sha256_ctx);
+    if (hash_salted_image("sha256",
+                          desc_salt,
+                          hash_desc.salt_len,
+                          image_buf,
+                          image_size_to_hash,
+                          hash_digest)) {
+      digest = hash_digest;
+    } else {
+      avb_sha256_init(&sha256_ctx);
+      avb_sha256_update(&sha256_ctx, desc_salt, hash_desc.salt_len);
+      avb_sha256_update(&sha256_ctx, image_buf, image_size_to_hash);
+      digest = avb_sha256_final(&sha256_ctx);
+    }
 #endif
     digest_len = AVB_SHA256_DIGEST_SIZE;
   } else if (avb_strcmp((const char*)hash_desc.hash_algorithm, "sha512") == 0) {
-    avb_sha512_init(&sha512_ctx);
-    avb_sha512_update(&sha512_ctx, desc_salt, hash_desc.salt_len);
-    avb_sha512_update(&sha512_ctx, image_buf, image_size_to_hash);
-    digest = avb_sha512_final(&sha512_ctx);
+    if (hash_salted_image("sha512",
+                          desc_salt,
+                          hash_desc.salt_len,
+                          image_buf,
+                          image_size_to_hash,
+                          hash_digest)) {
+      digest = hash_digest;
+    } else {
+      avb_sha512_init(&sha512_ctx);
+      avb_sha512_update(&sha512_ctx, desc_salt, hash_desc.salt_len);
+      avb_sha512_update(&sha512_ctx, image_buf, image_size_to_hash);
+      digest = avb_sha512_final(&sha512_ctx);
+    }
     digest_len = AVB_SHA512_DIGEST_SIZE;
   } else {
     avb_errorv(part_name, ": Unsupported hash algorithm.\n", NULL);
@@ -5,7 +5,9 @@
  */
 
 #include <compiler.h>
+#include <decomp_stream.h>
 #include <image.h>
+#include <malloc.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <asm/unaligned.h>
@@ -81,7 +83,8 @@ __rcode int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 
 		if (block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
 			size_t size = min((ptrdiff_t)block_size, (ptrdiff_t)(end - out));
-			memcpy(out, in, size);
+			/* the block overlaps its output if decompressing in place */
+			memmove(out, in, size);
 			out += size;
 			if (size < block_size) {
 				ret = -ENOBUFS;	/* output overrun */
@@ -179,3 +182,291 @@ __rcode int ulz4fn_auto(const void *src, size_t srcn, void *dst, size_t *dstn)
 		return -EPROTONOSUPPORT;
 	}
 }
+
+int ulz4fn_inplace_margin(const void *src, size_t srcn, size_t *dstnp,
+			  size_t *marginp)
+{
+	const u8 *in = src;
+	u8 flags, block_desc;
+	u64 size, blocks;
+	int shift;
+
+	if (srcn < 15 || get_unaligned_le32(in) != LZ4F_MAGIC)
+		return -EPROTONOSUPPORT;
+	flags = in[4];
+	block_desc = in[5];
+	if ((flags >> 6) != 1 || !(flags & 0x20))
+		return -EPROTONOSUPPORT;
+	if ((block_desc >> 4) < 4)
+		return -EINVAL;
+	if (!(flags & 0x08))
+		return -ENODATA;
+	size = get_unaligned_le64(in + 6);
+	if (size != (size_t)size)
+		return -EFBIG;
+
+	shift = 2 * (block_desc >> 4) + 8;
+	blocks = (size + (1 << shift) - 1) >> shift;
+
+	/*
+	 * A compressed block grows by at most 1/256 and the decoder writes up
+	 * to 32 bytes ahead, as LZ4_DECOMPRESS_INPLACE_MARGIN() in lz4.h.
+	 * Add the frame header and end mark, and a header and checksum for
+	 * each block, which may also be stored uncompressed.
+	 */
+	*dstnp = size;
+	*marginp = (srcn >> 8) + 32 + 15 + 8 + blocks * 8;
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(DECOMP_STREAM)
+enum lz4_stream_state {
+	LZ4S_FRAME,	/* frame header */
+	LZ4S_BLOCK_HDR,	/* block header */
+	LZ4S_BLOCK,	/* block data */
+	LZ4S_CHECKSUM,	/* block checksum, which is not checked */
+	LZ4S_END,	/* content checksum, which is not checked */
+};
+
+/**
+ * struct lz4_stream - state of a streaming lz4 decompression
+ *
+ * Only the frame format with independent blocks is supported, as with
+ * ulz4fn(). Blocks are decompressed straight from the input if they are
+ * complete, otherwise they are collected in @buf first.
+ *
+ * @state: Part of the frame expected next
+ * @hdr: Frame or block header collected so far
+ * @hdr_len: Number of bytes in @hdr
+ * @hdr_size: Size of the frame header, once known
+ * @has_block_checksum: true if each block is followed by a checksum
+ * @has_content_checksum: true if the end mark is followed by a checksum
+ * @max_block: Maximum block size from the frame header
+ * @block_header: Header of the current block
+ * @block_size: Size of the current block
+ * @buf: Buffer for a block which is split between calls
+ * @buf_len: Number of bytes in @buf
+ * @skip: Bytes of checksum left to skip
+ * @held: Window mode: a decompressed block which may not fit in the output
+ * @held_pos: Number of bytes of @held already copied out
+ * @held_len: Number of bytes of @held still to copy out
+ */
+struct lz4_stream {
+	enum lz4_stream_state state;
+	u8 hdr[15];
+	int hdr_len;
+	int hdr_size;
+	bool has_block_checksum;
+	bool has_content_checksum;
+	u32 max_block;
+	u32 block_header;
+	u32 block_size;
+	u8 *buf;
+	u32 buf_len;
+	u32 skip;
+	u8 *held;
+	u32 held_pos;
+	u32 held_len;
+};
+
+static int lz4_stream_frame(struct lz4_stream *lz)
+{
+	u8 flags = lz->hdr[4], block_desc = lz->hdr[5];
+
+	if (get_unaligned_le32(lz->hdr) != LZ4F_MAGIC || (flags >> 6) != 1)
+		return -EPROTONOSUPPORT;
+	if ((flags & 0x03) || (block_desc & 0x8f))
+		return -EINVAL;
+	if (!(flags & 0x20))
+		return -EPROTONOSUPPORT;
+	if ((block_desc >> 4) < 4)
+		return -EINVAL;
+	lz->has_block_checksum = flags & 0x10;
+	lz->has_content_checksum = flags & 0x04;
+	lz->hdr_size = flags & 0x08 ? 15 : 7;
+	lz->max_block = 1 << (2 * (block_desc >> 4) + 8);
+
+	return 0;
+}
+
+static int lz4_stream_block(struct decomp_stream *ds, const u8 *in)
+{
+	struct lz4_stream *lz = ds->priv;
+	ulong avail = ds->out_size - ds->out_len;
+	bool raw = lz->block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	u8 *out = ds->out + ds->out_len;
+	int ret;
+
+	/* in window mode, hold a block which may not fit until there is room */
+	if (ds->window && avail < (raw ? lz->block_size : lz->max_block)) {
+		if (!lz->held) {
+			lz->held = malloc(lz->max_block);
+			if (!lz->held)
+				return -ENOMEM;
+		}
+		out = lz->held;
+		avail = lz->max_block;
+	}
+
+	if (raw) {
+		if (lz->block_size > avail)
+			return -ENOSPC;
+		memcpy(out, in, lz->block_size);
+		ret = lz->block_size;
+	} else {
+		/* a short buffer cannot be told apart from corrupt data */
+		ret = LZ4_decompress_safe((const char *)in, (char *)out,
+					  lz->block_size, avail);
+		if (ret < 0)
+			return -EPROTO;
+	}
+	if (out == lz->held) {
+		lz->held_pos = 0;
+		lz->held_len = ret;
+	} else {
+		ds->out_len += ret;
+	}
+	if (lz->has_block_checksum) {
+		lz->skip = sizeof(u32);
+		lz->state = LZ4S_CHECKSUM;
+	} else {
+		lz->state = LZ4S_BLOCK_HDR;
+	}
+
+	return 0;
+}
+
+static int lz4_stream_init(struct decomp_stream *ds)
+{
+	struct lz4_stream *lz;
+
+	lz = calloc(1, sizeof(*lz));
+	if (!lz)
+		return -ENOMEM;
+	lz->hdr_size = 6;
+	ds->priv = lz;
+
+	return 0;
+}
+
+static int lz4_stream_feed(struct decomp_stream *ds, const void *in, ulong len)
+{
+	struct lz4_stream *lz = ds->priv;
+	const u8 *end = in + len;
+	const u8 *ptr = in;
+	ulong n;
+	int ret;
+
+	for (;;) {
+		if (lz->held_len) {
+			n = min_t(ulong, lz->held_len,
+				  ds->out_size - ds->out_len);
+			memcpy(ds->out + ds->out_len, lz->held + lz->held_pos,
+			       n);
+			ds->out_len += n;
+			lz->held_pos += n;
+			lz->held_len -= n;
+			if (lz->held_len) {
+				ds->in_used = ptr - (const u8 *)in;
+				return 0;
+			}
+		}
+		if (ptr == end)
+			break;
+
+		switch (lz->state) {
+		case LZ4S_FRAME:
+			lz->hdr[lz->hdr_len++] = *ptr++;
+			if (lz->hdr_len == 6) {
+				ret = lz4_stream_frame(lz);
+				if (ret)
+					return ret;
+			}
+			if (lz->hdr_len == lz->hdr_size) {
+				lz->hdr_len = 0;
+				lz->state = LZ4S_BLOCK_HDR;
+			}
+			break;
+		case LZ4S_BLOCK_HDR:
+			lz->hdr[lz->hdr_len++] = *ptr++;
+			if (lz->hdr_len < sizeof(u32))
+				break;
+			lz->hdr_len = 0;
+			lz->block_header = get_unaligned_le32(lz->hdr);
+			lz->block_size = lz->block_header &
+				~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+			if (!lz->block_size && lz->has_content_checksum) {
+				lz->skip = sizeof(u32);
+				lz->state = LZ4S_END;
+				break;
+			}
+			if (!lz->block_size) {
+				ds->done = true;
+				ds->in_used = ptr - (const u8 *)in;
+				return 0;
+			}
+			if (lz->block_size > lz->max_block)
+				return -EINVAL;
+			lz->state = LZ4S_BLOCK;
+			break;
+		case LZ4S_BLOCK:
+			if (!lz->buf_len && end - ptr >= lz->block_size) {
+				ret = lz4_stream_block(ds, ptr);
+				if (ret)
+					return ret;
+				ptr += lz->block_size;
+				break;
+			}
+			if (!lz->buf) {
+				lz->buf = malloc(lz->max_block);
+				if (!lz->buf)
+					return -ENOMEM;
+			}
+			n = min_t(ulong, lz->block_size - lz->buf_len, end - ptr);
+			memcpy(lz->buf + lz->buf_len, ptr, n);
+			lz->buf_len += n;
+			ptr += n;
+			if (lz->buf_len == lz->block_size) {
+				lz->buf_len = 0;
+				ret = lz4_stream_block(ds, lz->buf);
+				if (ret)
+					return ret;
+			}
+			break;
+		case LZ4S_CHECKSUM:
+		case LZ4S_END:
+			n = min_t(ulong, lz->skip, end - ptr);
+			ptr += n;
+			lz->skip -= n;
+			if (lz->skip)
+				break;
+			if (lz->state == LZ4S_END) {
+				ds->done = true;
+				ds->in_used = ptr - (const u8 *)in;
+				return 0;
+			}
+			lz->state = LZ4S_BLOCK_HDR;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void lz4_stream_free(struct decomp_stream *ds)
+{
+	struct lz4_stream *lz = ds->priv;
+
+	free(lz->held);
+	free(lz->buf);
+	free(lz);
+}
+
+const struct decomp_stream_ops lz4_stream_ops = {
+	.window	= true,
+	.init	= lz4_stream_init,
+	.feed	= lz4_stream_feed,
+	.free	= lz4_stream_free,
+};
+#endif
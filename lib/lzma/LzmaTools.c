@@ -30,8 +30,12 @@
 #include "LzmaTools.h"
 #include "LzmaDec.h"
 
-#include <linux/string.h>
+#include <decomp_stream.h>
 #include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
 
 static void *SzAlloc(void *p, size_t size) { return malloc(size); }
 static void SzFree(void *p, void *address) { free(address); }
@@ -120,4 +124,119 @@ int lzmaBuffToBuffDecompress(unsigned char *outStream, SizeT *uncompressedSize,
     return res;
 }
 
+#if CONFIG_IS_ENABLED(DECOMP_STREAM)
+/**
+ * struct lzma_stream - state of a streaming LZMA decompression
+ *
+ * @dec: LZMA decoder, with the destination buffer as its dictionary
+ * @hdr: Header collected so far (properties and uncompressed size)
+ * @hdr_len: Number of bytes in @hdr
+ * @limit: Number of bytes to decompress: the uncompressed size from the
+ *	header or the size of the destination buffer if unknown
+ * @known: true if the header gives the uncompressed size
+ */
+struct lzma_stream {
+	CLzmaDec dec;
+	u8 hdr[LZMA_DATA_OFFSET];
+	int hdr_len;
+	SizeT limit;
+	bool known;
+};
+
+static ISzAlloc lzma_stream_alloc = { SzAlloc, SzFree };
+
+static int lzma_stream_init(struct decomp_stream *ds)
+{
+	struct lzma_stream *lz;
+
+	lz = calloc(1, sizeof(*lz));
+	if (!lz)
+		return -ENOMEM;
+	LzmaDec_Construct(&lz->dec);
+	ds->priv = lz;
+
+	return 0;
+}
+
+static int lzma_stream_start(struct decomp_stream *ds)
+{
+	struct lzma_stream *lz = ds->priv;
+	u64 size = get_unaligned_le64(lz->hdr + LZMA_SIZE_OFFSET);
+
+	lz->known = size != -1ULL;
+	if (lz->known && size > ds->out_size)
+		return -ENOSPC;
+	lz->limit = lz->known ? size : ds->out_size;
+	if (LzmaDec_AllocateProbs(&lz->dec, lz->hdr, LZMA_PROPS_SIZE,
+				  &lzma_stream_alloc) != SZ_OK)
+		return -EINVAL;
+	lz->dec.dic = ds->out;
+	lz->dec.dicBufSize = ds->out_size;
+	LzmaDec_Init(&lz->dec);
+
+	return 0;
+}
+
+static int lzma_stream_feed(struct decomp_stream *ds, const void *in, ulong len)
+{
+	struct lzma_stream *lz = ds->priv;
+	ELzmaStatus status;
+	SizeT src_len;
+	int n, ret;
+	SRes res;
+
+	if (lz->hdr_len < LZMA_DATA_OFFSET) {
+		n = min_t(ulong, LZMA_DATA_OFFSET - lz->hdr_len, len);
+		memcpy(lz->hdr + lz->hdr_len, in, n);
+		lz->hdr_len += n;
+		in += n;
+		len -= n;
+		if (lz->hdr_len < LZMA_DATA_OFFSET)
+			return 0;
+		ret = lzma_stream_start(ds);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * With LZMA_FINISH_END the decoder looks for the end mark once the
+	 * output buffer is full, so an exactly-sized buffer is enough
+	 */
+	while (len) {
+		src_len = len;
+		res = LzmaDec_DecodeToDic(&lz->dec, lz->limit, in, &src_len,
+					  LZMA_FINISH_END, &status);
+		ds->out_len = lz->dec.dicPos;
+		if (status == LZMA_STATUS_FINISHED_WITH_MARK ||
+		    (lz->known && ds->out_len == lz->limit)) {
+			ds->done = true;
+			return 0;
+		}
+		if (ds->out_len == lz->limit &&
+		    (res != SZ_OK || status != LZMA_STATUS_NEEDS_MORE_INPUT))
+			return -ENOSPC;
+		if (res != SZ_OK)
+			return -EBADMSG;
+		in += src_len;
+		len -= src_len;
+	}
+
+	return 0;
+}
+
+static void lzma_stream_free(struct decomp_stream *ds)
+{
+	struct lzma_stream *lz = ds->priv;
+
+	LzmaDec_FreeProbs(&lz->dec, &lzma_stream_alloc);
+	free(lz);
+}
+
+const struct decomp_stream_ops lzma_stream_ops = {
+	.init	= lzma_stream_init,
+	.feed	= lzma_stream_feed,
+	.free	= lzma_stream_free,
+};
+#endif
+
 #endif
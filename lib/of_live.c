@@ -35,6 +35,105 @@ static void *unflatten_dt_alloc(void **mem, unsigned long size,
 	return res;
 }
 
+/**
+ * unflatten_dt_size() - Work out the memory needed to unflatten a node
+ *
+ * This makes the same allocations as unflatten_dt_node() for the node and all
+ * its subnodes, in the same order, so that the total is exact. It only walks
+ * the tags in the structure block and writes nothing, so is much quicker than
+ * unflattening the tree.
+ *
+ * @blob: The parent device tree blob
+ * @mem: Memory used so far, as an offset from NULL
+ * @poffset: Offset of the node in the flat tree. Updated to the offset after
+ *	the end of the node
+ * @fpsize: Size of the node path up at the current depth
+ * Return: memory used after the node, as an offset from NULL, or NULL on error
+ */
+static void *unflatten_dt_size(const void *blob, void *mem, int *poffset,
+			       unsigned long fpsize)
+{
+	const struct fdt_property *prop;
+	const char *pathp, *pname;
+	bool has_name, props_done = false;
+	int offset, next, l;
+	unsigned int allocl;
+	uint32_t tag;
+
+	pathp = fdt_get_name(blob, *poffset, &l);
+	if (!pathp)
+		return NULL;
+	allocl = ++l;
+	has_name = *pathp != '/';
+	if (has_name) {
+		if (fpsize == 0) {
+			fpsize = 1;
+			allocl = 2;
+		} else {
+			fpsize += l;
+			allocl = fpsize;
+		}
+	}
+	unflatten_dt_alloc(&mem, sizeof(struct device_node) + allocl,
+			   __alignof__(struct device_node));
+
+	fdt_next_tag(blob, *poffset, &next);
+	for (;;) {
+		offset = next;
+		tag = fdt_next_tag(blob, offset, &next);
+		if (!props_done && tag != FDT_PROP && tag != FDT_NOP) {
+			props_done = true;
+			if (!has_name) {
+				const char *p1 = pathp, *ps = pathp, *pa = NULL;
+
+				/* the "name" property unflatten_dt_node() adds */
+				for (; *p1; p1++) {
+					if (*p1 == '@')
+						pa = p1;
+					if (*p1 == '/')
+						ps = p1 + 1;
+				}
+				if (pa < ps)
+					pa = p1;
+				unflatten_dt_alloc(&mem, sizeof(struct property) +
+						   (pa - ps) + 1,
+						   __alignof__(struct property));
+			}
+		}
+
+		switch (tag) {
+		case FDT_PROP:
+			prop = fdt_offset_ptr(blob, offset, sizeof(*prop));
+			if (!prop)
+				return NULL;
+			if (!has_name) {
+				pname = fdt_string(blob,
+						   fdt32_to_cpu(prop->nameoff));
+				if (pname && !strcmp(pname, "name"))
+					has_name = true;
+			}
+			unflatten_dt_alloc(&mem, sizeof(struct property),
+					   __alignof__(struct property));
+			break;
+		case FDT_BEGIN_NODE:
+			*poffset = offset;
+			mem = unflatten_dt_size(blob, mem, poffset, fpsize);
+			if (!mem)
+				return NULL;
+			next = *poffset;
+			break;
+		case FDT_END_NODE:
+			*poffset = next;
+			return mem;
+		case FDT_NOP:
+			break;
+		default:
+			debug("unflatten: bad tag %x at %d\n", tag, offset);
+			return NULL;
+		}
+	}
+}
+
 /**
  * unflatten_dt_node() - Alloc and populate a device_node from the flat tree
  * @blob: The parent device tree blob
@@ -43,19 +142,22 @@ static void *unflatten_dt_alloc(void **mem, unsigned long size,
  * @dad: Parent struct device_node
  * @nodepp: The device_node tree created by the call
  * @fpsize: Size of the node path up at t05he current depth.
- * @dryrun: If true, do not allocate device nodes but still calculate needed
- * memory size
+ *
+ * Property names and values are not copied: they point into @blob, which must
+ * stay in place for as long as the live tree is used. @mem must be large
+ * enough for the whole tree (see unflatten_dt_size()) and zeroed.
  */
 static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 			       struct device_node *dad,
 			       struct device_node **nodepp,
-			       unsigned long fpsize, bool dryrun)
+			       unsigned long fpsize)
 {
 	const __be32 *p;
 	struct device_node *np;
 	struct property *pp, **prev_pp = NULL;
 	const char *pathp;
-	int l;
+	char *fn;
+	int l, len;
 	unsigned int allocl;
 	static int depth;
 	int old_depth;
@@ -100,38 +202,28 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 
 	np = unflatten_dt_alloc(&mem, sizeof(struct device_node) + allocl,
 				__alignof__(struct device_node));
-	if (!dryrun) {
-		char *fn;
-
-		fn = (char *)np + sizeof(*np);
-		if (new_format) {
-			np->name = pathp;
-			has_name = 1;
-		}
-		np->full_name = fn;
-		if (new_format) {
-			/* rebuild full path for new format */
-			if (dad && dad->parent) {
-				strcpy(fn, dad->full_name);
-#ifdef DEBUG
-				if ((strlen(fn) + l + 1) != allocl) {
-					debug("%s: p: %d, l: %d, a: %d\n",
-					      pathp, (int)strlen(fn), l,
-					      allocl);
-				}
-#endif
-				fn += strlen(fn);
-			}
-			*(fn++) = '/';
+	fn = (char *)np + sizeof(*np);
+	if (new_format) {
+		np->name = pathp;
+		has_name = 1;
+	}
+	np->full_name = fn;
+	if (new_format) {
+		/* rebuild full path for new format */
+		if (dad && dad->parent) {
+			len = fpsize - l - 1;
+			memcpy(fn, dad->full_name, len);
+			fn += len;
 		}
-		memcpy(fn, pathp, l);
+		*(fn++) = '/';
+	}
+	memcpy(fn, pathp, l);
 
-		prev_pp = &np->properties;
-		if (dad != NULL) {
-			np->parent = dad;
-			np->sibling = dad->child;
-			dad->child = np;
-		}
+	prev_pp = &np->properties;
+	if (dad != NULL) {
+		np->parent = dad;
+		np->sibling = dad->child;
+		dad->child = np;
 	}
 	/* process properties */
 	for (offset = fdt_first_property_offset(blob, *poffset);
@@ -154,30 +246,32 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 			has_name = 1;
 		pp = unflatten_dt_alloc(&mem, sizeof(struct property),
 					__alignof__(struct property));
-		if (!dryrun) {
-			/*
-			 * We accept flattened tree phandles either in
-			 * ePAPR-style "phandle" properties, or the
-			 * legacy "linux,phandle" properties.  If both
-			 * appear and have different values, things
-			 * will get weird.  Don't do that. */
-			if ((strcmp(pname, "phandle") == 0) ||
-			    (strcmp(pname, "linux,phandle") == 0)) {
+		/*
+		 * We accept flattened tree phandles either in ePAPR-style
+		 * "phandle" properties, or the legacy "linux,phandle"
+		 * properties.  If both appear and have different values,
+		 * things will get weird.  Don't do that. We also process the
+		 * "ibm,phandle" property used in pSeries dynamic device tree
+		 * stuff. A phandle is a single cell, so only look at the name
+		 * of properties of that size.
+		 */
+		if (sz == sizeof(__be32)) {
+			if (!strcmp(pname, "phandle") ||
+			    !strcmp(pname, "linux,phandle")) {
 				if (np->phandle == 0)
 					np->phandle = be32_to_cpup(p);
-			}
-			/*
-			 * And we process the "ibm,phandle" property
-			 * used in pSeries dynamic device tree
-			 * stuff */
-			if (strcmp(pname, "ibm,phandle") == 0)
+			} else if (!strcmp(pname, "ibm,phandle")) {
 				np->phandle = be32_to_cpup(p);
-			pp->name = (char *)pname;
-			pp->length = sz;
-			pp->value = (__be32 *)p;
-			*prev_pp = pp;
-			prev_pp = &pp->next;
+			}
 		}
+		/* save looking this up in the property list later */
+		if (!np->type && !strcmp(pname, "device_type"))
+			np->type = (const char *)p;
+		pp->name = (char *)pname;
+		pp->length = sz;
+		pp->value = (__be32 *)p;
+		*prev_pp = pp;
+		prev_pp = &pp->next;
 	}
 	/*
 	 * with version 0x10 we may not have the name property, recreate
@@ -199,36 +293,31 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 		sz = (pa - ps) + 1;
 		pp = unflatten_dt_alloc(&mem, sizeof(struct property) + sz,
 					__alignof__(struct property));
-		if (!dryrun) {
-			pp->name = "name";
-			pp->length = sz;
-			pp->value = pp + 1;
-			*prev_pp = pp;
-			prev_pp = &pp->next;
-			memcpy(pp->value, ps, sz - 1);
-			((char *)pp->value)[sz - 1] = 0;
-			debug("fixed up name for %s -> %s\n", pathp,
-			      (char *)pp->value);
-		}
+		pp->name = "name";
+		pp->length = sz;
+		pp->value = pp + 1;
+		*prev_pp = pp;
+		prev_pp = &pp->next;
+		memcpy(pp->value, ps, sz - 1);
+		((char *)pp->value)[sz - 1] = 0;
+		debug("fixed up name for %s -> %s\n", pathp,
+		      (char *)pp->value);
 	}
-	if (!dryrun) {
-		*prev_pp = NULL;
-		if (!has_name)
-			np->name = of_get_property(np, "name", NULL);
-		np->type = of_get_property(np, "device_type", NULL);
+	*prev_pp = NULL;
+	if (!has_name)
+		np->name = of_get_property(np, "name", NULL);
 
-		if (!np->name)
-			np->name = "<NULL>";
-		if (!np->type)
-			np->type = "<NULL>";	}
+	if (!np->name)
+		np->name = "<NULL>";
+	if (!np->type)
+		np->type = "<NULL>";
 
 	old_depth = depth;
 	*poffset = fdt_next_node(blob, *poffset, &depth);
 	if (depth < 0)
 		depth = 0;
 	while (*poffset > 0 && depth > old_depth) {
-		mem = unflatten_dt_node(blob, mem, poffset, np, NULL,
-					fpsize, dryrun);
+		mem = unflatten_dt_node(blob, mem, poffset, np, NULL, fpsize);
 		if (!mem)
 			return NULL;
 	}
@@ -242,7 +331,7 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 	 * Reverse the child list. Some drivers assumes node order matches .dts
 	 * node order
 	 */
-	if (!dryrun && np->child) {
+	if (np->child) {
 		struct device_node *child = np->child;
 		np->child = NULL;
 		while (child) {
@@ -283,10 +372,9 @@ int unflatten_device_tree(const void *blob, struct device_node **mynodes)
 		return -EINVAL;
 	}
 
-	/* First pass, scan for size */
+	/* Work out the size, without building anything */
 	start = 0;
-	size = (unsigned long)unflatten_dt_node(blob, NULL, &start, NULL, NULL,
-						0, true);
+	size = (unsigned long)unflatten_dt_size(blob, NULL, &start, 0);
 	if (!size)
 		return -EFAULT;
 	size = ALIGN(size, 4);
@@ -295,6 +383,8 @@ int unflatten_device_tree(const void *blob, struct device_node **mynodes)
 
 	/* Allocate memory for the expanded device tree */
 	mem = memalign(__alignof__(struct device_node), size + 4);
+	if (!mem)
+		return -ENOMEM;
 	memset(mem, '\0', size);
 
 	/* Set up value for dm_test_livetree_align() */
@@ -306,7 +396,7 @@ int unflatten_device_tree(const void *blob, struct device_node **mynodes)
 
 	/* Second pass, do actual unflattening */
 	start = 0;
-	unflatten_dt_node(blob, mem, &start, NULL, mynodes, 0, false);
+	unflatten_dt_node(blob, mem, &start, NULL, mynodes, 0);
 	if (be32_to_cpup(mem + size) != 0xdeadbeef) {
 		debug("End of tree marker overwritten: %08x\n",
 		      be32_to_cpup(mem + size));
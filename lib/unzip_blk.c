@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompressing an image straight to a block device
+ *
+ * The streaming decompressors fill one buffer at a time in window mode,
+ * keeping their own history, so that images much larger than memory can be
+ * written.
+ */
+
+#include <blk.h>
+#include <console.h>
+#include <decomp_stream.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <time.h>
+#include <unzip_blk.h>
+#include <watchdog.h>
+#include <asm/unaligned.h>
+#include <linux/string.h>
+#include <u-boot/crc.h>
+
+bool unzip_blk_supported(int comp)
+{
+	return decomp_stream_window_supported(comp);
+}
+
+/* Check the CRC and size in the gzip trailer, which follows the data used */
+static int unzip_blk_gzip_trailer(const u8 *trailer, ulong len, u32 crc,
+				  u64 size)
+{
+	if (len < 8) {
+		log_err("gzip trailer is missing\n");
+		return -EBADMSG;
+	}
+	if (get_unaligned_le32(trailer) != crc ||
+	    get_unaligned_le32(trailer + 4) != (u32)size) {
+		log_err("gzip CRC or size is wrong\n");
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/* Wait for a buffer to be written */
+static int unzip_blk_wait(struct blk_desc *desc, struct blk_req *req)
+{
+	long ret;
+
+	ret = blk_wait(desc->bdev, req);
+	if (ret != req->blkcnt) {
+		log_err("write of %lx blocks at %lx failed (%ld)\n",
+			(ulong)req->blkcnt, (ulong)req->start, ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int unzip_blk(int comp, const void *src, ulong len, struct blk_desc *desc,
+	      ulong bufsize, lbaint_t start, uint flags,
+	      struct unzip_blk_stats *stats)
+{
+	struct blk_req req[2];
+	bool busy[2] = { false, false };
+	struct decomp_stream ds;
+	lbaint_t blk = start, count;
+	ulong start_us, filled, pos = 0;
+	u32 crc = 0;
+	u8 *buf[2];
+	int cur, ret, i;
+	long used;
+
+	memset(stats, '\0', sizeof(*stats));
+	if (!unzip_blk_supported(comp))
+		return -EPROTONOSUPPORT;
+	if (!bufsize || bufsize % desc->blksz)
+		return -EINVAL;
+
+	start_us = timer_get_us();
+	buf[0] = malloc_cache_aligned(bufsize);
+	buf[1] = malloc_cache_aligned(bufsize);
+	if (!buf[0] || !buf[1]) {
+		ret = -ENOMEM;
+		goto err_buf;
+	}
+	ret = decomp_stream_init_window(&ds, comp);
+	if (ret)
+		goto err_buf;
+
+	for (cur = 0; !ds.done; cur ^= 1) {
+		/* this buffer is free once its last write is complete */
+		if (busy[cur]) {
+			busy[cur] = false;
+			ret = unzip_blk_wait(desc, &req[cur]);
+			if (ret)
+				break;
+		}
+
+		used = decomp_stream_fill(&ds, src + pos, len - pos, buf[cur],
+					  bufsize);
+		if (used < 0) {
+			log_err("%s data is corrupt\n",
+				genimg_get_comp_name(comp));
+			ret = -EBADMSG;
+			break;
+		}
+		pos += used;
+		filled = ds.out_len;
+		if (filled < bufsize && !ds.done) {
+			log_err("%s data is incomplete\n",
+				genimg_get_comp_name(comp));
+			ret = -EBADMSG;
+			break;
+		}
+		if (!filled)
+			break;
+		if (comp == IH_COMP_GZIP)
+			crc = crc32(crc, buf[cur], filled);
+		stats->out_len += filled;
+
+		count = DIV_ROUND_UP(filled, desc->blksz);
+		if (blk + count > desc->lba) {
+			log_err("image is too large for the device\n");
+			ret = -ENOSPC;
+			break;
+		}
+		memset(buf[cur] + filled, '\0', count * desc->blksz - filled);
+
+		if ((flags & UNZIP_BLK_ERASE_ZERO) && filled == bufsize &&
+		    !memchr_inv(buf[cur], '\0', bufsize) &&
+		    blk_derase(desc, blk, count) == count) {
+			stats->erased += bufsize;
+		} else {
+			req[cur].write = true;
+			req[cur].start = blk;
+			req[cur].blkcnt = count;
+			req[cur].buffer = buf[cur];
+			ret = blk_submit(desc->bdev, &req[cur]);
+			if (ret)
+				break;
+			busy[cur] = true;
+		}
+		blk += count;
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+		schedule();
+	}
+
+	for (i = 0; i < ARRAY_SIZE(busy); i++) {
+		if (busy[i]) {
+			int r = unzip_blk_wait(desc, &req[i]);
+
+			if (!ret)
+				ret = r;
+		}
+	}
+	if (!ret && comp == IH_COMP_GZIP) {
+		ret = unzip_blk_gzip_trailer(src + pos, len - pos, crc,
+					     stats->out_len);
+		if (!ret)
+			pos += 8;
+	}
+	stats->in_len = pos;
+	decomp_stream_finish(&ds);
+err_buf:
+	free(buf[1]);
+	free(buf[0]);
+	stats->time_us = timer_get_us() - start_us;
+
+	return ret;
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running independent jobs on secondary CPUs
+ */
+
+#include <worker.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+
+/**
+ * struct worker_batch - Jobs run by one CPU
+ *
+ * @jobs:	All jobs
+ * @count:	Number of jobs
+ * @first:	First job for this CPU
+ * @stride:	Number of CPUs, i.e. the step to this CPU's next job
+ */
+struct worker_batch {
+	struct worker_job *jobs;
+	int count;
+	int first;
+	int stride;
+};
+
+static void worker_batch_run(void *priv)
+{
+	struct worker_batch *batch = priv;
+	int i;
+
+	for (i = batch->first; i < batch->count; i += batch->stride)
+		batch->jobs[i].func(batch->jobs[i].priv);
+}
+
+__weak int arch_worker_count(void)
+{
+	return 0;
+}
+
+__weak int arch_worker_start(int cpu, worker_func_t func, void *priv)
+{
+	return -ENOSYS;
+}
+
+__weak void arch_worker_wait(int cpu)
+{
+}
+
+int worker_count(void)
+{
+	return min(arch_worker_count(), CONFIG_WORKER_MAX) + 1;
+}
+
+void worker_run(struct worker_job *jobs, int count)
+{
+	struct worker_batch batch[CONFIG_WORKER_MAX + 1];
+	int cpus, started, cpu;
+
+	if (!count)
+		return;
+	cpus = min(worker_count(), count);
+	for (cpu = 0; cpu < cpus; cpu++) {
+		batch[cpu].jobs = jobs;
+		batch[cpu].count = count;
+		batch[cpu].first = cpu;
+		batch[cpu].stride = cpus;
+	}
+
+	for (started = 1; started < cpus; started++) {
+		if (arch_worker_start(started - 1, worker_batch_run,
+				      &batch[started]))
+			break;
+	}
+
+	/* Do our share, then that of any CPU which could not be started */
+	worker_batch_run(&batch[0]);
+	for (cpu = started; cpu < cpus; cpu++)
+		worker_batch_run(&batch[cpu]);
+
+	for (cpu = 1; cpu < started; cpu++)
+		arch_worker_wait(cpu - 1);
+}
@@ -6,9 +6,11 @@
 #define LOG_CATEGORY	LOGC_BOOT
 
 #include <abuf.h>
+#include <decomp_stream.h>
 #include <log.h>
 #include <malloc.h>
 #include <linux/errno.h>
+#include <linux/math64.h>
 #include <linux/zstd.h>
 
 int zstd_decompress(struct abuf *in, struct abuf *out)
@@ -59,3 +61,230 @@ do_free:
 	free(workspace);
 	return ret;
 }
+
+int zstd_inplace_margin(const void *src, size_t srcn, size_t *dstnp,
+			size_t *marginp)
+{
+	zstd_frame_header fh;
+	u64 blocks;
+	size_t ret;
+
+	ret = zstd_get_frame_header(&fh, src, srcn);
+	if (ret || fh.frameType != ZSTD_frame)
+		return -EINVAL;
+	if (fh.frameContentSize == ZSTD_CONTENTSIZE_UNKNOWN)
+		return -ENODATA;
+	if (fh.frameContentSize != (size_t)fh.frameContentSize)
+		return -EFBIG;
+
+	/* This is ZSTD_DECOMPRESSION_MARGIN() from later zstd versions */
+	blocks = div_u64(fh.frameContentSize + fh.blockSizeMax - 1,
+			 fh.blockSizeMax);
+	*dstnp = fh.frameContentSize;
+	*marginp = ZSTD_FRAMEHEADERSIZE_MAX + 4 + 3 * blocks + fh.blockSizeMax;
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(DECOMP_STREAM)
+/**
+ * struct zstd_stream - state of a streaming zstd decompression
+ *
+ * @ctx: Decompression context, placed in @workspace
+ * @workspace: Memory for @ctx and its input buffer, in window mode also for
+ *	its window
+ * @hdr: Window mode: start of the input, collected to find the window size
+ * @hdr_len: Number of bytes in @hdr
+ * @hdr_pos: Number of bytes of @hdr passed to the decompressor
+ */
+struct zstd_stream {
+	zstd_dctx *ctx;
+	void *workspace;
+	u8 hdr[ZSTD_FRAMEHEADERSIZE_MAX];
+	ulong hdr_len;
+	ulong hdr_pos;
+};
+
+static int zstd_stream_init(struct decomp_stream *ds)
+{
+	struct zstd_stream *zs;
+	size_t wsize;
+	zstd_dctx *ctx;
+
+	/* in window mode the context is set up once the window size is known */
+	if (ds->window) {
+		zs = calloc(1, sizeof(*zs));
+		if (!zs)
+			return -ENOMEM;
+		ds->priv = zs;
+
+		return 0;
+	}
+
+	/*
+	 * The output buffer is stable between calls, so zstd decodes straight
+	 * into it and only needs room for one input block beyond the context
+	 */
+	wsize = zstd_dctx_workspace_bound() + ZSTD_BLOCKSIZE_MAX + 64;
+	zs = calloc(1, sizeof(*zs));
+	if (!zs)
+		return -ENOMEM;
+	zs->workspace = malloc(wsize);
+	if (!zs->workspace) {
+		free(zs);
+		return -ENOMEM;
+	}
+	ctx = zstd_init_dctx(zs->workspace, wsize);
+	if (!ctx ||
+	    zstd_is_error(ZSTD_DCtx_setParameter(ctx, ZSTD_d_stableOutBuffer,
+						 1)) ||
+	    zstd_is_error(ZSTD_DCtx_setParameter(ctx, ZSTD_d_windowLogMax,
+						 ZSTD_WINDOWLOG_MAX))) {
+		log_err("%s: cannot set up decompression context\n", __func__);
+		free(zs->workspace);
+		free(zs);
+		return -EPERM;
+	}
+	zs->ctx = ctx;
+	ds->priv = zs;
+
+	return 0;
+}
+
+/*
+ * Window mode: set up a context with a window as large as the frame needs,
+ * returning 1 if more of the frame header is needed first
+ */
+static int zstd_stream_window_init(struct zstd_stream *zs)
+{
+	zstd_frame_header fh;
+	size_t ret, wsize;
+
+	ret = zstd_get_frame_header(&fh, zs->hdr, zs->hdr_len);
+	if (zstd_is_error(ret) || (!ret && fh.frameType != ZSTD_frame))
+		return -EINVAL;
+	if (ret)
+		return 1;
+
+	wsize = zstd_dstream_workspace_bound(fh.windowSize);
+	zs->workspace = malloc(wsize);
+	if (!zs->workspace)
+		return -ENOMEM;
+	zs->ctx = zstd_init_dstream(fh.windowSize, zs->workspace, wsize);
+	if (!zs->ctx) {
+		log_err("%s: cannot set up decompression context\n", __func__);
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+/* Window mode: decompress until the output is full or no progress is made */
+static int zstd_stream_window(struct decomp_stream *ds, const void *in,
+			      ulong len, ulong *posp)
+{
+	zstd_in_buffer inb = { .src = in, .size = len, .pos = *posp };
+	zstd_out_buffer outb = {
+		.dst = ds->out, .size = ds->out_size, .pos = ds->out_len,
+	};
+	struct zstd_stream *zs = ds->priv;
+	size_t ret, prev;
+
+	do {
+		prev = outb.pos;
+		ret = zstd_decompress_stream(zs->ctx, &outb, &inb);
+		ds->out_len = outb.pos;
+		*posp = inb.pos;
+		if (zstd_is_error(ret)) {
+			log_err("%s: failed to decompress: %d\n", __func__,
+				zstd_get_error_code(ret));
+			return -EINVAL;
+		}
+		if (!ret) {
+			ds->done = true;
+			break;
+		}
+	} while (outb.pos < outb.size &&
+		 (inb.pos < inb.size || outb.pos > prev));
+
+	return 0;
+}
+
+static int zstd_stream_feed_window(struct decomp_stream *ds, const void *in,
+				   ulong len)
+{
+	struct zstd_stream *zs = ds->priv;
+	ulong pos = 0;
+	int ret;
+
+	if (!zs->ctx) {
+		pos = min_t(ulong, len, sizeof(zs->hdr) - zs->hdr_len);
+		memcpy(zs->hdr + zs->hdr_len, in, pos);
+		zs->hdr_len += pos;
+		ret = zstd_stream_window_init(zs);
+		if (ret)
+			return ret < 0 ? ret : 0;
+	}
+
+	/* the bytes collected to find the window size go first */
+	if (zs->hdr_pos < zs->hdr_len) {
+		ret = zstd_stream_window(ds, zs->hdr, zs->hdr_len,
+					 &zs->hdr_pos);
+		if (ret || ds->done || zs->hdr_pos < zs->hdr_len) {
+			ds->in_used = pos;
+			return ret;
+		}
+	}
+	ret = zstd_stream_window(ds, in, len, &pos);
+	ds->in_used = pos;
+
+	return ret;
+}
+
+static int zstd_stream_feed(struct decomp_stream *ds, const void *in, ulong len)
+{
+	zstd_in_buffer inb = { .src = in, .size = len };
+	zstd_out_buffer outb = {
+		.dst = ds->out, .size = ds->out_size, .pos = ds->out_len,
+	};
+	struct zstd_stream *zs = ds->priv;
+	size_t ret;
+
+	if (ds->window)
+		return zstd_stream_feed_window(ds, in, len);
+
+	while (inb.pos < inb.size) {
+		ret = zstd_decompress_stream(zs->ctx, &outb, &inb);
+		ds->out_len = outb.pos;
+		if (zstd_is_error(ret)) {
+			log_err("%s: failed to decompress: %d\n", __func__,
+				zstd_get_error_code(ret));
+			return zstd_get_error_code(ret) ==
+				ZSTD_error_dstSize_tooSmall ? -ENOSPC : -EINVAL;
+		}
+		if (!ret) {
+			ds->done = true;
+			break;
+		}
+		if (outb.pos == outb.size && inb.pos < inb.size)
+			return -ENOSPC;
+	}
+
+	return 0;
+}
+
+static void zstd_stream_free(struct decomp_stream *ds)
+{
+	struct zstd_stream *zs = ds->priv;
+
+	free(zs->workspace);
+	free(zs);
+}
+
+const struct decomp_stream_ops zstd_stream_ops = {
+	.window	= true,
+	.init	= zstd_stream_init,
+	.feed	= zstd_stream_feed,
+	.free	= zstd_stream_free,
+};
+#endif
@@ -5,11 +5,13 @@
 
 #include <blk.h>
 #include <dm.h>
+#include <os.h>
 #include <part.h>
 #include <sandbox_host.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -334,3 +336,359 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test that the generation number changes when the contents may change */
+static int dm_test_blk_changed(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char buf[DEFAULT_BLKSZ];
+	char fname[256];
+	u32 gen;
+
+	/* Attach a file created in test_ut_dm_init */
+	ut_assertok(os_persistent_file(fname, sizeof(fname), "2MB.ext2.img"));
+	ut_assertok(host_create_attach_file("test", fname, false, DEFAULT_BLKSZ,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+	desc = dev_get_uclass_plat(blk);
+
+	/* Reading leaves the generation alone, writing changes it */
+	gen = desc->gen;
+	ut_asserteq(1, blk_read(blk, 0, 1, buf));
+	ut_asserteq(gen, desc->gen);
+	ut_asserteq(1, blk_write(blk, 0, 1, buf));
+	ut_assert(desc->gen != gen);
+
+	/* A device attached again never reuses a generation */
+	gen = desc->gen;
+	ut_assertok(host_detach_file(dev));
+	ut_assertok(host_create_attach_file("test", fname, false, DEFAULT_BLKSZ,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+	desc = dev_get_uclass_plat(blk);
+	ut_assert(desc->gen != gen);
+	ut_assertok(host_detach_file(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_changed, UTF_SCAN_FDT);
+
+#if IS_ENABLED(CONFIG_BLK_ASYNC)
+/* Test submitting transfers which complete later */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	u8 buf[DEFAULT_BLKSZ * 2], orig[DEFAULT_BLKSZ * 2];
+	struct blk_req req, req2;
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char fname[256];
+	lbaint_t start;
+	u32 gen;
+
+	/* Attach a file created in test_ut_dm_init */
+	ut_assertok(os_persistent_file(fname, sizeof(fname), "2MB.ext2.img"));
+	ut_assertok(host_create_attach_file("test", fname, false, DEFAULT_BLKSZ,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+	desc = dev_get_uclass_plat(blk);
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+
+	/* The host device only carries out requests when polled */
+	start = desc->lba - 2;
+	memset(&req, '\0', sizeof(req));
+	req.start = start;
+	req.blkcnt = 2;
+	req.buffer = orig;
+	ut_assertok(blk_submit(blk, &req));
+	ut_assert(!req.done);
+	ut_asserteq(2, blk_wait(blk, &req));
+	ut_assert(req.done);
+	ut_asserteq(2, blk_read(blk, start, 2, buf));
+	ut_asserteq_mem(orig, buf, sizeof(buf));
+
+	/* Two writes in flight at once, changing the generation */
+	gen = desc->gen;
+	memset(buf, 0x5a, sizeof(buf));
+	req.write = true;
+	req.blkcnt = 1;
+	req.buffer = buf;
+	req2 = req;
+	req2.start = start + 1;
+	req2.buffer = buf + DEFAULT_BLKSZ;
+	ut_assertok(blk_submit(blk, &req));
+	ut_assertok(blk_submit(blk, &req2));
+	ut_assert(desc->gen != gen);
+	ut_assert(!req.done && !req2.done);
+	ut_assertok(blk_poll(blk, &req));
+	ut_assert(req2.done);
+	ut_asserteq(1, blk_wait(blk, &req));
+	ut_asserteq(1, blk_wait(blk, &req2));
+
+	memset(buf, '\0', sizeof(buf));
+	ut_asserteq(2, blk_read(blk, start, 2, buf));
+	ut_asserteq(0x5a, buf[0]);
+	ut_asserteq(0x5a, buf[sizeof(buf) - 1]);
+
+	/* Put the original contents back */
+	ut_asserteq(2, blk_write(blk, start, 2, orig));
+	ut_assertok(blk_flush(blk));
+	ut_assertok(host_detach_file(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UTF_SCAN_FDT);
+#endif
+
+#if IS_ENABLED(CONFIG_BLK_STATS)
+/* Test the I/O statistics kept for each device */
+static int dm_test_blk_stats(struct unit_test_state *uts)
+{
+	u8 buf[DEFAULT_BLKSZ * 4];
+	struct blk_op_stats *st;
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char fname[256];
+	int i, hits;
+
+	/* Attach a file created in test_ut_dm_init */
+	ut_assertok(os_persistent_file(fname, sizeof(fname), "2MB.ext2.img"));
+	ut_assertok(host_create_attach_file("test", fname, false, DEFAULT_BLKSZ,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+	desc = dev_get_uclass_plat(blk);
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_stats_reset(desc);
+
+	/* Reads of 1 and 4 blocks from two places */
+	st = &desc->stats.op[BLK_STATS_READ];
+	ut_asserteq(1, blk_read(blk, 0x100, 1, buf));
+	ut_asserteq(4, blk_read(blk, 0x200, 4, buf));
+	ut_asserteq(2, st->reqs);
+	ut_asserteq(0, st->errors);
+	ut_asserteq(5, st->blocks);
+	ut_asserteq(1, st->size_hist[1]);
+	ut_asserteq(1, st->size_hist[3]);
+	ut_assert(st->max_us <= st->time_us);
+	for (i = 0, hits = 0; i < BLK_STATS_BUCKETS; i++)
+		hits += st->lat_hist[i];
+	ut_asserteq(2, hits);
+
+	/* A second read may come from the cache, without a transfer */
+	hits = desc->stats.cache_hits;
+	ut_asserteq(1, blk_read(blk, 0x100, 1, buf));
+	ut_asserteq(st->reqs + desc->stats.cache_hits - hits, 3);
+
+	/* A read past the end fails */
+	ut_assert(blk_read(blk, desc->lba, 1, buf) != 1);
+	ut_asserteq(1, st->errors);
+
+	/* Writes are counted once they reach the device */
+	ut_asserteq(1, blk_write(blk, 0x100, 1, buf));
+	ut_assertok(blk_flush(blk));
+	ut_asserteq(1, desc->stats.op[BLK_STATS_WRITE].reqs);
+	ut_asserteq(1, desc->stats.op[BLK_STATS_WRITE].blocks);
+
+	blk_stats_reset(desc);
+	ut_asserteq(0, st->reqs);
+	ut_asserteq(0, desc->stats.cache_hits);
+	ut_assertok(host_detach_file(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_stats, UTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+/* Test the block cache, including read-ahead and eviction */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	char buf[DEFAULT_BLKSZ * 2], ref[DEFAULT_BLKSZ * 4];
+	char big[DEFAULT_BLKSZ * 16];
+	struct block_cache_stats stats;
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char fname[256];
+	int i;
+
+	/* Attach a file created in test_ut_dm_init */
+	ut_assertok(os_persistent_file(fname, sizeof(fname), "2MB.ext2.img"));
+	ut_assertok(host_create_attach_file("test", fname, false, DEFAULT_BLKSZ,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_plat(blk);
+
+	/* Get reference data with the cache disabled */
+	blkcache_configure(8, 0, 0);
+	ut_asserteq(4, blk_read(blk, 2, 4, ref));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+
+	/* The second read should come from the cache */
+	blkcache_configure(8, 1, 16);
+	ut_asserteq(2, blk_read(blk, 2, 2, buf));
+	ut_asserteq(2, blk_read(blk, 2, 2, buf));
+	ut_asserteq_mem(ref, buf, sizeof(buf));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(2, stats.entries);
+	ut_asserteq_64(2 * DEFAULT_BLKSZ, stats.bytes_served);
+	ut_asserteq(0, stats.ra_blocks);
+
+	/* Continuing the stream triggers read-ahead of the following blocks */
+	ut_asserteq(2, blk_read(blk, 4, 2, buf));
+	ut_asserteq_mem(ref + 2 * DEFAULT_BLKSZ, buf, sizeof(buf));
+	ut_asserteq(2, blk_read(blk, 6, 2, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(2 + 2 + 16, stats.entries);
+	ut_asserteq(16, stats.ra_blocks);
+	ut_asserteq(2, stats.ra_hits);
+
+	/* The read-ahead data must match what is on the device */
+	memcpy(ref, buf, sizeof(buf));
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	ut_asserteq(2, blk_read(blk, 6, 2, buf));
+	ut_asserteq_mem(ref, buf, sizeof(buf));
+
+	/* A stream of reads too big to cache does not trigger read-ahead */
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blkcache_stats(&stats);
+#if IS_ENABLED(CONFIG_BLK_STATS)
+	blk_stats_reset(desc);
+#endif
+	for (i = 0; i < 4; i++)
+		ut_asserteq(16, blk_read(blk, 0x100 + i * 16, 16, big));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.ra_blocks);
+	ut_asserteq(0, stats.entries);
+#if IS_ENABLED(CONFIG_BLK_STATS)
+	ut_asserteq(4, desc->stats.op[BLK_STATS_READ].reqs);
+	ut_asserteq(4 * 16, desc->stats.op[BLK_STATS_READ].blocks);
+#endif
+
+	/* Overflow the 1MiB cache with non-sequential reads */
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blkcache_configure(8, 1, 0);
+	for (i = 0; i < 1100; i++)
+		ut_asserteq(2, blk_read(blk, i * 3, 2, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.hits);
+	ut_asserteq(1 << 20, stats.bytes);
+	ut_asserteq((1 << 20) / DEFAULT_BLKSZ, stats.entries);
+
+	/* The oldest blocks are gone, the newest are still there */
+	ut_asserteq(2, blk_read(blk, 1099 * 3, 2, buf));
+	ut_asserteq(1, blk_read(blk, 0, 1, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+	ut_asserteq(0, stats.bytes);
+
+	blkcache_configure(8, CONFIG_BLOCK_CACHE_SIZE,
+			   CONFIG_BLOCK_CACHE_READAHEAD);
+	ut_assertok(host_detach_file(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UTF_SCAN_FDT);
+
+/* Test that write-back holds writes until flushed, merging adjacent blocks */
+static int dm_test_blk_cache_writeback(struct unit_test_state *uts)
+{
+	u8 buf[DEFAULT_BLKSZ * 4], orig[DEFAULT_BLKSZ * 4];
+	struct block_cache_stats stats;
+	const struct blk_ops *ops;
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char fname[256];
+	lbaint_t start;
+
+	/* Attach a file created in test_ut_dm_init */
+	ut_assertok(os_persistent_file(fname, sizeof(fname), "2MB.ext2.img"));
+	ut_assertok(host_create_attach_file("test", fname, false, DEFAULT_BLKSZ,
+					    &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	desc = dev_get_uclass_plat(blk);
+
+	/* Use the last blocks of the image and put them back at the end */
+	start = desc->lba - 4;
+	blkcache_configure(8, 1, 0);
+	ut_asserteq(4, blk_read(blk, start, 4, orig));
+
+	blkcache_set_writeback(true);
+	blkcache_stats(&stats);
+	ut_assert(stats.writeback);
+
+	/*
+	 * A raw write, as from saveenv, goes straight to the device, so it
+	 * survives the cache being dropped without a flush
+	 */
+	memset(buf, 0x5a, sizeof(buf));
+	ut_asserteq(1, blk_dwrite(desc, start, 1, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	ops = blk->driver->ops;
+	ut_asserteq(1, ops->read(blk, start, 1, buf));
+	ut_asserteq(0x5a, buf[0]);
+	ut_asserteq(0x5a, buf[DEFAULT_BLKSZ - 1]);
+
+	/* Filesystem writes are held: write blocks 0, 1 and 3, not 2 */
+	blkcache_hold_writes(true);
+	memset(buf, 0xa5, sizeof(buf));
+	ut_asserteq(2, blk_write(blk, start, 2, buf));
+	ut_asserteq(1, blk_write(blk, start + 3, 1, buf));
+	blkcache_hold_writes(false);
+	blkcache_stats(&stats);
+	ut_asserteq(3, stats.dirty);
+	ut_asserteq(2, stats.wb_writes);
+
+	/* Reads see the new data, the device does not */
+	ut_asserteq(1, blk_read(blk, start + 1, 1, buf));
+	ut_asserteq(0xa5, buf[0]);
+	ut_asserteq(4, ops->read(blk, start, 4, buf));
+	ut_asserteq(0x5a, buf[0]);
+	ut_asserteq_mem(orig + DEFAULT_BLKSZ, buf + DEFAULT_BLKSZ,
+			sizeof(buf) - DEFAULT_BLKSZ);
+
+	/* Flushing issues one write per run of adjacent blocks */
+	ut_assertok(blk_flush(blk));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+	ut_asserteq(2, stats.flush_writes);
+	ut_asserteq(3, stats.flush_blocks);
+
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blkcache_configure(8, 0, 0);
+	ut_asserteq(4, blk_read(blk, start, 4, buf));
+	ut_asserteq(0xa5, buf[0]);
+	ut_asserteq(0xa5, buf[DEFAULT_BLKSZ * 2 - 1]);
+	ut_asserteq_mem(orig + DEFAULT_BLKSZ * 2, buf + DEFAULT_BLKSZ * 2,
+			DEFAULT_BLKSZ);
+	ut_asserteq(0xa5, buf[DEFAULT_BLKSZ * 3]);
+
+	/* Restore the original contents, written through */
+	ut_asserteq(4, blk_write(blk, start, 4, orig));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+
+	blkcache_set_writeback(IS_ENABLED(CONFIG_BLOCK_CACHE_WRITEBACK));
+	blkcache_configure(8, CONFIG_BLOCK_CACHE_SIZE,
+			   CONFIG_BLOCK_CACHE_READAHEAD);
+	ut_assertok(host_detach_file(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_writeback, UTF_SCAN_FDT);
+#endif
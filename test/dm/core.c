@@ -10,8 +10,10 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <time.h>
 #include <asm/global_data.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -1085,6 +1087,104 @@ static int dm_test_uclass_before_ready(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_uclass_before_ready, 0);
 
+/*
+ * Time finding the uclass at the end of the list, comparing uclass_find() with
+ * searching the list as it did before the uclass table
+ */
+static int dm_test_uclass_find_speed(struct unit_test_state *uts)
+{
+	const int loops = 100000;
+	struct uclass *uc, *last, *found;
+	ulong start, tbl_us, list_us;
+	enum uclass_id id;
+	int count, i;
+
+	count = 0;
+	last = NULL;
+	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
+		last = uc;
+		count++;
+	}
+	ut_assertnonnull(last);
+	id = last->uc_drv->id;
+
+	found = NULL;
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		found = uclass_find(id);
+		barrier();
+	}
+	tbl_us = max(timer_get_us() - start, 1UL);
+	ut_asserteq_ptr(last, found);
+
+	found = NULL;
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		list_for_each_entry(uc, gd->uclass_root, sibling_node) {
+			if (uc->uc_drv->id == id) {
+				found = uc;
+				break;
+			}
+		}
+		barrier();
+	}
+	list_us = max(timer_get_us() - start, 1UL);
+	ut_asserteq_ptr(last, found);
+
+	printf("%d uclasses: %llu lookups/s with uclass_find(), %llu searching the list\n",
+	       count, loops * 1000000ULL / tbl_us,
+	       loops * 1000000ULL / list_us);
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_find_speed, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Check that each compatible string finds the first driver which has it */
+static int dm_test_lists_lookup_compat(struct unit_test_state *uts)
+{
+	struct driver *start = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id, *of_id, *found_id;
+	struct driver *drv, *entry;
+
+	for (drv = start; drv != start + n_ents; drv++) {
+		for (id = drv->of_match; id && id->compatible; id++) {
+			/* search the list as driver binding used to */
+			found_id = NULL;
+			for (entry = start; entry != drv; entry++) {
+				for (of_id = entry->of_match;
+				     of_id && of_id->compatible; of_id++) {
+					if (!strcmp(of_id->compatible,
+						    id->compatible)) {
+						found_id = of_id;
+						break;
+					}
+				}
+				if (found_id)
+					break;
+			}
+			if (!found_id) {
+				for (of_id = drv->of_match;
+				     strcmp(of_id->compatible, id->compatible);
+				     of_id++)
+					;
+				found_id = of_id;
+			}
+
+			ut_asserteq_ptr(entry,
+					lists_driver_lookup_compat(id->compatible,
+								   &of_id));
+			ut_asserteq_ptr(found_id, of_id);
+		}
+	}
+
+	ut_assertnull(lists_driver_lookup_compat("not,a-driver", &of_id));
+	ut_assertnull(of_id);
+
+	return 0;
+}
+DM_TEST(dm_test_lists_lookup_compat, 0);
+
 static int dm_test_uclass_devices_find(struct unit_test_state *uts)
 {
 	struct udevice *dev;
@@ -18,8 +18,10 @@
 
 #include <abuf.h>
 #include <dm.h>
+#include <dtb_index.h>
 #include <log.h>
 #include <of_live.h>
+#include <time.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/of_extra.h>
@@ -1495,6 +1497,79 @@ static int dm_test_livetree_ensure(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_livetree_ensure, UTF_SCAN_FDT);
 
+/* count the nodes and properties in a livetree */
+static void count_live_nodes(const struct device_node *np, int *nodesp,
+			     int *propsp)
+{
+	const struct property *pp;
+
+	(*nodesp)++;
+	for (pp = np->properties; pp; pp = pp->next)
+		(*propsp)++;
+	for (np = np->child; np; np = np->sibling)
+		count_live_nodes(np, nodesp, propsp);
+}
+
+/* check that a livetree built from the control FDT has all its contents */
+static int dm_test_livetree_build(struct unit_test_state *uts)
+{
+	const void *fdt = gd->fdt_blob;
+	int nodes, props, live_nodes, live_props, node, depth, prop;
+	struct device_node *root;
+
+	nodes = 0;
+	props = 0;
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(fdt, node, &depth)) {
+		nodes++;
+		fdt_for_each_property_offset(prop, fdt, node)
+			props++;
+	}
+
+	ut_assertok(unflatten_device_tree(fdt, &root));
+	live_nodes = 0;
+	live_props = 0;
+	count_live_nodes(root, &live_nodes, &live_props);
+	ut_asserteq(nodes, live_nodes);
+	ut_asserteq(props, live_props);
+	of_live_free(root);
+
+	return 0;
+}
+DM_TEST(dm_test_livetree_build, UTF_SCAN_FDT);
+
+/*
+ * time building a livetree from the control FDT and show its size; this
+ * depends on the host, so is only run when asked for
+ */
+static int dm_test_livetree_build_speed_norun(struct unit_test_state *uts)
+{
+	const int loops = 100;
+	const void *fdt = gd->fdt_blob;
+	struct device_node *root;
+	ulong start, us;
+	long bytes;
+	int i;
+
+	start = ut_check_free();
+	ut_assertok(unflatten_device_tree(fdt, &root));
+	bytes = ut_check_delta(start);
+	of_live_free(root);
+
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		ut_assertok(unflatten_device_tree(fdt, &root));
+		of_live_free(root);
+	}
+	us = max((timer_get_us() - start) / loops, 1UL);
+
+	printf("FDT structure %x: unflattened in %lu us, %ld bytes\n",
+	       fdt_size_dt_struct(fdt), us, bytes);
+
+	return 0;
+}
+DM_TEST(dm_test_livetree_build_speed_norun, UTF_SCAN_FDT | UTF_MANUAL);
+
 static int dm_test_oftree_new(struct unit_test_state *uts)
 {
 	ofnode node, subnode, check;
@@ -1651,3 +1726,163 @@ static int dm_test_bool(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_bool, UTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(OF_DTB_INDEX)
+/* Check that the build-time index finds the same nodes as libfdt */
+static int dm_test_ofnode_dtb_index(struct unit_test_state *uts)
+{
+	const void *fdt = gd->fdt_blob;
+	int node, depth, offset, len, prop, i;
+	const char *compat, *name;
+	uint phandle;
+
+	ut_assert(fdt_subnode_offset(fdt, 0, DTB_INDEX_NODE) >= 0);
+
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(fdt, node, &depth)) {
+		phandle = fdt_get_phandle(fdt, node);
+		if (phandle) {
+			ut_assert(dtb_index_phandle(fdt, phandle, &offset));
+			ut_asserteq(node, offset);
+		}
+
+		compat = fdt_getprop(fdt, node, "compatible", &len);
+		for (i = 0; compat && i < len; i += strlen(compat + i) + 1) {
+			ut_assert(dtb_index_compatible(fdt, -1, compat + i,
+						       &offset));
+			ut_asserteq(fdt_node_offset_by_compatible(fdt, -1,
+								  compat + i),
+				    offset);
+			ut_assert(dtb_index_compatible(fdt, node, compat + i,
+						       &offset));
+			ut_asserteq(fdt_node_offset_by_compatible(fdt, node,
+								  compat + i),
+				    offset);
+		}
+	}
+
+	node = fdt_path_offset(fdt, "/aliases");
+	ut_assert(node >= 0);
+	fdt_for_each_property_offset(prop, fdt, node) {
+		ut_assertnonnull(fdt_getprop_by_offset(fdt, prop, &name, NULL));
+		ut_assert(dtb_index_alias(fdt, name, &offset));
+		ut_asserteq(fdt_path_offset(fdt, name), offset);
+	}
+
+	ut_assert(!dtb_index_alias(fdt, "no-such-alias", &offset));
+	ut_assert(dtb_index_compatible(fdt, -1, "no,such-compat", &offset));
+	ut_asserteq(-FDT_ERR_NOTFOUND, offset);
+
+	/* changes which keep the size of the tree must not give wrong nodes */
+	node = fdt_node_offset_by_compatible(fdt, -1, "denx,u-boot-fdt-test");
+	ut_assert(node >= 0);
+	phandle = fdt_get_phandle(fdt, node);
+	if (phandle) {
+		ut_assertok(fdt_setprop_inplace_u32((void *)fdt, node,
+						    "phandle", phandle + 1000));
+		ut_assert(!dtb_index_phandle(fdt, phandle, &offset));
+	}
+	ut_assertok(fdt_nop_node((void *)fdt, node));
+	ut_assert(!dtb_index_compatible(fdt, -1, "denx,u-boot-fdt-test",
+					&offset) || offset != node);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_dtb_index, UTF_SCAN_FDT | UTF_FLAT_TREE);
+#endif
+
+#if CONFIG_IS_ENABLED(OFNODE_CACHE)
+/* check that each phandle in a flat tree is found where libfdt finds it */
+static int check_cached_phandles(struct unit_test_state *uts, oftree tree,
+				 int *countp)
+{
+	const void *fdt = tree.fdt;
+	uint phandle;
+	int node;
+
+	*countp = 0;
+	for (node = fdt_next_node(fdt, -1, NULL); node >= 0;
+	     node = fdt_next_node(fdt, node, NULL)) {
+		phandle = fdt_get_phandle(fdt, node);
+		if (!phandle)
+			continue;
+		ut_asserteq(node, ofnode_to_offset(oftree_get_by_phandle(tree,
+								phandle)));
+		(*countp)++;
+	}
+
+	return 0;
+}
+
+/* test the phandle and path cache used with flat trees */
+static int dm_test_ofnode_cache(struct unit_test_state *uts)
+{
+	oftree otree = get_other_oftree(uts);
+	struct ofnode_cache_stats old, new;
+	ofnode node, subnode, target;
+	int count, offset;
+	u32 phandle;
+
+	ofnode_get_cache_stats(&old);
+	ut_assertok(check_cached_phandles(uts, otree, &count));
+	ut_assert(count > 0);
+	ut_assert(!ofnode_valid(oftree_get_by_phandle(otree, 0x1000)));
+	ofnode_get_cache_stats(&new);
+	ut_asserteq(old.phandle_hits + count, new.phandle_hits);
+	ut_asserteq(old.phandle_misses + 1, new.phandle_misses);
+
+	/* the second lookup of a path comes from the cache, if it was found */
+	node = oftree_path(otree, "/node");
+	ut_assert(ofnode_valid(node));
+	ut_asserteq(ofnode_to_offset(node),
+		    ofnode_to_offset(oftree_path(otree, "/node")));
+	ut_assert(!ofnode_valid(oftree_path(otree, "/no-such-node")));
+	ut_assert(!ofnode_valid(oftree_path(otree, "/no-such-node")));
+	ofnode_get_cache_stats(&old);
+	ut_asserteq(new.path_misses + 3, old.path_misses);
+	ut_asserteq(new.path_hits + 1, old.path_hits);
+
+	/* adding a node moves the ones after it, so the cache is dropped */
+	ut_assertok(ofnode_add_subnode(node, "cache-test", &subnode));
+	ofnode_get_cache_stats(&new);
+	ut_asserteq(old.flushes + 1, new.flushes);
+	ut_assertok(check_cached_phandles(uts, otree, &count));
+	ut_asserteq(ofnode_to_offset(subnode),
+		    ofnode_to_offset(oftree_path(otree, "/node/cache-test")));
+
+	/* a change made with libfdt is spotted by the size of the tree */
+	ut_assertok(fdt_setprop_string(otree.fdt, ofnode_to_offset(subnode),
+				       "cache-prop", "value"));
+	ut_assertok(check_cached_phandles(uts, otree, &count));
+	ofnode_get_cache_stats(&old);
+	ut_asserteq(new.flushes + 1, old.flushes);
+
+	ut_assertok(ofnode_delete(&subnode));
+	ut_assert(!ofnode_valid(oftree_path(otree, "/node/cache-test")));
+	ut_assertok(check_cached_phandles(uts, otree, &count));
+
+	/* changes which keep the size of the tree are caught as well */
+	ut_assertok(ofnode_read_u32(node, "other-phandle", &phandle));
+	target = oftree_get_by_phandle(otree, phandle);
+	ut_assert(ofnode_valid(target));
+	ut_assertok(fdt_setprop_inplace_u32(otree.fdt, ofnode_to_offset(target),
+					    "phandle", 0x1000));
+	ut_assert(!ofnode_valid(oftree_get_by_phandle(otree, phandle)));
+	ut_asserteq(ofnode_to_offset(target),
+		    ofnode_to_offset(oftree_get_by_phandle(otree, 0x1000)));
+	ut_assertok(fdt_setprop_inplace_u32(otree.fdt, ofnode_to_offset(target),
+					    "phandle", phandle));
+	ut_assertok(check_cached_phandles(uts, otree, &count));
+
+	offset = ofnode_to_offset(oftree_path(otree, "/node/subnode2"));
+	ut_assert(offset >= 0);
+	ut_assertok(fdt_set_name(otree.fdt, offset, "subnode3"));
+	ut_assert(!ofnode_valid(oftree_path(otree, "/node/subnode2")));
+	ut_asserteq(offset,
+		    ofnode_to_offset(oftree_path(otree, "/node/subnode3")));
+	ut_assertok(fdt_set_name(otree.fdt, offset, "subnode2"));
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_cache, UTF_SCAN_FDT | UTF_OTHER_FDT | UTF_FLAT_TREE);
+#endif
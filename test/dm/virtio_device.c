@@ -132,7 +132,7 @@ static int dm_test_virtio_ring(struct unit_test_state *uts)
 	struct virtqueue *vq;
 	struct virtio_sg sg[2];
 	struct virtio_sg *sgs[2];
-	unsigned int len;
+	unsigned int len, head[2];
 	u8 buffer[2][32];
 
 	/* check probe success */
@@ -192,6 +192,19 @@ static int dm_test_virtio_ring(struct unit_test_state *uts)
 	ut_asserteq(6, len);
 	ut_assertok(virtio_del_vqs(dev));
 
+	/* used buffers can be identified by their head descriptor */
+	ut_assertok(virtio_find_vqs(dev, 1, &vq));
+	ut_assertok(virtqueue_add_head(vq, sgs, 0, 1, &head[0]));
+	ut_assertok(virtqueue_add_head(vq, &sgs[1], 0, 1, &head[1]));
+	ut_assert(head[0] != head[1]);
+	vq->vring.used->idx = 2;
+	vq->vring.used->ring[0].id = head[1];
+	vq->vring.used->ring[1].id = head[0];
+	ut_asserteq(head[1], virtqueue_get_head(vq, &len));
+	ut_asserteq(head[0], virtqueue_get_head(vq, &len));
+	ut_asserteq(-ENOENT, virtqueue_get_head(vq, &len));
+	ut_assertok(virtio_del_vqs(dev));
+
 	return 0;
 }
 DM_TEST(dm_test_virtio_ring, UTF_SCAN_PDATA | UTF_SCAN_FDT);
@@ -6,13 +6,17 @@
 #include <abuf.h>
 #include <bootm.h>
 #include <command.h>
+#include <decomp_stream.h>
 #include <gzip.h>
 #include <image.h>
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <time.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 
+#include <u-boot/crc.h>
 #include <u-boot/lz4.h>
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -22,6 +26,7 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/sizes.h>
 #include <linux/zstd.h>
 #include <test/lib.h>
 #include <test/ut.h>
@@ -121,6 +126,28 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = sizeof(lz4_compressed) - 1;
 
+/* lz4 -z --content-size /tmp/plain.txt > /tmp/plain_size.lz4 */
+static const char lz4_sized[] =
+	"\x04\x22\x4d\x18\x6c\x40\x5e\x01\x00\x00\x00\x00\x00\x00\x0c\x01"
+	"\x01\x00\x00\xff\x19\x49\x20\x61\x6d\x20\x61\x20\x68\x69\x67\x68"
+	"\x6c\x79\x20\x63\x6f\x6d\x70\x72\x65\x73\x73\x61\x62\x6c\x65\x20"
+	"\x62\x69\x74\x20\x6f\x66\x20\x74\x65\x78\x74\x2e\x0a\x28\x00\x3d"
+	"\xf1\x25\x54\x68\x65\x72\x65\x20\x61\x72\x65\x20\x6d\x61\x6e\x79"
+	"\x20\x6c\x69\x6b\x65\x20\x6d\x65\x2c\x20\x62\x75\x74\x20\x74\x68"
+	"\x69\x73\x20\x6f\x6e\x65\x20\x69\x73\x20\x6d\x69\x6e\x65\x2e\x0a"
+	"\x49\x66\x20\x49\x20\x77\x32\x00\xd1\x6e\x79\x20\x73\x68\x6f\x72"
+	"\x74\x65\x72\x2c\x20\x74\x45\x00\xf4\x0b\x77\x6f\x75\x6c\x64\x6e"
+	"\x27\x74\x20\x62\x65\x20\x6d\x75\x63\x68\x20\x73\x65\x6e\x73\x65"
+	"\x20\x69\x6e\x0a\xcf\x00\x50\x69\x6e\x67\x20\x6d\x12\x00\x00\x32"
+	"\x00\xf0\x11\x20\x66\x69\x72\x73\x74\x20\x70\x6c\x61\x63\x65\x2e"
+	"\x20\x41\x74\x20\x6c\x65\x61\x73\x74\x20\x77\x69\x74\x68\x20\x6c"
+	"\x7a\x6f\x2c\x63\x00\xf5\x14\x77\x61\x79\x2c\x0a\x77\x68\x69\x63"
+	"\x68\x20\x61\x70\x70\x65\x61\x72\x73\x20\x74\x6f\x20\x62\x65\x68"
+	"\x61\x76\x65\x20\x70\x6f\x6f\x72\x6c\x79\x4e\x00\x30\x61\x63\x65"
+	"\x27\x01\x01\x95\x00\x01\x2d\x01\xb0\x0a\x6d\x65\x73\x73\x61\x67"
+	"\x65\x73\x2e\x0a\x00\x00\x00\x00\x9d\x12\x8c\x9d";
+static const unsigned long lz4_sized_size = sizeof(lz4_sized) - 1;
+
 /* zstd -19 -c /tmp/plain.txt > /tmp/plain.zst */
 static const char zstd_compressed[] =
 	"\x28\xb5\x2f\xfd\x64\x5e\x00\xbd\x05\x00\x02\x0e\x26\x1a\x70\x17"
@@ -606,3 +633,653 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
 }
 LIB_TEST(compression_test_bootm_none, 0);
+
+/* Input seen by image_decomp_input() */
+struct input_check {
+	ulong size;
+	u32 crc;
+};
+
+static void input_check_fn(void *priv, const void *buf, ulong size)
+{
+	struct input_check *check = priv;
+
+	check->crc = crc32(check->crc, buf, size);
+	check->size += size;
+}
+
+/**
+ * run_bootm_input_test() - Test passing decompressor input to a function
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @data:	Data to compress
+ * @size:	Size of @data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int run_bootm_input_test(struct unit_test_state *uts, int comp_type,
+				mutate_func compress, const void *data,
+				ulong size)
+{
+	ulong comp_size = size + 1024;
+	struct input_check check;
+	void *comp, *out;
+	ulong load_end;
+
+	comp = malloc(comp_size);
+	out = malloc(size);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(out);
+	ut_assertok(compress(uts, (void *)data, size, comp, comp_size,
+			     &comp_size));
+
+	/* every byte of input must be seen once, in order */
+	memset(&check, '\0', sizeof(check));
+	ut_assertok(image_decomp_input(comp_type, map_to_sysmem(out),
+				       map_to_sysmem(comp), IH_TYPE_KERNEL,
+				       out, comp, comp_size, size, &load_end,
+				       input_check_fn, &check));
+	ut_asserteq(size, load_end - map_to_sysmem(out));
+	ut_asserteq_mem(data, out, size);
+	ut_asserteq(comp_size, check.size);
+	ut_asserteq(crc32(0, comp, comp_size), check.crc);
+
+	/* ...even if decompression fails */
+	memset(comp + comp_size / 2, '\x49', comp_size / 2);
+	memset(&check, '\0', sizeof(check));
+	ut_assert(image_decomp_input(comp_type, map_to_sysmem(out),
+				     map_to_sysmem(comp), IH_TYPE_KERNEL,
+				     out, comp, comp_size, size, &load_end,
+				     input_check_fn, &check));
+	ut_asserteq(comp_size, check.size);
+	ut_asserteq(crc32(0, comp, comp_size), check.crc);
+
+	free(out);
+	free(comp);
+
+	return 0;
+}
+
+/* Make test data which is half compressible, half pseudo-random */
+static u8 *make_test_data(ulong size)
+{
+	u32 seed = 1;
+	u8 *data;
+	int i;
+
+	data = malloc(size);
+	if (!data)
+		return NULL;
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = i & 0x100 ? seed >> 16 : plain[i % strlen(plain)];
+	}
+
+	return data;
+}
+
+static int compression_test_bootm_input_gzip(struct unit_test_state *uts)
+{
+	const ulong size = 300 * 1024;
+	u8 *data;
+	int ret;
+
+	/* mostly incompressible, so that the input takes several chunks */
+	data = make_test_data(size);
+	ut_assertnonnull(data);
+	ret = run_bootm_input_test(uts, IH_COMP_GZIP, compress_using_gzip,
+				   data, size);
+	free(data);
+
+	return ret;
+}
+LIB_TEST(compression_test_bootm_input_gzip, 0);
+
+static int compression_test_bootm_input_lzma(struct unit_test_state *uts)
+{
+	return run_bootm_input_test(uts, IH_COMP_LZMA, compress_using_lzma,
+				    plain, strlen(plain));
+}
+LIB_TEST(compression_test_bootm_input_lzma, 0);
+
+static int compression_test_bootm_input_lz4(struct unit_test_state *uts)
+{
+	return run_bootm_input_test(uts, IH_COMP_LZ4, compress_using_lz4,
+				    plain, strlen(plain));
+}
+LIB_TEST(compression_test_bootm_input_lz4, 0);
+
+static int compression_test_bootm_input_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_input_test(uts, IH_COMP_ZSTD, compress_using_zstd,
+				    plain, strlen(plain));
+}
+LIB_TEST(compression_test_bootm_input_zstd, 0);
+
+/**
+ * run_inplace_test() - Test decompressing data over itself
+ *
+ * This puts the compressed data at the end of the output buffer, leaving the
+ * margin given by image_decomp_margin(), and decompresses it from there.
+ *
+ * @comp_type:	Compression type to test
+ * @comp:	Compressed data
+ * @comp_size:	Size of compressed data
+ * @data:	Expected uncompressed data
+ * @size:	Size of @data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int run_inplace_test(struct unit_test_state *uts, int comp_type,
+			    const void *comp, ulong comp_size, const void *data,
+			    ulong size)
+{
+	ulong unc_size, margin, load_end;
+	u8 *buf, *in;
+
+	ut_assertok(image_decomp_margin(comp_type, comp, comp_size, &unc_size,
+					&margin));
+	ut_asserteq(size, unc_size);
+	ut_assert(size + margin >= comp_size);
+
+	/* one more byte, which must not be touched */
+	buf = malloc(size + margin + 1);
+	ut_assertnonnull(buf);
+	buf[size + margin] = 'A';
+	in = buf + size + margin - comp_size;
+	memcpy(in, comp, comp_size);
+
+	ut_assertok(image_decomp(comp_type, map_to_sysmem(buf),
+				 map_to_sysmem(in), IH_TYPE_KERNEL, buf, in,
+				 comp_size, size, &load_end));
+	ut_asserteq(size, load_end - map_to_sysmem(buf));
+	ut_asserteq_mem(data, buf, size);
+	ut_asserteq('A', buf[size + margin]);
+	free(buf);
+
+	return 0;
+}
+
+/*
+ * Store data in an lz4 or zstd frame without compressing it, which is the
+ * worst case for decompressing in place. Returns the size of the frame.
+ */
+static ulong store_frame(int comp_type, const u8 *data, ulong size, u8 *out)
+{
+	const ulong block_max = comp_type == IH_COMP_LZ4 ? SZ_64K : SZ_128K;
+	ulong pos, len;
+	u8 *ptr = out;
+
+	if (comp_type == IH_COMP_LZ4) {
+		/* version 1, independent blocks, content size, no checksums */
+		put_unaligned_le32(0x184d2204, ptr);
+		ptr[4] = 0x68;
+		ptr[5] = 0x40;
+		put_unaligned_le64(size, ptr + 6);
+		ptr[14] = 0;	/* header checksum, which is not checked */
+		ptr += 15;
+	} else {
+		/* single segment, 8-byte content size */
+		put_unaligned_le32(0xfd2fb528, ptr);
+		ptr[4] = 0xe0;
+		put_unaligned_le64(size, ptr + 5);
+		ptr += 13;
+	}
+
+	for (pos = 0; pos < size; pos += len) {
+		len = min(block_max, size - pos);
+		if (comp_type == IH_COMP_LZ4) {
+			put_unaligned_le32(len | 0x80000000, ptr);
+			ptr += 4;
+		} else {
+			/* raw block, with the last-block flag if needed */
+			put_unaligned_le32(len << 3 | (pos + len == size),
+					   ptr);
+			ptr += 3;
+		}
+		memcpy(ptr, data + pos, len);
+		ptr += len;
+	}
+	if (comp_type == IH_COMP_LZ4) {
+		put_unaligned_le32(0, ptr);	/* end mark */
+		ptr += 4;
+	}
+
+	return ptr - out;
+}
+
+static int compression_test_inplace(struct unit_test_state *uts)
+{
+	const ulong size = 300 * 1024;
+	static const int types[] = { IH_COMP_LZ4, IH_COMP_ZSTD };
+	ulong comp_size, unc_size, margin;
+	u8 *data, *comp;
+	int i;
+
+	ut_assertok(run_inplace_test(uts, IH_COMP_LZ4, lz4_sized,
+				     lz4_sized_size, plain, strlen(plain)));
+	ut_assertok(run_inplace_test(uts, IH_COMP_ZSTD, zstd_compressed,
+				     zstd_compressed_size, plain,
+				     strlen(plain)));
+
+	/* the size must be known in advance */
+	ut_asserteq(-ENODATA, image_decomp_margin(IH_COMP_LZ4, lz4_compressed,
+						  lz4_compressed_size,
+						  &unc_size, &margin));
+	ut_asserteq(-ENOSYS, image_decomp_margin(IH_COMP_LZMA,
+						 lzma_compressed,
+						 lzma_compressed_size,
+						 &unc_size, &margin));
+
+	/* several blocks which do not compress */
+	data = make_test_data(size);
+	comp = malloc(size + 1024);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	for (i = 0; i < ARRAY_SIZE(types); i++) {
+		comp_size = store_frame(types[i], data, size, comp);
+		ut_assertok(run_inplace_test(uts, types[i], comp, comp_size,
+					     data, size));
+	}
+	free(comp);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(compression_test_inplace, 0);
+
+/**
+ * stream_decomp() - Decompress using the streaming API
+ *
+ * @comp_type:	Compression type
+ * @in:		Compressed data
+ * @in_size:	Size of compressed data
+ * @out:	Output buffer
+ * @out_size:	Size of output buffer
+ * @step:	Number of bytes to pass in each call, 0 for all at once
+ * @heapp:	If not NULL, returns the most heap used between calls
+ * Return: number of bytes decompressed, or -ve on error
+ */
+static long stream_decomp(int comp_type, const u8 *in, ulong in_size,
+			  void *out, ulong out_size, ulong step, long *heapp)
+{
+	struct decomp_stream ds;
+	ulong start, pos, len;
+	long heap = 0;
+	int ret;
+
+	start = ut_check_free();
+	ret = decomp_stream_init(&ds, comp_type, out, out_size);
+	if (ret)
+		return ret;
+	for (pos = 0; pos < in_size; pos += len) {
+		len = step ? min(step, in_size - pos) : in_size;
+		ret = decomp_stream_feed(&ds, in + pos, len);
+		if (ret)
+			break;
+		heap = max(heap, ut_check_delta(start));
+	}
+	if (heapp)
+		*heapp = heap;
+	if (ret) {
+		decomp_stream_finish(&ds);
+		return ret;
+	}
+
+	return decomp_stream_finish(&ds);
+}
+
+/**
+ * run_stream_test() - Test the streaming decompression API
+ *
+ * @comp_type:	Compression type to test
+ * @comp:	Compressed data
+ * @comp_size:	Size of compressed data
+ * @data:	Expected uncompressed data
+ * @size:	Size of @data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   const void *comp, ulong comp_size, const void *data,
+			   ulong size)
+{
+	static const ulong steps[] = { 1, 3, 13, 4096, 0 };
+	u8 *out;
+	int i;
+
+	if (!CONFIG_IS_ENABLED(DECOMP_STREAM))
+		return -EAGAIN;
+	out = malloc(size + 1);
+	ut_assertnonnull(out);
+	for (i = 0; i < ARRAY_SIZE(steps); i++) {
+		memset(out, 'A', size + 1);
+		ut_asserteq(size, stream_decomp(comp_type, comp, comp_size,
+						out, size, steps[i], NULL));
+		ut_asserteq_mem(data, out, size);
+		ut_asserteq('A', out[size]);
+	}
+
+	/* output buffer too small */
+	memset(out, 'A', size + 1);
+	ut_assert(stream_decomp(comp_type, comp, comp_size, out, size - 1, 7,
+				NULL) < 0);
+	ut_asserteq('A', out[size - 1]);
+
+	/* input cut short */
+	ut_asserteq(-EBADMSG, stream_decomp(comp_type, comp, comp_size / 2,
+					    out, size, 7, NULL));
+
+	free(out);
+
+	return 0;
+}
+
+/**
+ * window_decomp() - Decompress using the streaming API in window mode
+ *
+ * @comp_type:	Compression type
+ * @in:		Compressed data
+ * @in_size:	Size of compressed data
+ * @out:	Output buffer, which each window is copied to
+ * @out_size:	Size of output buffer
+ * @window:	Size of the window
+ * @step:	Most bytes to pass in each call, 0 for all that are left
+ * Return: number of bytes decompressed, or -ve on error
+ */
+static long window_decomp(int comp_type, const u8 *in, ulong in_size,
+			  u8 *out, ulong out_size, ulong window, ulong step)
+{
+	struct decomp_stream ds;
+	ulong pos = 0, out_len = 0, len;
+	long used, ret;
+	u8 *buf;
+
+	buf = malloc(window);
+	if (!buf)
+		return -ENOMEM;
+	ret = decomp_stream_init_window(&ds, comp_type);
+	if (ret) {
+		free(buf);
+		return ret;
+	}
+	while (!ds.done) {
+		len = step ? min(step, in_size - pos) : in_size - pos;
+		used = decomp_stream_fill(&ds, in + pos, len, buf, window);
+		if (used < 0) {
+			ret = used;
+			break;
+		}
+		pos += used;
+		if (out_len + ds.out_len > out_size) {
+			ret = -ENOSPC;
+			break;
+		}
+		memcpy(out + out_len, buf, ds.out_len);
+		out_len += ds.out_len;
+		if (!used && !ds.out_len)
+			break;
+	}
+	free(buf);
+	if (ret) {
+		decomp_stream_finish(&ds);
+		return ret;
+	}
+	ret = decomp_stream_finish(&ds);
+
+	return ret ? ret : out_len;
+}
+
+/**
+ * run_window_test() - Test window mode of the streaming API
+ *
+ * @comp_type:	Compression type to test
+ * @comp:	Compressed data
+ * @comp_size:	Size of compressed data
+ * @data:	Expected uncompressed data
+ * @size:	Size of @data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int run_window_test(struct unit_test_state *uts, int comp_type,
+			   const void *comp, ulong comp_size, const void *data,
+			   ulong size)
+{
+	static const struct {
+		ulong window;
+		ulong step;
+	} cases[] = {
+		{ 1, 0 }, { 61, 1 }, { 61, 13 }, { 4096, 0 }, { 4096, 4096 },
+	};
+	u8 *out;
+	int i;
+
+	if (!CONFIG_IS_ENABLED(DECOMP_STREAM))
+		return -EAGAIN;
+	ut_assert(decomp_stream_window_supported(comp_type));
+	out = malloc(size);
+	ut_assertnonnull(out);
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		memset(out, 'A', size);
+		ut_asserteq(size, window_decomp(comp_type, comp, comp_size,
+						out, size, cases[i].window,
+						cases[i].step));
+		ut_asserteq_mem(data, out, size);
+	}
+
+	/* input cut short */
+	ut_asserteq(-EBADMSG, window_decomp(comp_type, comp, comp_size / 2,
+					    out, size, 61, 0));
+	free(out);
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	const ulong size = 300 * 1024;
+	ulong comp_size = size + 1024;
+	u8 *data, *comp;
+	int ret;
+
+	data = make_test_data(size);
+	comp = malloc(comp_size);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	ut_assertok(compress_using_gzip(uts, data, size, comp, comp_size,
+					&comp_size));
+	ret = run_stream_test(uts, IH_COMP_GZIP, comp, comp_size, data, size);
+	if (!ret)
+		ret = run_window_test(uts, IH_COMP_GZIP, comp, comp_size, data,
+				      size);
+	free(comp);
+	free(data);
+
+	return ret;
+}
+LIB_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	int ret;
+
+	ret = run_stream_test(uts, IH_COMP_LZ4, lz4_compressed,
+			      lz4_compressed_size, plain, strlen(plain));
+	if (ret)
+		return ret;
+
+	return run_window_test(uts, IH_COMP_LZ4, lz4_compressed,
+			       lz4_compressed_size, plain, strlen(plain));
+}
+LIB_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_lzma(struct unit_test_state *uts)
+{
+	struct decomp_stream ds;
+
+	/* lzma keeps its history in the output, so has no window mode */
+	if (CONFIG_IS_ENABLED(DECOMP_STREAM))
+		ut_asserteq(-EPROTONOSUPPORT,
+			    decomp_stream_init_window(&ds, IH_COMP_LZMA));
+
+	return run_stream_test(uts, IH_COMP_LZMA, lzma_compressed,
+			       lzma_compressed_size, plain, strlen(plain));
+}
+LIB_TEST(compression_test_stream_lzma, 0);
+
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	int ret;
+
+	ret = run_stream_test(uts, IH_COMP_ZSTD, zstd_compressed,
+			      zstd_compressed_size, plain, strlen(plain));
+	if (ret)
+		return ret;
+
+	return run_window_test(uts, IH_COMP_ZSTD, zstd_compressed,
+			       zstd_compressed_size, plain, strlen(plain));
+}
+LIB_TEST(compression_test_stream_zstd, 0);
+
+/**
+ * bench_stream() - Compare one-shot and streaming decompression
+ *
+ * This shows the time taken by each, decompressing the data @count times,
+ * and the heap used by the streaming decompressor, which need not have all
+ * of the compressed data in memory.
+ *
+ * @comp_type:	Compression type
+ * @uncompress:	One-shot decompression function
+ * @comp:	Compressed data
+ * @comp_size:	Size of compressed data
+ * @size:	Size of uncompressed data
+ * @count:	Number of times to decompress the data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int bench_stream(struct unit_test_state *uts, int comp_type,
+			mutate_func uncompress, const void *comp,
+			ulong comp_size, ulong size, int count)
+{
+	ulong one_us, stream_us, start, out_size;
+	long heap;
+	void *out;
+	int i;
+
+	out = malloc(size);
+	ut_assertnonnull(out);
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++) {
+		ut_assertok(uncompress(uts, (void *)comp, comp_size, out, size,
+				       &out_size));
+		ut_asserteq(size, out_size);
+	}
+	one_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++)
+		ut_asserteq(size, stream_decomp(comp_type, comp, comp_size,
+						out, size, 4096, &heap));
+	stream_us = timer_get_us() - start;
+
+	printf("%-6s %8lu %8lu %5d %10lu %10lu %8ld\n",
+	       genimg_get_comp_short_name(comp_type), comp_size, size, count,
+	       one_us, stream_us, heap);
+	free(out);
+
+	return 0;
+}
+
+static int compression_test_stream_bench(struct unit_test_state *uts)
+{
+	const ulong size = 1 << 20;
+	ulong comp_size = size + 1024;
+	u8 *data, *comp;
+
+	if (!CONFIG_IS_ENABLED(DECOMP_STREAM))
+		return -EAGAIN;
+	data = make_test_data(size);
+	comp = malloc(comp_size);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	ut_assertok(compress_using_gzip(uts, data, size, comp, comp_size,
+					&comp_size));
+
+	printf("%-6s %8s %8s %5s %10s %10s %8s\n", "Comp", "In", "Out",
+	       "Count", "One(us)", "Stream(us)", "Heap");
+	ut_assertok(bench_stream(uts, IH_COMP_GZIP, uncompress_using_gzip,
+				 comp, comp_size, size, 4));
+	ut_assertok(bench_stream(uts, IH_COMP_LZ4, uncompress_using_lz4,
+				 lz4_compressed, lz4_compressed_size,
+				 strlen(plain), 1000));
+	ut_assertok(bench_stream(uts, IH_COMP_LZMA, uncompress_using_lzma,
+				 lzma_compressed, lzma_compressed_size,
+				 strlen(plain), 1000));
+	ut_assertok(bench_stream(uts, IH_COMP_ZSTD, uncompress_using_zstd,
+				 zstd_compressed, zstd_compressed_size,
+				 strlen(plain), 1000));
+	free(comp);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(compression_test_stream_bench, 0);
+
+/* Check the 'decomp bench' command with each compression type */
+static int compression_test_decomp_bench(struct unit_test_state *uts)
+{
+	const ulong src = 0x100000, dst = 0x200000, dst_size = 0x1000;
+	struct {
+		int comp;
+		const char *data;
+		ulong size;
+	} corpus[] = {
+		{ IH_COMP_BZIP2, bzip2_compressed, bzip2_compressed_size },
+		{ IH_COMP_LZMA, lzma_compressed, lzma_compressed_size },
+		{ IH_COMP_LZO, lzo_compressed, lzo_compressed_size },
+		{ IH_COMP_LZ4, lz4_compressed, lz4_compressed_size },
+		{ IH_COMP_ZSTD, zstd_compressed, zstd_compressed_size },
+	};
+	ulong size = strlen(plain), gz_size;
+	void *in, *out;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_CMD_DECOMP))
+		return -EAGAIN;
+	out = map_sysmem(dst, dst_size);
+
+	in = map_sysmem(src, TEST_BUFFER_SIZE);
+	ut_assertok(compress_using_gzip(uts, (void *)plain, size, in,
+					TEST_BUFFER_SIZE, &gz_size));
+	unmap_sysmem(in);
+	memset(out, '\0', dst_size);
+	ut_assertok(run_commandf("decomp bench -n 10 gzip %lx %lx %lx %lx", src,
+				 gz_size, dst, dst_size));
+	ut_assert_nextlinen("gzip: %lu -> %lu bytes, 10 runs", gz_size, size);
+	ut_asserteq_mem(plain, out, size);
+
+	for (i = 0; i < ARRAY_SIZE(corpus); i++) {
+		const char *name = genimg_get_comp_short_name(corpus[i].comp);
+
+		memcpy(map_sysmem(src, corpus[i].size), corpus[i].data,
+		       corpus[i].size);
+		memset(out, '\0', dst_size);
+		ut_assertok(run_commandf("decomp bench -n 10 %s %lx %lx %lx %lx",
+					 name, src, corpus[i].size, dst,
+					 dst_size));
+		ut_assert_nextlinen("%s: %lu -> %lu bytes, 10 runs", name,
+				    corpus[i].size, size);
+		ut_asserteq_mem(plain, out, size);
+	}
+
+	ut_asserteq(1, run_command("decomp bench fred 100000 10 200000 1000",
+				   0));
+	ut_assert_nextline("Unknown compression type 'fred'");
+	memcpy(map_sysmem(src, lz4_compressed_size), lz4_compressed,
+	       lz4_compressed_size);
+	ut_asserteq(1, run_commandf("decomp bench lz4 %lx %lx %lx 10", src,
+				    lz4_compressed_size, dst));
+	ut_assert_nextline("Decompression failed (err=-71)");
+	ut_assert_console_end();
+	unmap_sysmem(out);
+
+	return 0;
+}
+LIB_TEST(compression_test_decomp_bench, UTF_CONSOLE);
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and benchmark for crc32
+ */
+
+#include <malloc.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <linux/math64.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+/* Calculate the CRC one bit at a time, to check the table-driven code */
+static u32 crc32_bitwise(u32 crc, const u8 *buf, uint len)
+{
+	int i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+	}
+
+	return ~crc;
+}
+
+static int lib_crc32(struct unit_test_state *uts)
+{
+	const char check[] = "123456789";
+	uint start, len;
+	u32 crc;
+	u8 *buf;
+	int i;
+
+	ut_asserteq(0xcbf43926, crc32(0, check, sizeof(check) - 1));
+	ut_asserteq(0, crc32(0, check, 0));
+	ut_asserteq(0xcbf43926,
+		    crc32_no_comp(~0, check, sizeof(check) - 1) ^ ~0);
+
+	/* Try each alignment and length, so that all paths are used */
+	buf = malloc(SZ_64K);
+	ut_assertnonnull(buf);
+	for (i = 0; i < SZ_64K; i++)
+		buf[i] = i * 73 + 11;
+	for (start = 0; start < 8; start++) {
+		for (len = 0; len < 64; len++)
+			ut_asserteq(crc32_bitwise(0, buf + start, len),
+				    crc32(0, buf + start, len));
+	}
+	ut_asserteq(crc32_bitwise(0, buf, 256), crc32(0, buf, 256));
+	ut_asserteq(crc32_bitwise(0, buf, SZ_64K), crc32(0, buf, SZ_64K));
+
+	/* Calculating in pieces gives the same result */
+	crc = crc32(0, buf, 3);
+	crc = crc32(crc, buf + 3, 100);
+	crc = crc32(crc, buf + 103, 153);
+	ut_asserteq(crc32(0, buf, 256), crc);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_crc32, 0);
+
+/*
+ * Show the speed of crc32() compared to the bitwise calculation. The timing
+ * depends on the host, so this is only run when asked for.
+ */
+static int lib_crc32_bench_norun(struct unit_test_state *uts)
+{
+	const uint size = 1 << 20, count = 16;
+	ulong start, time_us, bit_us;
+	u32 crc = 0;
+	u8 *buf;
+	uint i;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	for (i = 0; i < size; i++)
+		buf[i] = i * 73 + 11;
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++)
+		crc = crc32(crc, buf, size);
+	time_us = max_t(ulong, timer_get_us() - start, 1);
+
+	start = timer_get_us();
+	ut_asserteq(crc32_bitwise(0, buf, size), crc32(0, buf, size));
+	bit_us = max_t(ulong, timer_get_us() - start, 1);
+
+	printf("crc32: %u MiB in %lu us: %llu MB/s, bitwise %llu MB/s (crc %08x)\n",
+	       count * size >> 20, time_us, div_u64((u64)count * size, time_us),
+	       div_u64(size, bit_us), crc);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_crc32_bench_norun, UTF_MANUAL);
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and benchmark for hashing through a hash driver
+ */
+
+#include <dm.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/math64.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/hash.h>
+
+#define BUF_SIZE	(1 << 20)
+
+static u8 *hash_test_buf(void)
+{
+	u8 *buf;
+	uint i;
+
+	buf = malloc(BUF_SIZE);
+	if (buf) {
+		for (i = 0; i < BUF_SIZE; i++)
+			buf[i] = i * 73 + 11;
+	}
+
+	return buf;
+}
+
+/*
+ * Check that hash_regions() gives the same result as hashing on the CPU,
+ * for inputs smaller and larger than CONFIG_HASH_OFFLOAD_MIN and split into
+ * several regions
+ */
+static int lib_test_hash_offload(struct unit_test_state *uts)
+{
+	static const char *const names[] = { "md5", "sha1", "sha256", "sha512",
+					     "crc32" };
+	const uint sizes[] = { 0, 100, CONFIG_HASH_OFFLOAD_MIN - 1,
+			       CONFIG_HASH_OFFLOAD_MIN, 100000 };
+	u8 expect[HASH_MAX_DIGEST_SIZE], out[HASH_MAX_DIGEST_SIZE];
+	struct image_region region[3];
+	struct hash_algo *algo;
+	uint i, j, size;
+	u8 *buf;
+
+	buf = hash_test_buf();
+	ut_assertnonnull(buf);
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (hash_lookup_algo(names[i], &algo))
+			continue;
+		for (j = 0; j < ARRAY_SIZE(sizes); j++) {
+			size = sizes[j];
+			algo->hash_func_ws(buf, size, expect, algo->chunk_size);
+
+			region[0].data = buf;
+			region[0].size = size;
+			memset(out, '\0', sizeof(out));
+			ut_assertok(hash_regions(algo, region, 1, out));
+			ut_asserteq_mem(expect, out, algo->digest_size);
+			if (!algo->hash_init)
+				continue;
+
+			region[0].size = size / 3;
+			region[1].data = buf + size / 3;
+			region[1].size = 0;
+			region[2].data = region[1].data;
+			region[2].size = size - size / 3;
+			memset(out, '\0', sizeof(out));
+			ut_assertok(hash_regions(algo, region, 3, out));
+			ut_asserteq_mem(expect, out, algo->digest_size);
+		}
+	}
+	ut_asserteq(-EINVAL, hash_regions(algo, region, 0, out));
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_offload, 0);
+
+/*
+ * Show the time taken to hash various sizes on the CPU and with the hash
+ * driver, to help choose CONFIG_HASH_OFFLOAD_MIN. The results are checked by
+ * lib_test_hash_offload, so this is only run when asked for.
+ */
+static int lib_test_hash_offload_bench_norun(struct unit_test_state *uts)
+{
+	u8 out[HASH_MAX_DIGEST_SIZE];
+	ulong start, cpu_us, drv_us;
+	struct hash_algo *algo;
+	struct udevice *dev;
+	uint size, count, i;
+	enum HASH_ALGO id;
+	u8 *buf;
+
+	if (hash_lookup_algo("sha256", &algo))
+		return -EAGAIN;
+	id = hash_algo_lookup_by_name("sha256");
+	ut_assertok(uclass_first_device_err(UCLASS_HASH, &dev));
+	buf = hash_test_buf();
+	ut_assertnonnull(buf);
+
+	printf("sha256 with %s, offload from %d bytes\n", dev->name,
+	       CONFIG_HASH_OFFLOAD_MIN);
+	printf("%8s %8s %10s %10s\n", "size", "count", "cpu ns", "driver ns");
+	for (size = 64; size <= BUF_SIZE; size <<= 2) {
+		count = max(BUF_SIZE / size, 16U);
+
+		start = timer_get_us();
+		for (i = 0; i < count; i++)
+			algo->hash_func_ws(buf, size, out, algo->chunk_size);
+		cpu_us = timer_get_us() - start;
+
+		start = timer_get_us();
+		for (i = 0; i < count; i++)
+			ut_assertok(hash_digest_wd(dev, id, buf, size, out,
+						   algo->chunk_size));
+		drv_us = timer_get_us() - start;
+
+		printf("%8u %8u %10llu %10llu%s\n", size, count,
+		       div_u64((u64)cpu_us * 1000, count),
+		       div_u64((u64)drv_us * 1000, count),
+		       drv_us < cpu_us ? " driver" : "");
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_offload_bench_norun, UTF_MANUAL);
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the SHA-1 and SHA-256 block functions
+ *
+ * These check the digests through the hash_algo table, so that whichever
+ * block function the board uses is tested: C, assembler or hardware. The
+ * input is hashed at each alignment and in pieces of awkward sizes, since
+ * optimised versions handle aligned, whole blocks differently.
+ */
+
+#include <command.h>
+#include <hash.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+
+struct sha_vector {
+	const char *input;
+	uint repeat;
+	const u8 *sha1;
+	const u8 *sha256;
+};
+
+/* Test vectors from FIPS 180-2 */
+static const struct sha_vector sha_vectors[] = {
+	{
+		"abc", 1,
+		(u8 *)"\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e\x25\x71\x78\x50"
+		"\xc2\x6c\x9c\xd0\xd8\x9d",
+		(u8 *)"\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae"
+		"\x22\x23\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2"
+		"\x00\x15\xad",
+	}, {
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+		(u8 *)"\x84\x98\x3e\x44\x1c\x3b\xd2\x6e\xba\xae\x4a\xa1\xf9\x51"
+		"\x29\xe5\xe5\x46\x70\xf1",
+		(u8 *)"\x24\x8d\x6a\x61\xd2\x06\x38\xb8\xe5\xc0\x26\x93\x0c\x3e"
+		"\x60\x39\xa3\x3c\xe4\x59\x64\xff\x21\x67\xf6\xec\xed\xd4\x19"
+		"\xdb\x06\xc1",
+	}, {
+		"a", 1000000,
+		(u8 *)"\x34\xaa\x97\x3c\xd4\xc4\xda\xa4\xf6\x1e\xeb\x2b\xdb\xad"
+		"\x27\x31\x65\x34\x01\x6f",
+		(u8 *)"\xcd\xc7\x6e\x5c\x99\x14\xfb\x92\x81\xa1\xc7\xe2\x84\xd7"
+		"\x3e\x67\xf1\x80\x9a\x48\xa4\x97\x20\x0e\x04\x6d\x39\xcc\xc7"
+		"\x11\x2c\xd0",
+	},
+};
+
+/* Hash @buf in pieces of the given sizes, repeating the last as needed */
+static int sha_pieces(struct unit_test_state *uts, struct hash_algo *algo,
+		      const u8 *buf, uint len, const uint *sizes, u8 *out)
+{
+	uint size;
+	void *ctx;
+
+	ut_assertok(algo->hash_init(algo, &ctx));
+	for (; len; len -= size, buf += size) {
+		size = min(*sizes, len);
+		if (sizes[1])
+			sizes++;
+		ut_assertok(algo->hash_update(algo, ctx, buf, size,
+					      size == len));
+	}
+	ut_assertok(algo->hash_finish(algo, ctx, out, algo->digest_size));
+
+	return 0;
+}
+
+static int sha_check(struct unit_test_state *uts, const char *name,
+		     bool is_sha1)
+{
+	static const uint sizes[] = { 1, 63, 64, 65, 127, 200, 0 };
+	const struct sha_vector *vec;
+	struct hash_algo *algo;
+	u8 out[SHA256_SUM_LEN];
+	uint i, align, len;
+	u8 *buf, *in;
+
+	if (hash_lookup_algo(name, &algo))
+		return -EAGAIN;
+
+	for (vec = sha_vectors; vec < sha_vectors + ARRAY_SIZE(sha_vectors);
+	     vec++) {
+		const u8 *expect = is_sha1 ? vec->sha1 : vec->sha256;
+		uint size = strlen(vec->input);
+
+		len = size * vec->repeat;
+		buf = malloc(len + 4);
+		ut_assertnonnull(buf);
+		for (align = 0; align < 4; align++) {
+			in = buf + align;
+			for (i = 0; i < vec->repeat; i++)
+				memcpy(in + i * size, vec->input, size);
+
+			algo->hash_func_ws(in, len, out, algo->chunk_size);
+			ut_asserteq_mem(expect, out, algo->digest_size);
+
+			ut_assertok(sha_pieces(uts, algo, in, len, sizes, out));
+			ut_asserteq_mem(expect, out, algo->digest_size);
+		}
+		free(buf);
+	}
+
+	return 0;
+}
+
+static int lib_test_sha1(struct unit_test_state *uts)
+{
+	return sha_check(uts, "sha1", true);
+}
+LIB_TEST(lib_test_sha1, 0);
+
+static int lib_test_sha256(struct unit_test_state *uts)
+{
+	return sha_check(uts, "sha256", false);
+}
+LIB_TEST(lib_test_sha256, 0);
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for running jobs with worker_run()
+ */
+
+#include <worker.h>
+#include <test/lib.h>
+#include <test/ut.h>
+
+#define TEST_JOBS	10
+
+struct test_job {
+	int runs;
+	uint sum;
+	const u8 *buf;
+	int size;
+};
+
+static void test_job_run(void *priv)
+{
+	struct test_job *job = priv;
+	int i;
+
+	for (i = 0; i < job->size; i++)
+		job->sum += job->buf[i];
+	job->runs++;
+}
+
+static int lib_test_worker(struct unit_test_state *uts)
+{
+	struct worker_job work[TEST_JOBS];
+	struct test_job job[TEST_JOBS];
+	static u8 buf[TEST_JOBS * 1000];
+	uint sum[TEST_JOBS];
+	int count, i;
+
+	/* sum[i] is the expected result of job i, which adds up more bytes */
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = i * 7;
+		sum[i / 1000] = (i % 1000 ? sum[i / 1000] :
+				 i ? sum[i / 1000 - 1] : 0) + buf[i];
+	}
+
+	/* Try fewer jobs than CPUs as well as more */
+	for (count = 0; count <= TEST_JOBS; count++) {
+		memset(job, '\0', sizeof(job));
+		for (i = 0; i < count; i++) {
+			job[i].buf = buf;
+			job[i].size = (i + 1) * 1000;
+			work[i].func = test_job_run;
+			work[i].priv = &job[i];
+		}
+		worker_run(work, count);
+		for (i = 0; i < TEST_JOBS; i++) {
+			ut_asserteq(i < count, job[i].runs);
+			if (i < count)
+				ut_asserteq(sum[i], job[i].sum);
+		}
+	}
+	if (IS_ENABLED(CONFIG_SANDBOX))
+		ut_asserteq(CONFIG_WORKER_MAX + 1, worker_count());
+
+	return 0;
+}
+LIB_TEST(lib_test_worker, 0);
@@ -0,0 +1,99 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""Decompress a kernel over its own compressed data
+
+With CONFIG_BOOTM_DECOMP_INPLACE, an lz4 or zstd kernel may be loaded within
+the region it decompresses to. Check that bootm moves it out of the way and
+decompresses it correctly, after checking its hash.
+"""
+
+import os
+import shutil
+import zlib
+import pytest
+import fit_util
+import u_boot_utils as util
+
+ITS = '''
+/dts-v1/;
+
+/ {
+        description = "FIT with a kernel decompressed in place";
+        #address-cells = <1>;
+
+        images {
+                kernel-1 {
+                        data = /incbin/("%(kernel)s");
+                        type = "kernel";
+                        arch = "sandbox";
+                        os = "linux";
+                        compression = "%(comp)s";
+                        load = <%(load)#x>;
+                        entry = <%(load)#x>;
+                        hash-1 {
+                                algo = "sha256";
+                        };
+                };
+        };
+
+        configurations {
+                default = "conf-1";
+                conf-1 {
+                        kernel = "kernel-1";
+                };
+        };
+};
+'''
+
+# Compression type and host command to compress a file to stdout, recording
+# the uncompressed size
+COMPRESSORS = [
+    ['lz4', 'lz4 -9 --content-size -c'],
+    ['zstd', 'zstd -19 -c'],
+]
+
+# Size of the kernel, which is taken from the start of U-Boot
+KERNEL_SIZE = 2 << 20
+
+# The FIT is loaded at the kernel's load address
+LOAD_ADDR = 0x1000000
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('bootm_decomp_inplace')
+@pytest.mark.requiredtool('dtc')
+def test_bootm_inplace(u_boot_console):
+    """Boot an lz4 and a zstd kernel which overlap their load address"""
+    cons = u_boot_console
+    mkimage = cons.config.build_dir + '/tools/mkimage'
+    kernel = fit_util.make_fname(cons, 'inplace-kernel')
+    with open(os.path.join(cons.config.build_dir, 'u-boot'), 'rb') as inf:
+        data = inf.read(KERNEL_SIZE)
+    with open(kernel, 'wb') as outf:
+        outf.write(data)
+    crc = zlib.crc32(data)
+
+    done = 0
+    for comp, cmd in COMPRESSORS:
+        if not shutil.which(cmd.split()[0]):
+            continue
+        if not cons.config.buildconfig.get(f'config_{comp}'):
+            continue
+        fname = f'{kernel}.{comp}'
+        util.run_and_log(cons, ['sh', '-c', f'{cmd} {kernel} >{fname}'])
+        params = {'kernel': fname, 'comp': comp, 'load': LOAD_ADDR}
+        fit = fit_util.make_fit(cons, mkimage, ITS, params,
+                                f'inplace-{comp}.fit')
+
+        output = cons.run_command_list([
+            f'host load hostfs - {LOAD_ADDR:x} {fit}',
+            f'bootm start {LOAD_ADDR:x}',
+            'bootm loados',
+            f'crc32 {LOAD_ADDR:x} {len(data):x}'])
+        assert 'Verifying Hash Integrity ... sha256+ OK' in output[1]
+        assert 'overwritten' not in output[2]
+        assert 'error' not in output[2].lower()
+        assert f'==> {crc:08x}' in output[3]
+        done += 1
+
+    if not done:
+        pytest.skip('No compression tools available')
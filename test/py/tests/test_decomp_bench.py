@@ -0,0 +1,89 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""Measure decompression speed with the 'decomp bench' command
+
+This compresses two corpora, some text and some machine code, with each host
+compressor which is available, then decompresses them in U-Boot using the
+same code as bootm. Run with -s to see the speed and heap used by each.
+"""
+
+import os
+import shutil
+import pytest
+import u_boot_utils as util
+
+# Compression type and host command to compress a file to stdout
+COMPRESSORS = [
+    ['gzip', 'gzip -9 -n -c'],
+    ['bzip2', 'bzip2 -9 -c'],
+    ['lzma', 'xz --format=lzma -9 -c'],
+    ['lzo', 'lzop -9 -c'],
+    ['lz4', 'lz4 -9 -c'],
+    ['zstd', 'zstd -19 -c'],
+]
+
+# Size of each corpus
+CORPUS_SIZE = 4 << 20
+
+SRC_ADDR = 0x1000000
+DST_ADDR = 0x2000000
+DST_SIZE = 0x1000000
+
+def make_corpora(config):
+    """Create the corpora to be compressed
+
+    Args:
+        config (ArbitraryAttributeContainer): U-Boot configuration
+
+    Returns:
+        list of str: Paths to the corpora
+    """
+    text = os.path.join(config.persistent_data_dir, 'decomp_text')
+    with open(text, 'wb') as outf:
+        size = 0
+        for dirpath, _, fnames in sorted(os.walk(
+                os.path.join(config.source_dir, 'doc'))):
+            for fname in sorted(fnames):
+                if size >= CORPUS_SIZE or not fname.endswith('.rst'):
+                    continue
+                with open(os.path.join(dirpath, fname), 'rb') as inf:
+                    data = inf.read()
+                outf.write(data)
+                size += len(data)
+
+    code = os.path.join(config.persistent_data_dir, 'decomp_code')
+    with open(os.path.join(config.build_dir, 'u-boot'), 'rb') as inf:
+        data = inf.read(CORPUS_SIZE)
+    with open(code, 'wb') as outf:
+        outf.write(data)
+
+    return [text, code]
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_decomp')
+def test_decomp_bench(u_boot_console):
+    """Decompress each corpus with each compression type"""
+    cons = u_boot_console
+    done = 0
+    for corpus in make_corpora(cons.config):
+        size = os.path.getsize(corpus)
+        for comp, cmd in COMPRESSORS:
+            if not shutil.which(cmd.split()[0]):
+                continue
+            if not cons.config.buildconfig.get(f'config_{comp}'):
+                continue
+            fname = f'{corpus}.{comp}'
+            util.run_and_log(cons, ['sh', '-c', f'{cmd} {corpus} >{fname}'])
+            in_size = os.path.getsize(fname)
+
+            output = cons.run_command_list([
+                f'host load hostfs - {SRC_ADDR:x} {fname}',
+                f'decomp bench -n 3 {comp} {SRC_ADDR:x} {in_size:x} '
+                f'{DST_ADDR:x} {DST_SIZE:x}'])
+            result = output[-1]
+            assert f'{comp}: {in_size} -> {size} bytes, 3 runs' in result
+            assert 'MB/s' in result
+            done += 1
+
+    if not done:
+        pytest.skip('No compression tools available')
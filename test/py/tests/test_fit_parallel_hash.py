@@ -0,0 +1,149 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""Check the hashes of FIT images on several CPUs at once
+
+With CONFIG_FIT_PARALLEL_HASH, 'iminfo' hashes all images of a FIT in
+parallel and bootm hashes all images of the selected configuration when it
+finds the kernel. The output should be the same as when they are checked one
+at a time, and a bad image must still be detected.
+"""
+
+import pytest
+import fit_util
+
+ITS = '''
+/dts-v1/;
+
+/ {
+        description = "FIT with several images to check";
+        #address-cells = <1>;
+
+        images {
+                kernel-1 {
+                        data = /incbin/("%(kernel)s");
+                        type = "kernel";
+                        arch = "sandbox";
+                        os = "linux";
+                        compression = "none";
+                        load = <0x40000>;
+                        entry = <0x8>;
+                        hash-1 {
+                                algo = "sha256";
+                        };
+                        hash-2 {
+                                algo = "crc32";
+                        };
+                };
+                fdt-1 {
+                        data = /incbin/("%(fdt)s");
+                        type = "flat_dt";
+                        arch = "sandbox";
+                        compression = "none";
+                        hash-1 {
+                                algo = "sha1";
+                        };
+                };
+                ramdisk-1 {
+                        data = /incbin/("%(ramdisk)s");
+                        type = "ramdisk";
+                        arch = "sandbox";
+                        os = "linux";
+                        compression = "none";
+                        load = <0xc0000>;
+                        hash-1 {
+                                algo = "sha256";
+                        };
+                };
+                loadable-1 {
+                        data = /incbin/("%(loadable)s");
+                        type = "kernel";
+                        arch = "sandbox";
+                        os = "linux";
+                        compression = "none";
+                        load = <0x100000>;
+                        entry = <0x0>;
+                        hash-1 {
+                                algo = "crc32";
+                        };
+                };
+        };
+
+        configurations {
+                default = "conf-1";
+                conf-1 {
+                        kernel = "kernel-1";
+                        fdt = "fdt-1";
+                        ramdisk = "ramdisk-1";
+                        loadables = "loadable-1";
+                };
+        };
+};
+'''
+
+FDT = '''
+/dts-v1/;
+
+/ {
+        #address-cells = <1>;
+        #size-cells = <0>;
+        model = "Sandbox parallel hash test";
+};
+'''
+
+FIT_ADDR = 0x1000
+
+# Image name and the hashes shown for it
+IMAGES = [
+    ['kernel-1', 'sha256+ crc32+ '],
+    ['fdt-1', 'sha1+ '],
+    ['ramdisk-1', 'sha256+ '],
+    ['loadable-1', 'crc32+ '],
+]
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('fit_parallel_hash')
+@pytest.mark.requiredtool('dtc')
+def test_fit_parallel_hash(u_boot_console):
+    """Check a good and a bad FIT with iminfo and bootm"""
+    cons = u_boot_console
+    mkimage = cons.config.build_dir + '/tools/mkimage'
+    params = {
+        'kernel': fit_util.make_kernel(cons, 'phash-kernel.bin', 'kernel'),
+        'fdt': fit_util.make_dtb(cons, FDT, 'phash-fdt'),
+        'ramdisk': fit_util.make_kernel(cons, 'phash-ramdisk.bin', 'ramdisk'),
+        'loadable': fit_util.make_kernel(cons, 'phash-loadable.bin',
+                                         'loadable'),
+    }
+    fit = fit_util.make_fit(cons, mkimage, ITS, params, 'phash.fit')
+
+    cons.run_command(f'host load hostfs - {FIT_ADDR:x} {fit}')
+    output = cons.run_command(f'iminfo {FIT_ADDR:x}')
+    for num, (name, hashes) in enumerate(IMAGES):
+        assert f'Hash(es) for Image {num} ({name}): {hashes}' in output
+    assert 'error' not in output
+
+    output = cons.run_command(f'bootm start {FIT_ADDR:x}')
+    for name, hashes in IMAGES:
+        assert f"Trying '{name}'" in output
+        assert f'Verifying Hash Integrity ... {hashes}OK' in output
+    assert 'Bad Data Hash' not in output
+
+    # Corrupt the ramdisk; the images before it are still shown as good
+    with open(fit, 'rb') as inf:
+        data = inf.read()
+    pos = data.index(b'this ramdisk 50')
+    bad_fit = fit_util.make_fname(cons, 'phash-bad.fit')
+    with open(bad_fit, 'wb') as outf:
+        outf.write(data[:pos] + b'T' + data[pos + 1:])
+
+    cons.run_command(f'host load hostfs - {FIT_ADDR:x} {bad_fit}')
+    output = cons.run_command(f'iminfo {FIT_ADDR:x}')
+    assert 'Hash(es) for Image 1 (fdt-1): sha1+ ' in output
+    assert ("Bad hash value for 'hash-1' hash node in 'ramdisk-1' image node"
+            in output)
+    assert 'Hash(es) for Image 3' not in output
+
+    output = cons.run_command(f'bootm start {FIT_ADDR:x}')
+    assert ("Bad hash value for 'hash-1' hash node in 'ramdisk-1' image node"
+            in output)
+    assert 'Bad Data Hash' in output
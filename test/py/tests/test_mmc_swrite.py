@@ -0,0 +1,77 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""Write an Android sparse image with 'mmc swrite'
+
+The image has adjacent RAW chunks, which are gathered into one write, FILL
+chunks of zeroes and of another value, a DONT_CARE chunk and a CRC32 chunk.
+The sandbox MMC device reads as zero once erased, so zero FILL chunks and,
+with CONFIG_IMAGE_SPARSE_DISCARD, DONT_CARE chunks are erased.
+"""
+
+import os
+import struct
+import zlib
+import pytest
+
+SPARSE_MAGIC = 0xed26ff3a
+CHUNK_RAW = 0xcac1
+CHUNK_FILL = 0xcac2
+CHUNK_DONT_CARE = 0xcac3
+CHUNK_CRC32 = 0xcac4
+
+BLK_SZ = 4096
+DISK_SIZE = 1 << 20
+IMAGE_ADDR = 0x1000000
+READ_ADDR = 0x2000000
+
+def make_sparse(chunks, total_blks):
+    """Build a sparse image from a list of (type, blocks, payload)"""
+    out = struct.pack('<IHHHHIIII', SPARSE_MAGIC, 1, 0, 28, 12, BLK_SZ,
+                      total_blks, len(chunks), 0)
+    for ctype, blocks, payload in chunks:
+        out += struct.pack('<HHII', ctype, 0, blocks, 12 + len(payload))
+        out += payload
+    return out
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_mmc_swrite')
+def test_mmc_swrite(u_boot_console):
+    """Write a sparse image to the MMC device and check the result"""
+    cons = u_boot_console
+    with open(os.path.join(cons.config.build_dir, 'u-boot'), 'rb') as inf:
+        code = inf.read(16 * BLK_SZ)
+    discard = cons.config.buildconfig.get('config_image_sparse_discard')
+
+    chunks = [
+        (CHUNK_RAW, 8, code[:8 * BLK_SZ]),
+        (CHUNK_RAW, 4, code[8 * BLK_SZ:12 * BLK_SZ]),
+        (CHUNK_FILL, 64, bytes(4)),
+        (CHUNK_FILL, 4, b'\x5a\xa5\x12\x34'),
+        (CHUNK_DONT_CARE, 16, b''),
+        (CHUNK_CRC32, 0, bytes(4)),
+        (CHUNK_RAW, 3, code[12 * BLK_SZ:15 * BLK_SZ]),
+    ]
+    expect = code[:12 * BLK_SZ] + bytes(64 * BLK_SZ)
+    expect += b'\x5a\xa5\x12\x34' * (BLK_SZ // 4 * 4)
+    expect += (bytes(16 * BLK_SZ) if discard else b'\x55' * 16 * BLK_SZ)
+    expect += code[12 * BLK_SZ:15 * BLK_SZ]
+    total_blks = len(expect) // BLK_SZ
+    written = (total_blks - 16) * BLK_SZ
+    erased = (64 + (16 if discard else 0)) * BLK_SZ
+    expect += b'\x55' * (DISK_SIZE - len(expect))
+
+    image = os.path.join(cons.config.result_dir, 'swrite.simg')
+    with open(image, 'wb') as outf:
+        outf.write(make_sparse(chunks, total_blks))
+
+    output = cons.run_command_list([
+        'mmc dev 0',
+        f'mw.b {READ_ADDR:x} 55 {DISK_SIZE:x}',
+        f'mmc write {READ_ADDR:x} 0 {DISK_SIZE // 512:x}',
+        f'host load hostfs - {IMAGE_ADDR:x} {image}',
+        f'mmc swrite {IMAGE_ADDR:x} 0',
+        f'mmc read {READ_ADDR:x} 0 {DISK_SIZE // 512:x}',
+        f'crc32 {READ_ADDR:x} {DISK_SIZE:x}'])
+    assert f'wrote {written} bytes' in output[4]
+    assert f'erasing {erased} bytes' in output[4]
+    assert f'==> {zlib.crc32(expect):08x}' in output[6]
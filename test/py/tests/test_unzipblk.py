@@ -0,0 +1,111 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+"""Decompress images straight to a block device with 'unzipblk'
+
+Each host compressor which is available is used to compress an image with
+some zero regions and an odd-sized tail. The image is written to a host
+block device and the result checked against the original.
+"""
+
+import os
+import shutil
+import zlib
+import pytest
+import u_boot_utils as util
+
+# Compression type and host command to compress a file to stdout
+COMPRESSORS = [
+    ['gzip', 'gzip -9 -n -c'],
+    ['lz4', 'lz4 -9 -c'],
+    ['zstd', 'zstd -19 -c'],
+]
+
+SRC_ADDR = 0x1000000
+DISK_SIZE = 8 << 20
+BUF_SIZE = 0x40000
+OFFSET = 0x10200
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_unzipblk')
+def test_unzipblk(u_boot_console):
+    """Write an image compressed with each type and check the device"""
+    cons = u_boot_console
+    with open(os.path.join(cons.config.build_dir, 'u-boot'), 'rb') as inf:
+        code = inf.read(2 << 20)
+    data = code[:1 << 20] + bytes(1 << 20) + code[1 << 20:] + code[:1000]
+    image = os.path.join(cons.config.result_dir, 'unzipblk.img')
+    with open(image, 'wb') as outf:
+        outf.write(data)
+    disk = os.path.join(cons.config.result_dir, 'unzipblk.disk')
+
+    done = 0
+    for comp, cmd in COMPRESSORS:
+        if not shutil.which(cmd.split()[0]):
+            continue
+        if not cons.config.buildconfig.get(f'config_{comp}'):
+            continue
+        fname = f'{image}.{comp}'
+        util.run_and_log(cons, ['sh', '-c', f'{cmd} {image} >{fname}'])
+        in_size = os.path.getsize(fname)
+        with open(disk, 'wb') as outf:
+            outf.write(b'\x55' * DISK_SIZE)
+
+        output = cons.run_command_list([
+            f'host bind 0 {disk}',
+            f'host load hostfs - {SRC_ADDR:x} {fname}',
+            f'unzipblk host 0 {SRC_ADDR:x} {in_size:x} {BUF_SIZE:x} '
+            f'{OFFSET:x}',
+            'host unbind 0'])
+        assert f'{comp}: {in_size} -> {len(data)} bytes' in output[2]
+        assert 'MB/s' in output[2]
+        assert 'Failed' not in output[2]
+
+        # The last block is padded with zeroes; nothing else is touched
+        with open(disk, 'rb') as inf:
+            result = inf.read()
+        end = OFFSET + len(data)
+        padded = (end + 511) // 512 * 512
+        assert result[:OFFSET] == b'\x55' * OFFSET
+        assert result[OFFSET:end] == data
+        assert result[end:padded] == bytes(padded - end)
+        assert result[padded:] == b'\x55' * (DISK_SIZE - padded)
+
+        # A truncated image must fail
+        output = cons.run_command_list([
+            f'host bind 0 {disk}',
+            f'unzipblk host 0 {SRC_ADDR:x} {in_size // 2:x}',
+            'host unbind 0'])
+        assert 'Failed' in output[1]
+        done += 1
+
+    if not done:
+        pytest.skip('No compression tools available')
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_unzipblk')
+@pytest.mark.buildconfigspec('mmc_write')
+def test_unzipblk_erase(u_boot_console):
+    """Check that buffers of zeroes are erased on a device which allows it
+
+    The sandbox MMC device is 1MB and reads as zero once erased.
+    """
+    cons = u_boot_console
+    with open(os.path.join(cons.config.build_dir, 'u-boot'), 'rb') as inf:
+        code = inf.read(384 << 10)
+    data = code[:256 << 10] + bytes(512 << 10) + code[256 << 10:]
+    image = os.path.join(cons.config.result_dir, 'unzipblk-erase.img')
+    with open(image, 'wb') as outf:
+        outf.write(data)
+    util.run_and_log(cons, ['sh', '-c', f'gzip -9 -n -c {image} >{image}.gz'])
+    in_size = os.path.getsize(f'{image}.gz')
+
+    output = cons.run_command_list([
+        'mmc dev 0',
+        'mmc write 0 0 800',
+        f'host load hostfs - {SRC_ADDR:x} {image}.gz',
+        f'unzipblk -e mmc 0 {SRC_ADDR:x} {in_size:x} 10000',
+        'mmc read 2000000 0 800',
+        f'crc32 2000000 {len(data):x}'])
+    assert (f'gzip: {in_size} -> {len(data)} bytes, {512 << 10} erased'
+            in output[3])
+    assert f'==> {zlib.crc32(data):08x}' in output[5]
@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Add an index of phandles, aliases and compatible strings to a devicetree
+ *
+ * The index is a node holding the offsets of the nodes which U-Boot looks up
+ * most, so that it can find them without searching the flat tree. See
+ * include/dtb_index.h for its layout.
+ *
+ * The index node goes first among the children of the root node, so that
+ * U-Boot finds it straight away. Adding it moves the nodes after it, so the
+ * node is added with properties of the right size first, and the offsets are
+ * filled in afterwards, which moves nothing.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fdt_host.h"
+#include <dtb_index.h>
+
+/* Leave out the phandle table if it would have more than this many entries */
+#define MAX_PHANDLES	0x10000
+
+/* Round up to the alignment of the structure block */
+#define TAG_ALIGN(x)	(((x) + FDT_TAGSIZE - 1) & ~(FDT_TAGSIZE - 1))
+
+/**
+ * struct compat_ent - a compatible string of a node
+ *
+ * @compat: Compatible string
+ * @offset: Offset of the node
+ */
+struct compat_ent {
+	const char *compat;
+	int offset;
+};
+
+/**
+ * struct index_info - the contents of the index
+ *
+ * @phandles: Offset of the node for each phandle, or -1
+ * @num_phandles: Number of entries in @phandles, i.e. the largest phandle + 1
+ * @alias_names: Alias names, each nul-terminated
+ * @alias_names_len: Length of @alias_names in bytes
+ * @aliases: Offset of the node for each alias, or -1
+ * @num_aliases: Number of aliases
+ * @compats: Compatible strings of all nodes, sorted by string then offset
+ * @num_compats: Number of entries in @compats
+ * @compat_strings: Distinct compatible strings, each nul-terminated
+ * @compat_strings_len: Length of @compat_strings in bytes
+ * @compat_nodes: Count and node offsets for each distinct string
+ * @num_compat_nodes: Number of cells in @compat_nodes
+ */
+struct index_info {
+	fdt32_t *phandles;
+	int num_phandles;
+	char *alias_names;
+	int alias_names_len;
+	fdt32_t *aliases;
+	int num_aliases;
+	struct compat_ent *compats;
+	int num_compats;
+	char *compat_strings;
+	int compat_strings_len;
+	fdt32_t *compat_nodes;
+	int num_compat_nodes;
+};
+
+static void *xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size ? size : 1);
+	if (!ptr) {
+		fprintf(stderr, "dtb_index: Out of memory\n");
+		exit(1);
+	}
+
+	return ptr;
+}
+
+static int compat_cmp(const void *a, const void *b)
+{
+	const struct compat_ent *ea = a, *eb = b;
+	int ret;
+
+	ret = strcmp(ea->compat, eb->compat);
+	if (ret)
+		return ret;
+
+	return ea->offset - eb->offset;
+}
+
+static void index_free(struct index_info *info)
+{
+	free(info->phandles);
+	free(info->alias_names);
+	free(info->aliases);
+	free(info->compats);
+	free(info->compat_strings);
+	free(info->compat_nodes);
+	memset(info, '\0', sizeof(*info));
+}
+
+/**
+ * index_scan() - Work out the contents of the index for a devicetree
+ *
+ * @fdt: Devicetree to scan
+ * @info: Returns the index contents
+ * Return: 0 if OK, -ve libfdt error on failure
+ */
+static int index_scan(const void *fdt, struct index_info *info)
+{
+	const char *compat, *name, *path;
+	int node, depth, len, prop, i, start = 0;
+	uint32_t phandle, max = 0;
+
+	memset(info, '\0', sizeof(*info));
+
+	/* Collect the phandles and compatible strings of all nodes */
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(fdt, node, &depth)) {
+		phandle = fdt_get_phandle(fdt, node);
+		if (phandle && phandle != (uint32_t)-1 && phandle > max)
+			max = phandle;
+
+		compat = fdt_getprop(fdt, node, "compatible", &len);
+		for (i = 0; compat && i < len; i += strlen(compat + i) + 1) {
+			info->compats = xrealloc(info->compats,
+						 (info->num_compats + 1) *
+						 sizeof(*info->compats));
+			info->compats[info->num_compats].compat = compat + i;
+			info->compats[info->num_compats].offset = node;
+			info->num_compats++;
+		}
+	}
+	if (node != -FDT_ERR_NOTFOUND && node < 0)
+		return node;
+
+	if (max && max < MAX_PHANDLES) {
+		info->num_phandles = max + 1;
+		info->phandles = xrealloc(NULL, info->num_phandles *
+					  sizeof(fdt32_t));
+		memset(info->phandles, 0xff, info->num_phandles *
+		       sizeof(fdt32_t));
+		for (node = 0, depth = 0; node >= 0 && depth >= 0;
+		     node = fdt_next_node(fdt, node, &depth)) {
+			phandle = fdt_get_phandle(fdt, node);
+			if (phandle && phandle <= max)
+				info->phandles[phandle] = cpu_to_fdt32(node);
+		}
+	}
+
+	/* Sort so that each string's nodes are together and in order */
+	qsort(info->compats, info->num_compats, sizeof(*info->compats),
+	      compat_cmp);
+	for (i = 0; i < info->num_compats; i++) {
+		if (!i || strcmp(info->compats[i].compat,
+				 info->compats[i - 1].compat)) {
+			compat = info->compats[i].compat;
+			len = strlen(compat) + 1;
+			info->compat_strings = xrealloc(info->compat_strings,
+					info->compat_strings_len + len);
+			memcpy(info->compat_strings + info->compat_strings_len,
+			       compat, len);
+			info->compat_strings_len += len;
+
+			/* start a new list with a count of zero */
+			info->compat_nodes = xrealloc(info->compat_nodes,
+					(info->num_compat_nodes + 1) *
+					sizeof(fdt32_t));
+			start = info->num_compat_nodes;
+			info->compat_nodes[info->num_compat_nodes++] = 0;
+		}
+		info->compat_nodes = xrealloc(info->compat_nodes,
+					      (info->num_compat_nodes + 1) *
+					      sizeof(fdt32_t));
+		info->compat_nodes[info->num_compat_nodes++] =
+			cpu_to_fdt32(info->compats[i].offset);
+		info->compat_nodes[start] =
+			cpu_to_fdt32(fdt32_to_cpu(info->compat_nodes[start]) + 1);
+	}
+
+	node = fdt_path_offset(fdt, "/aliases");
+	if (node < 0)
+		return 0;
+	fdt_for_each_property_offset(prop, fdt, node) {
+		path = fdt_getprop_by_offset(fdt, prop, &name, &len);
+		if (!path)
+			return len;
+		len = strlen(name) + 1;
+		info->alias_names = xrealloc(info->alias_names,
+					     info->alias_names_len + len);
+		memcpy(info->alias_names + info->alias_names_len, name, len);
+		info->alias_names_len += len;
+
+		info->aliases = xrealloc(info->aliases,
+					 (info->num_aliases + 1) *
+					 sizeof(fdt32_t));
+		info->aliases[info->num_aliases++] =
+			cpu_to_fdt32(fdt_path_offset(fdt, path) < 0 ? -1 :
+				     fdt_path_offset(fdt, path));
+	}
+
+	return 0;
+}
+
+/**
+ * prop_size() - Get the space taken by a property in a devicetree
+ *
+ * @name: Property name, which is added to the strings block
+ * @len: Length of the property value
+ * Return: number of bytes
+ */
+static int prop_size(const char *name, int len)
+{
+	return sizeof(struct fdt_property) + TAG_ALIGN(len) +
+		strlen(name) + 1;
+}
+
+/**
+ * index_size() - Get the space needed to add an index node
+ *
+ * @info: Index contents
+ * Return: number of bytes
+ */
+static int index_size(const struct index_info *info)
+{
+	int size;
+
+	/* FDT_BEGIN_NODE with the name, then FDT_END_NODE */
+	size = 2 * sizeof(fdt32_t) + TAG_ALIGN(sizeof(DTB_INDEX_NODE));
+	size += prop_size(DTB_INDEX_STRUCT_SIZE, sizeof(fdt32_t));
+	size += prop_size(DTB_INDEX_PHANDLES,
+			  info->num_phandles * sizeof(fdt32_t));
+	size += prop_size(DTB_INDEX_ALIAS_NAMES, info->alias_names_len);
+	size += prop_size(DTB_INDEX_ALIASES,
+			  info->num_aliases * sizeof(fdt32_t));
+	size += prop_size(DTB_INDEX_COMPAT_STRINGS, info->compat_strings_len);
+	size += prop_size(DTB_INDEX_COMPAT_NODES,
+			  info->num_compat_nodes * sizeof(fdt32_t));
+
+	return size;
+}
+
+/**
+ * index_setprops() - Set the properties of the index node
+ *
+ * @fdt: Devicetree to update
+ * @node: Index node
+ * @info: Index contents
+ * @inplace: true to overwrite the existing values, which must be the same
+ *	size, false to create the properties
+ * Return: 0 if OK, -ve libfdt error on failure
+ */
+static int index_setprops(void *fdt, int node, struct index_info *info,
+			  bool inplace)
+{
+	int (*setprop)(void *fdt, int node, const char *name, const void *val,
+		       int len);
+	int ret;
+
+	setprop = inplace ? fdt_setprop_inplace : fdt_setprop;
+	ret = setprop(fdt, node, DTB_INDEX_STRUCT_SIZE, "\0\0\0", 4);
+	if (!ret && info->num_phandles)
+		ret = setprop(fdt, node, DTB_INDEX_PHANDLES, info->phandles,
+			      info->num_phandles * sizeof(fdt32_t));
+	if (!ret && info->num_aliases)
+		ret = setprop(fdt, node, DTB_INDEX_ALIAS_NAMES,
+			      info->alias_names, info->alias_names_len);
+	if (!ret && info->num_aliases)
+		ret = setprop(fdt, node, DTB_INDEX_ALIASES, info->aliases,
+			      info->num_aliases * sizeof(fdt32_t));
+	if (!ret && info->num_compats)
+		ret = setprop(fdt, node, DTB_INDEX_COMPAT_STRINGS,
+			      info->compat_strings, info->compat_strings_len);
+	if (!ret && info->num_compats)
+		ret = setprop(fdt, node, DTB_INDEX_COMPAT_NODES,
+			      info->compat_nodes,
+			      info->num_compat_nodes * sizeof(fdt32_t));
+
+	return ret;
+}
+
+/**
+ * add_index() - Add an index to a devicetree, replacing any existing one
+ *
+ * @fdt: Devicetree to update, with enough space for the index
+ * Return: 0 if OK, -ve libfdt error on failure
+ */
+static int add_index(void *fdt)
+{
+	struct index_info info;
+	int node, ret;
+
+	node = fdt_subnode_offset(fdt, 0, DTB_INDEX_NODE);
+	if (node >= 0) {
+		ret = fdt_del_node(fdt, node);
+		if (ret)
+			return ret;
+	}
+
+	/* Add the node with the right sizes, then fill in the real offsets */
+	ret = index_scan(fdt, &info);
+	if (!ret) {
+		node = fdt_add_subnode(fdt, 0, DTB_INDEX_NODE);
+		ret = node < 0 ? node : index_setprops(fdt, node, &info, false);
+	}
+	index_free(&info);
+	if (ret)
+		return ret;
+
+	ret = index_scan(fdt, &info);
+	if (!ret)
+		ret = index_setprops(fdt, node, &info, true);
+	index_free(&info);
+	if (ret)
+		return ret;
+
+	return fdt_setprop_inplace_u32(fdt, node, DTB_INDEX_STRUCT_SIZE,
+				       fdt_size_dt_struct(fdt));
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s <dtb>\n", prog);
+	fprintf(stderr, "Add an index to a devicetree blob, in place\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct index_info info;
+	const char *fname;
+	struct stat sbuf;
+	void *blob, *fdt;
+	int fd, ret, size, pad = 0;
+	ssize_t len;
+
+	if (argc != 2)
+		usage(argv[0]);
+	fname = argv[1];
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0 || fstat(fd, &sbuf)) {
+		fprintf(stderr, "dtb_index: Cannot open '%s': %s\n", fname,
+			strerror(errno));
+		return 1;
+	}
+	blob = xrealloc(NULL, sbuf.st_size);
+	len = read(fd, blob, sbuf.st_size);
+	close(fd);
+	if (len != sbuf.st_size) {
+		fprintf(stderr, "dtb_index: Cannot read '%s'\n", fname);
+		return 1;
+	}
+
+	/*
+	 * Scan the tree first to find the size of the index. The phandle
+	 * table can be much larger than the tree itself. Any existing index
+	 * is deleted before the new one is added, so it needs no extra space.
+	 */
+	ret = fdt_check_header(blob);
+	if (!ret && fdt_totalsize(blob) > sbuf.st_size)
+		ret = -FDT_ERR_TRUNCATED;
+	if (!ret) {
+		ret = index_scan(blob, &info);
+		size = fdt_totalsize(blob) + index_size(&info);
+		index_free(&info);
+	}
+	if (ret) {
+		fprintf(stderr, "dtb_index: Cannot index '%s': %s\n", fname,
+			fdt_strerror(ret));
+		return 1;
+	}
+
+	fdt = xrealloc(NULL, size);
+	memset(fdt, '\0', size);
+	ret = fdt_open_into(blob, fdt, size);
+
+	/* Keep any free space which dtc was asked to leave (-p) */
+	if (!ret)
+		ret = fdt_pack(fdt);
+	if (!ret) {
+		pad = fdt_totalsize(blob) - fdt_totalsize(fdt);
+		ret = fdt_open_into(fdt, fdt, size);
+	}
+	if (!ret)
+		ret = add_index(fdt);
+	if (!ret)
+		ret = fdt_pack(fdt);
+	if (!ret && pad > 0) {
+		memset(fdt + fdt_totalsize(fdt), '\0', pad);
+		fdt_set_totalsize(fdt, fdt_totalsize(fdt) + pad);
+	}
+	if (ret) {
+		fprintf(stderr, "dtb_index: Cannot index '%s': %s\n", fname,
+			fdt_strerror(ret));
+		return 1;
+	}
+
+	fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || write(fd, fdt, fdt_totalsize(fdt)) !=
+	    fdt_totalsize(fdt) || close(fd)) {
+		fprintf(stderr, "dtb_index: Cannot write '%s': %s\n", fname,
+			strerror(errno));
+		return 1;
+	}
+	free(blob);
+	free(fdt);
+
+	return 0;
+}